@@ -1,102 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "util.h"
 #include "database.h"
 
+/* 可以使用的存储后端。第一个为默认的存储后端 */
+static const db_backend *const db_backends[] = {
+        &sqlite_backend,
+        &memory_backend,
+        NULL
+};
+
 /**
- * 初始化数据库
+ * 使用指定的存储后端初始化数据库
  * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] backend 存储后端的名称。为NULL时使用默认的存储后端
  * @param[in] db_path 待初始化的数据库文件的名字
- * @return sqlite3的错误代码
+ * @return 错误代码
  * @retval 0 成功
  */
 int
-init_database(wiser_env *env, const char *db_path)
+init_database(wiser_env *env, const char *backend, const char *db_path)
 {
-    int rc;
-    if ((rc = sqlite3_open(db_path, &env->db)))
+    const db_backend *const *b;
+
+    for (b = db_backends; *b; b++)
     {
-        print_error("cannot open databases.");
-        return rc;
+        if (!backend || !strcmp((*b)->name, backend)) { break; }
     }
-
-    sqlite3_exec(env->db,
-                 "CREATE TABLE settings (" \
-               "  key   TEXT PRIMARY KEY," \
-               "  value TEXT" \
-               ");",
-                 NULL, NULL, NULL);
-
-    sqlite3_exec(env->db,
-                 "CREATE TABLE documents (" \
-               "  id      INTEGER PRIMARY KEY," /* auto increment */ \
-               "  title   TEXT NOT NULL," \
-               "  body    TEXT NOT NULL" \
-               ");",
-                 NULL, NULL, NULL);
-
-    sqlite3_exec(env->db,
-                 "CREATE TABLE tokens (" \
-               "  id         INTEGER PRIMARY KEY," \
-               "  token      TEXT NOT NULL," \
-               "  docs_count INT NOT NULL," \
-               "  postings   BLOB NOT NULL" \
-               ");",
-                 NULL, NULL, NULL);
-
-    sqlite3_exec(env->db,
-                 "CREATE UNIQUE INDEX token_index ON tokens(token);",
-                 NULL, NULL, NULL);
-
-    sqlite3_exec(env->db,
-                 "CREATE UNIQUE INDEX title_index ON documents(title);",
-                 NULL, NULL, NULL);
-
-    sqlite3_prepare(env->db,
-                    "SELECT id FROM documents WHERE title = ?;",
-                    -1, &env->get_document_id_st, NULL);
-    sqlite3_prepare(env->db,
-                    "SELECT title FROM documents WHERE id = ?;",
-                    -1, &env->get_document_title_st, NULL);
-    sqlite3_prepare(env->db,
-                    "INSERT INTO documents (title, body) VALUES (?, ?);",
-                    -1, &env->insert_document_st, NULL);
-    sqlite3_prepare(env->db,
-                    "UPDATE documents set body = ? WHERE id = ?;",
-                    -1, &env->update_document_st, NULL);
-    sqlite3_prepare(env->db,
-                    "SELECT id, docs_count FROM tokens WHERE token = ?;",
-                    -1, &env->get_token_id_st, NULL);
-    sqlite3_prepare(env->db,
-                    "SELECT token FROM tokens WHERE id = ?;",
-                    -1, &env->get_token_st, NULL);
-    sqlite3_prepare(env->db,
-                    "INSERT OR IGNORE INTO tokens (token, docs_count, postings)"
-                            " VALUES (?, 0, ?);",
-                    -1, &env->store_token_st, NULL);
-    sqlite3_prepare(env->db,
-                    "SELECT docs_count, postings FROM tokens WHERE id = ?;",
-                    -1, &env->get_postings_st, NULL);
-    sqlite3_prepare(env->db,
-                    "UPDATE tokens SET docs_count = ?, postings = ? WHERE id = ?;",
-                    -1, &env->update_postings_st, NULL);
-    sqlite3_prepare(env->db,
-                    "SELECT value FROM settings WHERE key = ?;",
-                    -1, &env->get_settings_st, NULL);
-    sqlite3_prepare(env->db,
-                    "INSERT OR REPLACE INTO settings (key, value) VALUES (?, ?);",
-                    -1, &env->replace_settings_st, NULL);
-    sqlite3_prepare(env->db,
-                    "SELECT COUNT(*) FROM documents;",
-                    -1, &env->get_document_count_st, NULL);
-    sqlite3_prepare(env->db,
-                    "BEGIN;",
-                    -1, &env->begin_st, NULL);
-    sqlite3_prepare(env->db,
-                    "COMMIT;",
-                    -1, &env->commit_st, NULL);
-    sqlite3_prepare(env->db,
-                    "ROLLBACK;",
-                    -1, &env->rollback_st, NULL);
-    return 0;
+    if (!*b)
+    {
+        print_error("invalid storage backend(%s).", backend);
+        return -1;
+    }
+    env->backend = *b;
+    return env->backend->init(env, db_path);
 }
 
 /**
@@ -106,22 +45,7 @@ init_database(wiser_env *env, const char *db_path)
 void
 fin_database(wiser_env *env)
 {
-    sqlite3_finalize(env->get_document_id_st);
-    sqlite3_finalize(env->get_document_title_st);
-    sqlite3_finalize(env->insert_document_st);
-    sqlite3_finalize(env->update_document_st);
-    sqlite3_finalize(env->get_token_id_st);
-    sqlite3_finalize(env->get_token_st);
-    sqlite3_finalize(env->store_token_st);
-    sqlite3_finalize(env->get_postings_st);
-    sqlite3_finalize(env->update_postings_st);
-    sqlite3_finalize(env->get_settings_st);
-    sqlite3_finalize(env->replace_settings_st);
-    sqlite3_finalize(env->get_document_count_st);
-    sqlite3_finalize(env->begin_st);
-    sqlite3_finalize(env->commit_st);
-    sqlite3_finalize(env->rollback_st);
-    sqlite3_close(env->db);
+    env->backend->fin(env);
 }
 
 /**
@@ -135,19 +59,7 @@ int
 db_get_document_id(const wiser_env *env,
                    const char *title, unsigned int title_size)
 {
-    int rc;
-    sqlite3_reset(env->get_document_id_st);
-    sqlite3_bind_text(env->get_document_id_st, 1,
-                      title, title_size, SQLITE_STATIC);
-    rc = sqlite3_step(env->get_document_id_st);
-    if (rc == SQLITE_ROW)
-    {
-        return sqlite3_column_int(env->get_document_id_st, 0);
-    }
-    else
-    {
-        return 0;
-    }
+    return env->backend->get_document_id(env, title, title_size);
 }
 
 /**
@@ -161,30 +73,12 @@ int
 db_get_document_title(const wiser_env *env, int document_id,
                       const char **title, int *title_size)
 {
-    int rc;
-
-    sqlite3_reset(env->get_document_title_st);
-    sqlite3_bind_int(env->get_document_title_st, 1, document_id);
-
-    rc = sqlite3_step(env->get_document_title_st);
-    if (rc == SQLITE_ROW)
-    {
-        if (title)
-        {
-            *title = (const char *) sqlite3_column_text(env->get_document_title_st,
-                                                        0);
-        }
-        if (title_size)
-        {
-            *title_size = (int) sqlite3_column_bytes(env->get_document_title_st,
-                                                     0);
-        }
-    }
-    return 0;
+    return env->backend->get_document_title(env, document_id,
+                                            title, title_size);
 }
 
 /**
- * 将文档添加到documents表中
+ * 添加文档。已存在相同标题的文档时，更新其正文
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] title 文档标题
  * @param[in] title_size 文档标题的字节数
@@ -196,45 +90,16 @@ db_add_document(const wiser_env *env,
                 const char *title, unsigned int title_size,
                 const char *body, unsigned int body_size)
 {
-    sqlite3_stmt *st;
-    int rc, document_id;
-
-    if ((document_id = db_get_document_id(env, title, title_size)))
-    {
-        st = env->update_document_st;
-        sqlite3_reset(st);
-        sqlite3_bind_text(st, 1, body, body_size, SQLITE_STATIC);
-        sqlite3_bind_int(st, 2, document_id);
-    }
-    else
-    {
-        st = env->insert_document_st;
-        sqlite3_reset(st);
-        sqlite3_bind_text(st, 1, title, title_size, SQLITE_STATIC);
-        sqlite3_bind_text(st, 2, body, body_size, SQLITE_STATIC);
-    }
-    query:
-    rc = sqlite3_step(st);
-    switch (rc)
-    {
-        case SQLITE_BUSY:
-            goto query;
-        case SQLITE_ERROR:
-            print_error("ERROR: %s", sqlite3_errmsg(env->db));
-            break;
-        case SQLITE_MISUSE:
-            print_error("MISUSE: %s", sqlite3_errmsg(env->db));
-            break;
-    }
-    return rc;
+    return env->backend->add_document(env, title, title_size,
+                                      body, body_size);
 }
 
 /**
- * 从tokens表中获取指定词元的编号
+ * 获取指定词元的编号
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] str 词元（UTF-8）
  * @param[in] str_size 词元的字节数
- * @param[in] insert 当找不到指定词元时，是否要将该词元添加到表中
+ * @param[in] insert 当找不到指定词元时，是否要添加该词元
  * @param[out] docs_count 出现过指定词元的文档数
  */
 int
@@ -242,39 +107,11 @@ db_get_token_id(const wiser_env *env,
                 const char *str, unsigned int str_size, int insert,
                 int *docs_count)
 {
-    int rc;
-    if (insert)
-    {
-        sqlite3_reset(env->store_token_st);
-        sqlite3_bind_text(env->store_token_st, 1, str, str_size,
-                          SQLITE_STATIC);
-        sqlite3_bind_blob(env->store_token_st, 2, "", 0, SQLITE_STATIC);
-        rc = sqlite3_step(env->store_token_st);
-    }
-    sqlite3_reset(env->get_token_id_st);
-    sqlite3_bind_text(env->get_token_id_st, 1, str, str_size,
-                      SQLITE_STATIC);
-    rc = sqlite3_step(env->get_token_id_st);
-    if (rc == SQLITE_ROW)
-    {
-        if (docs_count)
-        {
-            *docs_count = sqlite3_column_int(env->get_token_id_st, 1);
-        }
-        return sqlite3_column_int(env->get_token_id_st, 0);
-    }
-    else
-    {
-        if (docs_count)
-        {
-            *docs_count = 0;
-        }
-        return 0;
-    }
+    return env->backend->get_token_id(env, str, str_size, insert, docs_count);
 }
 
 /**
- * 根据词元编号从tokens表获取词元
+ * 根据词元编号获取词元
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] token_id 词元编号
  * @param[out] token 词元（UTF-8）
@@ -285,188 +122,435 @@ db_get_token(const wiser_env *env,
              const int token_id,
              const char **const token, int *token_size)
 {
-    int rc;
-    sqlite3_reset(env->get_token_st);
-    sqlite3_bind_int(env->get_token_st, 1, token_id);
-    rc = sqlite3_step(env->get_token_st);
-    if (rc == SQLITE_ROW)
-    {
-        if (token)
-        {
-            *token = (const char *) sqlite3_column_text(env->get_token_st, 0);
-        }
-        if (token_size)
-        {
-            *token_size = (int) sqlite3_column_bytes(env->get_token_st, 0);
-        }
-    }
-    return 0;
+    return env->backend->get_token(env, token_id, token, token_size);
+}
+
+/**
+ * 按词元（UTF-8）的字节顺序获取第一个词元
+ * 其余的词元通过db_next_token获取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] token 词元（UTF-8）。已没有词元时为NULL
+ * @param[out] token_size 词元的字节数
+ * @param[out] docs_count 出现过该词元的文档数
+ */
+int
+db_get_tokens(const wiser_env *env, int *token_id,
+              const char **token, int *token_size, int *docs_count)
+{
+    return env->backend->get_tokens(env, token_id, token, token_size,
+                                    docs_count);
+}
+
+/**
+ * 按词元（UTF-8）的字节顺序获取下一个词元
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] token 词元（UTF-8）。已没有词元时为NULL
+ * @param[out] token_size 词元的字节数
+ * @param[out] docs_count 出现过该词元的文档数
+ */
+int
+db_next_token(const wiser_env *env, int *token_id,
+              const char **token, int *token_size, int *docs_count)
+{
+    return env->backend->next_token(env, token_id, token, token_size,
+                                    docs_count);
+}
+
+/**
+ * 获取词元编号的最大值
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @return 词元编号的最大值。没有词元时为0
+ */
+int
+db_get_max_token_id(const wiser_env *env)
+{
+    return env->backend->get_max_token_id(env);
+}
+
+/**
+ * 增加出现过指定词元的文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] docs_count 新增的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+db_add_token_docs_count(const wiser_env *env, int token_id, int docs_count)
+{
+    return env->backend->add_token_docs_count(env, token_id, docs_count);
 }
 
 /**
- * 根据词元编号从数据库中获取倒排列表
+ * 根据词元编号获取倒排列表的第一个块
+ * 其余的块按文档编号的顺序通过db_next_postings获取
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
  * @param[out] docs_count 倒排列表中的文档数
- * @param[out] postings 获取到的倒排列表
+ * @param[out] postings 获取到的倒排列表。不存在时为NULL
  * @param[out] postings_size 获取到的倒排列表的字节数
  */
 int
 db_get_postings(const wiser_env *env, int token_id,
+                int *first_document_id, int *last_document_id,
                 int *docs_count, void **postings, int *postings_size)
 {
-    int rc;
-    sqlite3_reset(env->get_postings_st);
-    sqlite3_bind_int(env->get_postings_st, 1, token_id);
-    rc = sqlite3_step(env->get_postings_st);
-    if (rc == SQLITE_ROW)
-    {
-        if (docs_count)
-        {
-            *docs_count = sqlite3_column_int(env->get_postings_st, 0);
-        }
-        if (postings)
-        {
-            *postings = (void *) sqlite3_column_blob(env->get_postings_st, 1);
-        }
-        if (postings_size)
-        {
-            *postings_size = (int) sqlite3_column_bytes(env->get_postings_st, 1);
-        }
-        rc = 0;
-    }
-    else
-    {
-        if (docs_count) { *docs_count = 0; }
-        if (postings) { *postings = NULL; }
-        if (postings_size) { *postings_size = 0; }
-        if (rc == SQLITE_DONE) { rc = 0; } /* no record found */
-    }
-    return rc;
+    return env->backend->get_postings(env, token_id,
+                                      first_document_id, last_document_id,
+                                      docs_count, postings, postings_size);
 }
 
 /**
- * 将倒排列表存储到数据库中
+ * 获取倒排列表的下一个块
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。已没有下一个块时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+int
+db_next_postings(const wiser_env *env,
+                 int *first_document_id, int *last_document_id,
+                 int *docs_count, void **postings, int *postings_size)
+{
+    return env->backend->next_postings(env,
+                                       first_document_id, last_document_id,
+                                       docs_count, postings, postings_size);
+}
+
+/**
+ * 打开倒排列表中包含指定文档编号或位于其后的第一个块，以便流式读取
+ * 块中的数据通过db_read_postings_chunk读取
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] token_id 词元编号
- * @param[in] docs_count 倒排列表中的文档数
- * @param[in] postings 待存储的倒排列表
- * @param[in] postings_size 倒排列表的字节数
+ * @param[in] prev_first_document_id 上一个块中最初的文档编号。只获取在其之后的块
+ * @param[in] document_id 文档编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 块中的文档数
+ * @param[in,out] chunk 块的句柄。非NULL时重用该句柄。不存在块时不改变
+ * @param[out] postings_size 块的字节数。不存在块时为0
+ * @retval 0 成功
+ * @retval -1 失败
  */
 int
-db_update_postings(const wiser_env *env, int token_id, int docs_count,
-                   void *postings, int postings_size)
-{
-    int rc;
-    sqlite3_reset(env->update_postings_st);
-    sqlite3_bind_int(env->update_postings_st, 1, docs_count);
-    sqlite3_bind_blob(env->update_postings_st, 2, postings,
-                      (unsigned int) postings_size, SQLITE_STATIC);
-    sqlite3_bind_int(env->update_postings_st, 3, token_id);
-    query:
-    rc = sqlite3_step(env->update_postings_st);
-
-    switch (rc)
-    {
-        case SQLITE_BUSY:
-            goto query;
-        case SQLITE_ERROR:
-            print_error("ERROR: %s", sqlite3_errmsg(env->db));
-            break;
-        case SQLITE_MISUSE:
-            print_error("MISUSE: %s", sqlite3_errmsg(env->db));
-            break;
-    }
-    return rc;
+db_open_postings_chunk(const wiser_env *env, int token_id,
+                       int prev_first_document_id, int document_id,
+                       int *first_document_id, int *last_document_id,
+                       int *docs_count, void **chunk,
+                       int *postings_size)
+{
+    return env->backend->open_postings_chunk(env, token_id,
+                                             prev_first_document_id,
+                                             document_id, first_document_id,
+                                             last_document_id, docs_count,
+                                             chunk, postings_size);
+}
+
+/**
+ * 从打开的块中读取数据
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] chunk 块的句柄
+ * @param[out] buf 读取出的数据
+ * @param[in] size 读取的字节数
+ * @param[in] offset 读取的起始位置
+ * @retval 0 成功
+ */
+int
+db_read_postings_chunk(const wiser_env *env, void *chunk,
+                       void *buf, int size, int offset)
+{
+    return env->backend->read_postings_chunk(env, chunk, buf, size, offset);
+}
+
+/**
+ * 关闭块的句柄
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] chunk 块的句柄。可以为NULL
+ */
+void
+db_close_postings_chunk(const wiser_env *env, void *chunk)
+{
+    env->backend->close_postings_chunk(env, chunk);
 }
 
 /**
- * 从数据库中获取配置信息
+ * 存储1个段中的倒排列表的1个块
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] first_document_id 块中最初的文档编号
+ * @param[in] last_document_id 块中最后的文档编号
+ * @param[in] segment 段的编号
+ * @param[in] docs_count 块中的文档数
+ * @param[in] postings 待存储的块
+ * @param[in] postings_size 块的字节数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+db_insert_postings(const wiser_env *env, int token_id,
+                   int first_document_id, int last_document_id, int segment,
+                   int docs_count, const void *postings, int postings_size)
+{
+    return env->backend->insert_postings(env, token_id, first_document_id,
+                                         last_document_id, segment,
+                                         docs_count, postings, postings_size);
+}
+
+/**
+ * 按词元编号和文档编号的顺序获取编号在指定范围内的段中的第一个块
+ * 其余的倒排列表通过db_next_segment_postings获取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] min_segment 段的编号的最小值
+ * @param[in] max_segment 段的编号的最大值
+ * @param[out] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。不存在时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+int
+db_get_segment_postings(const wiser_env *env,
+                        int min_segment, int max_segment, int *token_id,
+                        int *first_document_id, int *last_document_id,
+                        int *docs_count, void **postings, int *postings_size)
+{
+    return env->backend->get_segment_postings(env, min_segment, max_segment,
+                                              token_id, first_document_id,
+                                              last_document_id, docs_count,
+                                              postings, postings_size);
+}
+
+/**
+ * 获取编号在指定范围内的段中的下一个倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。已没有下一个倒排列表时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+int
+db_next_segment_postings(const wiser_env *env, int *token_id,
+                         int *first_document_id, int *last_document_id,
+                         int *docs_count, void **postings, int *postings_size)
+{
+    return env->backend->next_segment_postings(env, token_id,
+                                               first_document_id,
+                                               last_document_id, docs_count,
+                                               postings, postings_size);
+}
+
+/**
+ * 添加新的段
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] level 段的级别
+ * @return 新的段的编号
+ * @retval -1 失败
+ */
+int
+db_add_segment(const wiser_env *env, int level)
+{
+    return env->backend->add_segment(env, level);
+}
+
+/**
+ * 获取指定级别的段的数量和编号的范围
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] level 段的级别
+ * @param[out] min_segment 段的编号的最小值
+ * @param[out] max_segment 段的编号的最大值
+ * @return 段的数量
+ */
+int
+db_get_segments(const wiser_env *env, int level,
+                int *min_segment, int *max_segment)
+{
+    return env->backend->get_segments(env, level, min_segment, max_segment);
+}
+
+/**
+ * 删除编号在指定范围内的段及其中的所有倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] min_segment 段的编号的最小值
+ * @param[in] max_segment 段的编号的最大值
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+db_delete_segments(const wiser_env *env, int min_segment, int max_segment)
+{
+    return env->backend->delete_segments(env, min_segment, max_segment);
+}
+
+/**
+ * 获取配置信息
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] key 配置项的名称
  * @param[in] key_size 配置项名称的字节数
  * @param[out] value 配置项的取值
  * @param[out] value_size 配置项取值的字节数
+ * @retval 0 成功。配置项不存在时不改变value和value_size
+ * @retval -1 失败
  */
 int
 db_get_settings(const wiser_env *env, const char *key, int key_size,
                 const char **value, int *value_size)
 {
-    int rc;
-
-    sqlite3_reset(env->get_settings_st);
-    sqlite3_bind_text(env->get_settings_st, 1,
-                      key, key_size, SQLITE_STATIC);
-    rc = sqlite3_step(env->get_settings_st);
-    if (rc == SQLITE_ROW)
-    {
-        if (value)
-        {
-            *value = (const char *) sqlite3_column_text(env->get_settings_st, 0);
-        }
-        if (value_size)
-        {
-            *value_size = (int) sqlite3_column_bytes(env->get_settings_st, 0);
-        }
-    }
-    return 0;
+    return env->backend->get_settings(env, key, key_size, value, value_size);
 }
 
 /**
- * 更新存储在数据库中的配置信息
+ * 更新配置信息
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] key 配置项的名称
  * @param[in] key_size 配置项名称的字节数
  * @param[in] value 配置项的取值
  * @param[in] value_size 配置项取值的字节数
+ * @retval 0 成功
+ * @retval -1 失败
  */
 int
 db_replace_settings(const wiser_env *env, const char *key,
                     int key_size,
                     const char *value, int value_size)
 {
-    int rc;
-    sqlite3_reset(env->replace_settings_st);
-    sqlite3_bind_text(env->replace_settings_st, 1,
-                      key, key_size, SQLITE_STATIC);
-    sqlite3_bind_text(env->replace_settings_st, 2,
-                      value, value_size, SQLITE_STATIC);
-    query:
-    rc = sqlite3_step(env->replace_settings_st);
+    return env->backend->replace_settings(env, key, key_size,
+                                          value, value_size);
+}
 
-    switch (rc)
+/**
+ * 获取已添加的文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+int
+db_get_document_count(const wiser_env *env)
+{
+    return env->backend->get_document_count(env);
+}
+
+/**
+ * 按照指定的映射改变所有文档的编号
+ * 文档的编号必须是从1开始的连续的整数，新的编号是它们的排列
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] document_ids_map 各个文档的新的编号。下标为原有的文档编号-1
+ * @param[in] documents_count 文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+db_renumber_documents(const wiser_env *env,
+                      const int *document_ids_map, int documents_count)
+{
+    return env->backend->renumber_documents(env, document_ids_map,
+                                            documents_count);
+}
+
+/* 在settings中存储语料库统计信息时使用的配置项的名称 */
+#define DOCUMENTS_COUNT_KEY "documents_count"
+#define TOKENS_COUNT_KEY "tokens_count"
+
+/**
+ * 根据文档数和词元总数更新缓存的平均文档长度
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static void
+update_average_document_length(wiser_env *env)
+{
+    env->average_document_length =
+            env->indexed_count > 0
+            ? (double) env->indexed_tokens_count / env->indexed_count : 0.0;
+}
+
+/**
+ * 从settings中读取语料库的统计信息（文档数、词元总数），并缓存到env中
+ * 没有统计信息的旧数据库只统计一次文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+db_load_corpus_stats(wiser_env *env)
+{
+    int size = 0;
+    const char *value = NULL;
+    char buf[32];
+
+    if (db_get_settings(env, DOCUMENTS_COUNT_KEY,
+                        sizeof(DOCUMENTS_COUNT_KEY) - 1, &value, &size))
     {
-        case SQLITE_BUSY:
-            goto query;
-        case SQLITE_ERROR:
-            print_error("ERROR: %s", sqlite3_errmsg(env->db));
-            break;
-        case SQLITE_MISUSE:
-            print_error("MISUSE: %s", sqlite3_errmsg(env->db));
-            break;
+        return -1;
     }
-    return rc;
+    if (value && size > 0 && (size_t) size < sizeof(buf))
+    {
+        memcpy(buf, value, size);
+        buf[size] = '\0';
+        env->indexed_count = atoi(buf);
+    }
+    else
+    {
+        if ((env->indexed_count = db_get_document_count(env)) < 0)
+        {
+            env->indexed_count = 0;
+            return -1;
+        }
+    }
+    value = NULL;
+    size = 0;
+    if (db_get_settings(env, TOKENS_COUNT_KEY, sizeof(TOKENS_COUNT_KEY) - 1,
+                        &value, &size))
+    {
+        return -1;
+    }
+    if (value && size > 0 && (size_t) size < sizeof(buf))
+    {
+        memcpy(buf, value, size);
+        buf[size] = '\0';
+        env->indexed_tokens_count = atoll(buf);
+    }
+    else
+    {
+        env->indexed_tokens_count = 0;
+    }
+    update_average_document_length(env);
+    return 0;
 }
 
 /**
- * 获取已添加到数据库中的文档数
+ * 将env中的语料库统计信息写入settings
+ * 在清空缓冲区时与倒排列表在同一个事务中写入，失败时需要由调用者回滚事务
  * @param[in] env 存储着应用程序运行环境的结构体
+ * @retval 0 成功
+ * @retval -1 失败
  */
 int
-db_get_document_count(const wiser_env *env)
+db_save_corpus_stats(wiser_env *env)
 {
-    int rc;
+    int size;
+    char buf[32];
 
-    sqlite3_reset(env->get_document_count_st);
-    rc = sqlite3_step(env->get_document_count_st);
-    if (rc == SQLITE_ROW)
+    update_average_document_length(env);
+    size = snprintf(buf, sizeof(buf), "%d", env->indexed_count);
+    if (db_replace_settings(env,
+                            DOCUMENTS_COUNT_KEY, sizeof(DOCUMENTS_COUNT_KEY) - 1,
+                            buf, size))
     {
-        return sqlite3_column_int(env->get_document_count_st, 0);
+        return -1;
     }
-    else
+    size = snprintf(buf, sizeof(buf), "%lld", env->indexed_tokens_count);
+    if (db_replace_settings(env, TOKENS_COUNT_KEY, sizeof(TOKENS_COUNT_KEY) - 1,
+                            buf, size))
     {
         return -1;
     }
+    return 0;
 }
 
 /**
@@ -476,7 +560,7 @@ db_get_document_count(const wiser_env *env)
 int
 begin(const wiser_env *env)
 {
-    return sqlite3_step(env->begin_st);
+    return env->backend->begin(env);
 }
 
 /**
@@ -486,7 +570,7 @@ begin(const wiser_env *env)
 int
 commit(const wiser_env *env)
 {
-    return sqlite3_step(env->commit_st);
+    return env->backend->commit(env);
 }
 
 /**
@@ -496,5 +580,17 @@ commit(const wiser_env *env)
 int
 rollback(const wiser_env *env)
 {
-    return sqlite3_step(env->rollback_st);
+    return env->backend->rollback(env);
+}
+
+/**
+ * 回收数据库中未使用的空间
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+db_vacuum(const wiser_env *env)
+{
+    return env->backend->vacuum(env);
 }
@@ -1,11 +1,95 @@
 #ifndef __DATABASE_H__
 #define __DATABASE_H__
 
-#include <sqlite3.h>
-
 #include "wiser.h"
 
-int init_database(wiser_env *env, const char *db_path);
+/* 存储后端的操作表
+   文档、词元、倒排列表、段和配置信息的读写都通过它进行，
+   除name外的各个函数与同名的db_*函数含义相同 */
+struct _db_backend
+{
+    const char *name; /* 存储后端的名称 */
+
+    int (*init)(wiser_env *env, const char *db_path);
+    void (*fin)(wiser_env *env);
+
+    int (*get_document_id)(const wiser_env *env,
+                           const char *title, unsigned int title_size);
+    int (*get_document_title)(const wiser_env *env, int document_id,
+                              const char **title, int *title_size);
+    int (*add_document)(const wiser_env *env,
+                        const char *title, unsigned int title_size,
+                        const char *body, unsigned int body_size);
+    int (*get_document_count)(const wiser_env *env);
+    int (*renumber_documents)(const wiser_env *env,
+                              const int *document_ids_map, int documents_count);
+
+    int (*get_token_id)(const wiser_env *env,
+                        const char *str, unsigned int str_size, int insert,
+                        int *docs_count);
+    int (*get_token)(const wiser_env *env, int token_id,
+                     const char **token, int *token_size);
+    int (*get_tokens)(const wiser_env *env, int *token_id,
+                      const char **token, int *token_size, int *docs_count);
+    int (*next_token)(const wiser_env *env, int *token_id,
+                      const char **token, int *token_size, int *docs_count);
+    int (*get_max_token_id)(const wiser_env *env);
+    int (*add_token_docs_count)(const wiser_env *env, int token_id,
+                                int docs_count);
+
+    int (*get_postings)(const wiser_env *env, int token_id,
+                        int *first_document_id, int *last_document_id,
+                        int *docs_count, void **postings, int *postings_size);
+    int (*next_postings)(const wiser_env *env,
+                         int *first_document_id, int *last_document_id,
+                         int *docs_count, void **postings, int *postings_size);
+    int (*open_postings_chunk)(const wiser_env *env, int token_id,
+                               int prev_first_document_id, int document_id,
+                               int *first_document_id, int *last_document_id,
+                               int *docs_count, void **chunk,
+                               int *postings_size);
+    int (*read_postings_chunk)(const wiser_env *env, void *chunk,
+                               void *buf, int size, int offset);
+    void (*close_postings_chunk)(const wiser_env *env, void *chunk);
+    int (*insert_postings)(const wiser_env *env, int token_id,
+                           int first_document_id, int last_document_id,
+                           int segment, int docs_count,
+                           const void *postings, int postings_size);
+    int (*get_segment_postings)(const wiser_env *env,
+                                int min_segment, int max_segment,
+                                int *token_id, int *first_document_id,
+                                int *last_document_id, int *docs_count,
+                                void **postings, int *postings_size);
+    int (*next_segment_postings)(const wiser_env *env, int *token_id,
+                                 int *first_document_id,
+                                 int *last_document_id,
+                                 int *docs_count, void **postings,
+                                 int *postings_size);
+
+    int (*add_segment)(const wiser_env *env, int level);
+    int (*get_segments)(const wiser_env *env, int level,
+                        int *min_segment, int *max_segment);
+    int (*delete_segments)(const wiser_env *env,
+                           int min_segment, int max_segment);
+
+    int (*get_settings)(const wiser_env *env, const char *key, int key_size,
+                        const char **value, int *value_size);
+    int (*replace_settings)(const wiser_env *env, const char *key,
+                            int key_size, const char *value, int value_size);
+
+    int (*begin)(const wiser_env *env);
+    int (*commit)(const wiser_env *env);
+    int (*rollback)(const wiser_env *env);
+
+    int (*vacuum)(const wiser_env *env);
+};
+
+/* 使用sqlite3的存储后端（sqlitedb.c） */
+extern const db_backend sqlite_backend;
+/* 将所有数据保存在内存中的存储后端（memorydb.c） */
+extern const db_backend memory_backend;
+
+int init_database(wiser_env *env, const char *backend, const char *db_path);
 
 void fin_database(wiser_env *env);
 
@@ -27,12 +111,58 @@ int db_get_token(const wiser_env *env,
                  const int token_id,
                  const char **const token, int *token_size);
 
+int db_get_tokens(const wiser_env *env, int *token_id,
+                  const char **token, int *token_size, int *docs_count);
+
+int db_next_token(const wiser_env *env, int *token_id,
+                  const char **token, int *token_size, int *docs_count);
+
+int db_get_max_token_id(const wiser_env *env);
+
+int db_add_token_docs_count(const wiser_env *env, int token_id,
+                            int docs_count);
+
 int db_get_postings(const wiser_env *env, int token_id,
+                    int *first_document_id, int *last_document_id,
                     int *docs_count, void **postings, int *postings_size);
 
-int db_update_postings(const wiser_env *env, int token_id,
-                       int docs_count,
-                       void *postings, int postings_size);
+int db_next_postings(const wiser_env *env,
+                     int *first_document_id, int *last_document_id,
+                     int *docs_count, void **postings, int *postings_size);
+
+int db_open_postings_chunk(const wiser_env *env, int token_id,
+                           int prev_first_document_id, int document_id,
+                           int *first_document_id, int *last_document_id,
+                           int *docs_count, void **chunk,
+                           int *postings_size);
+
+int db_read_postings_chunk(const wiser_env *env, void *chunk,
+                           void *buf, int size, int offset);
+
+void db_close_postings_chunk(const wiser_env *env, void *chunk);
+
+int db_insert_postings(const wiser_env *env, int token_id,
+                       int first_document_id, int last_document_id,
+                       int segment, int docs_count,
+                       const void *postings, int postings_size);
+
+int db_get_segment_postings(const wiser_env *env,
+                            int min_segment, int max_segment, int *token_id,
+                            int *first_document_id, int *last_document_id,
+                            int *docs_count, void **postings,
+                            int *postings_size);
+
+int db_next_segment_postings(const wiser_env *env, int *token_id,
+                             int *first_document_id, int *last_document_id,
+                             int *docs_count, void **postings,
+                             int *postings_size);
+
+int db_add_segment(const wiser_env *env, int level);
+
+int db_get_segments(const wiser_env *env, int level,
+                    int *min_segment, int *max_segment);
+
+int db_delete_segments(const wiser_env *env, int min_segment, int max_segment);
 
 int db_get_settings(const wiser_env *env, const char *key,
                     int key_size,
@@ -44,10 +174,19 @@ int db_replace_settings(const wiser_env *env, const char *key,
 
 int db_get_document_count(const wiser_env *env);
 
+int db_renumber_documents(const wiser_env *env,
+                          const int *document_ids_map, int documents_count);
+
+int db_load_corpus_stats(wiser_env *env);
+
+int db_save_corpus_stats(wiser_env *env);
+
 int begin(const wiser_env *env);
 
 int commit(const wiser_env *env);
 
 int rollback(const wiser_env *env);
 
+int db_vacuum(const wiser_env *env);
+
 #endif /* __DATABASE_H__ */
@@ -0,0 +1,550 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "postings.h"
+#include "database.h"
+#include "indexfile.h"
+
+/* 索引文件的标识和版本 */
+#define INDEX_FILE_MAGIC "WISERIDX"
+#define INDEX_FILE_VERSION 3
+
+/* 倒排列表中没有存储位置信息 */
+#define INDEX_FILE_FLAG_NO_POSITIONS 0x1
+
+/* 词典的每个区块中的词元数 */
+#define INDEX_FILE_DICT_BLOCK_TOKENS 16
+
+/* 索引文件的头部。各区域的位置都是从文件开头算起的偏移量 */
+typedef struct
+{
+    char magic[8];             /* INDEX_FILE_MAGIC */
+    int32_t version;           /* INDEX_FILE_VERSION */
+    int32_t compress;          /* 压缩倒排列表的方法 */
+    int32_t indexed_count;     /* 建立了索引的文档数 */
+    int32_t tokens_count;      /* 词元数 */
+    int32_t max_token_id;      /* 词元编号的最大值 */
+    int32_t flags;             /* INDEX_FILE_FLAG_*的组合 */
+    uint64_t dict_blocks_offset; /* 词典中各个区块的起始位置（uint32_t的数组） */
+    uint64_t dict_blocks_count;
+    uint64_t dict_offset;      /* 按词元排序、经过前缀压缩的词典 */
+    uint64_t dict_size;
+    uint64_t token_ids_offset; /* 以词元编号为下标的index_file_token_id的数组 */
+    uint64_t chunks_offset;    /* 所有倒排列表的块（index_file_chunk的数组） */
+    uint64_t chunks_count;
+    uint64_t postings_offset;  /* 依次连接起来的所有块的数据 */
+    uint64_t postings_size;
+} index_file_header;
+
+/* 词典按词元的字节序排列，每INDEX_FILE_DICT_BLOCK_TOKENS个词元构成1个区块。
+   区块中的每个词元依次由以下各项组成，均为vbyte编码的整数或字节序列：
+     与前一个词元共同的前缀的字节数（区块中的第一个词元总是0）、
+     其余部分的字节数、其余部分的字节序列、词元编号
+   因此区块中的第一个词元是完整的，可以在各个区块的第一个词元之间二分查找 */
+
+/* 从词元编号到倒排列表的映射 */
+typedef struct
+{
+    uint32_t chunks_start;     /* 该词元的第一个块的下标 */
+    uint32_t chunks_count;     /* 该词元的块数 */
+    int32_t docs_count;        /* 出现过该词元的文档数 */
+} index_file_token_id;
+
+/* 倒排列表中的1个块。格式与数据库中的块相同 */
+typedef struct
+{
+    int32_t first_document_id; /* 块中最初的文档编号 */
+    int32_t last_document_id;  /* 块中最后的文档编号 */
+    int32_t docs_count;        /* 块中的文档数 */
+    int32_t size;              /* 块的字节数 */
+    uint64_t offset;           /* 块在倒排列表区域中的位置 */
+} index_file_chunk;
+
+/* 通过mmap打开的索引文件 */
+struct _index_file
+{
+    const char *map;                     /* 映射到内存中的整个文件 */
+    size_t map_size;                     /* 文件的字节数 */
+    const index_file_header *header;
+    const uint32_t *dict_blocks;
+    const char *dict;
+    const index_file_token_id *token_ids;
+    const index_file_chunk *chunks;
+    const char *postings;
+};
+
+/**
+ * 将数据写入文件，并在写入失败时报错
+ * @param[in] fp 文件
+ * @param[in] data 待写入的数据
+ * @param[in] size 待写入的数据的字节数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+write_index_file(FILE *fp, const void *data, size_t size)
+{
+    if (size && fwrite(data, 1, size, fp) != size)
+    {
+        print_error("cannot write index file.");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 将无符号整数进行vbyte编码后追加到缓冲区中
+ * @param[in,out] buf 缓冲区
+ * @param[in] n 待编码的整数
+ */
+static void
+append_buffer_vbyte(buffer *buf, unsigned int n)
+{
+    unsigned char c;
+    /* 每个字节存储7个比特，最高位为1表示还有后续的字节 */
+    while (n >= 0x80)
+    {
+        c = (unsigned char) ((n & 0x7f) | 0x80);
+        append_buffer(buf, &c, 1);
+        n >>= 7;
+    }
+    c = (unsigned char) n;
+    append_buffer(buf, &c, 1);
+}
+
+/**
+ * 从字节序列中读取1个vbyte编码的无符号整数
+ * @param[in,out] p 读取的位置。读取后指向下一个字节
+ * @param[in] end 字节序列的结尾
+ * @param[out] n 读取到的整数
+ * @retval 0 成功
+ * @retval 1 字节序列在整数的中途结束
+ */
+static int
+read_vbyte(const unsigned char **p, const unsigned char *end, unsigned int *n)
+{
+    int shift = 0;
+    *n = 0;
+    while (*p < end && shift < 32)
+    {
+        unsigned int c = *(*p)++;
+        *n |= (c & 0x7f) << shift;
+        if (!(c & 0x80)) { return 0; }
+        shift += 7;
+    }
+    return 1;
+}
+
+/**
+ * 将数据库中的词典和倒排索引导出到只读的索引文件中
+ * 文件依次由头部、倒排列表、块的数组、词典的区块的位置、以词元编号为下标的数组和词典组成
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] path 索引文件的路径
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+export_index_file(const wiser_env *env, const char *path)
+{
+    int rc = -1, token_id, docs_count, token_size, prev_token_size = 0;
+    const char *token;
+    char *prev_token = NULL;
+    FILE *fp;
+    index_file_header header;
+    index_file_token_id *token_ids = NULL;
+    buffer *blocks = NULL, *dict = NULL, *chunks = NULL;
+
+    if (!(fp = fopen(path, "wb")))
+    {
+        print_error("cannot open %s.", path);
+        return -1;
+    }
+    memset(&header, 0, sizeof(index_file_header));
+    memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic));
+    header.version = INDEX_FILE_VERSION;
+    header.compress = env->compress;
+    header.indexed_count = env->indexed_count;
+    if (!env->store_positions)
+    {
+        header.flags |= INDEX_FILE_FLAG_NO_POSITIONS;
+    }
+    header.max_token_id = db_get_max_token_id(env);
+    header.postings_offset = sizeof(index_file_header);
+    if (!(blocks = alloc_buffer()) || !(dict = alloc_buffer()) ||
+        !(chunks = alloc_buffer()) ||
+        !(token_ids = (index_file_token_id *) calloc(
+                header.max_token_id + 1, sizeof(index_file_token_id))))
+    {
+        print_error("cannot allocate memory for exporting index.");
+        goto exit;
+    }
+    if (write_index_file(fp, &header, sizeof(index_file_header)))
+    {
+        goto exit;
+    }
+
+    /* 按词元的顺序写出倒排列表，同时在内存中生成词典和块的数组 */
+    for (rc = db_get_tokens(env, &token_id, &token, &token_size, &docs_count);
+         !rc && token; rc = db_next_token(env, &token_id, &token, &token_size,
+                                          &docs_count))
+    {
+        char *e;
+        int e_size, chunk_docs_count, prefix = 0;
+        int first_document_id, last_document_id;
+
+        /* 区块中第二个以后的词元只存储与前一个词元不同的部分 */
+        if (header.tokens_count % INDEX_FILE_DICT_BLOCK_TOKENS)
+        {
+            while (prefix < prev_token_size && prefix < token_size &&
+                   prev_token[prefix] == token[prefix]) { prefix++; }
+        }
+        else
+        {
+            uint32_t offset = (uint32_t) BUFFER_SIZE(dict);
+            append_buffer(blocks, &offset, sizeof(uint32_t));
+            header.dict_blocks_count++;
+        }
+        append_buffer_vbyte(dict, prefix);
+        append_buffer_vbyte(dict, token_size - prefix);
+        append_buffer(dict, token + prefix, token_size - prefix);
+        append_buffer_vbyte(dict, token_id);
+        header.tokens_count++;
+        {
+            char *t;
+            if (!(t = realloc(prev_token, token_size + 1)))
+            {
+                print_error("cannot allocate memory for exporting index.");
+                rc = -1;
+                break;
+            }
+            prev_token = t;
+            memcpy(prev_token, token, token_size);
+            prev_token_size = token_size;
+        }
+
+        if (token_id < 0 || token_id > header.max_token_id) { continue; }
+        token_ids[token_id].chunks_start = (uint32_t) header.chunks_count;
+        token_ids[token_id].docs_count = docs_count;
+        for (rc = db_get_postings(env, token_id, &first_document_id,
+                                  &last_document_id, &chunk_docs_count,
+                                  (void **) &e, &e_size);
+             !rc && e; rc = db_next_postings(env, &first_document_id,
+                                             &last_document_id,
+                                             &chunk_docs_count,
+                                             (void **) &e, &e_size))
+        {
+            index_file_chunk c;
+
+            c.first_document_id = first_document_id;
+            c.last_document_id = last_document_id;
+            c.docs_count = chunk_docs_count;
+            c.size = e_size;
+            c.offset = header.postings_size;
+            if (write_index_file(fp, e, e_size))
+            {
+                rc = -1;
+                break;
+            }
+            append_buffer(chunks, &c, sizeof(index_file_chunk));
+            header.postings_size += e_size;
+            header.chunks_count++;
+            token_ids[token_id].chunks_count++;
+        }
+        if (rc) { break; }
+    }
+    if (rc) { goto exit; }
+
+    /* 使各区域按8字节对齐 */
+    {
+        static const char pad[8];
+        size_t n = (8 - header.postings_size % 8) % 8;
+        if (write_index_file(fp, pad, n)) { goto exit; }
+        header.chunks_offset = header.postings_offset + header.postings_size + n;
+        header.dict_blocks_offset = header.chunks_offset + BUFFER_SIZE(chunks);
+        header.token_ids_offset = header.dict_blocks_offset +
+                                  BUFFER_SIZE(blocks);
+        header.dict_offset = header.token_ids_offset +
+                             sizeof(index_file_token_id) *
+                             (header.max_token_id + 1);
+        header.dict_size = BUFFER_SIZE(dict);
+    }
+    rc = -1;
+    if (write_index_file(fp, BUFFER_PTR(chunks), BUFFER_SIZE(chunks)) ||
+        write_index_file(fp, BUFFER_PTR(blocks), BUFFER_SIZE(blocks)) ||
+        write_index_file(fp, token_ids, sizeof(index_file_token_id) *
+                                        (header.max_token_id + 1)) ||
+        write_index_file(fp, BUFFER_PTR(dict), BUFFER_SIZE(dict)) ||
+        fseek(fp, 0, SEEK_SET) ||
+        write_index_file(fp, &header, sizeof(index_file_header)))
+    {
+        goto exit;
+    }
+    rc = 0;
+    print_error("index exported. (tokens: %d, chunks: %llu, postings: %.2lf MiB,"
+                " dictionary: %.2lf KiB)",
+                header.tokens_count, (unsigned long long) header.chunks_count,
+                (double) header.postings_size / (1024 * 1024),
+                (double) (BUFFER_SIZE(blocks) + BUFFER_SIZE(dict)) / 1024);
+exit:
+    if (fclose(fp)) { rc = -1; }
+    if (rc) { unlink(path); }
+    free(token_ids);
+    free(prev_token);
+    if (chunks) { free_buffer(chunks); }
+    if (dict) { free_buffer(dict); }
+    if (blocks) { free_buffer(blocks); }
+    return rc;
+}
+
+/**
+ * 通过mmap打开索引文件
+ * @param[in] path 索引文件的路径
+ * @return 打开的索引文件。失败时为NULL
+ */
+index_file *
+open_index_file(const char *path)
+{
+    int fd;
+    struct stat st;
+    void *map;
+    index_file *f;
+    const index_file_header *h;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+    {
+        print_error("cannot open %s.", path);
+        return NULL;
+    }
+    if (fstat(fd, &st) || st.st_size < (off_t) sizeof(index_file_header))
+    {
+        print_error("invalid index file: %s.", path);
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        print_error("cannot mmap %s.", path);
+        return NULL;
+    }
+    h = (const index_file_header *) map;
+    if (memcmp(h->magic, INDEX_FILE_MAGIC, sizeof(h->magic)) ||
+        h->version != INDEX_FILE_VERSION ||
+        h->max_token_id < 0 ||
+        h->postings_offset + h->postings_size > (uint64_t) st.st_size ||
+        h->chunks_offset + h->chunks_count * sizeof(index_file_chunk) >
+        (uint64_t) st.st_size ||
+        h->dict_blocks_offset + h->dict_blocks_count * sizeof(uint32_t) >
+        (uint64_t) st.st_size ||
+        h->token_ids_offset +
+        (h->max_token_id + 1) * sizeof(index_file_token_id) >
+        (uint64_t) st.st_size ||
+        h->dict_offset + h->dict_size > (uint64_t) st.st_size)
+    {
+        print_error("invalid index file: %s.", path);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    if (!(f = (index_file *) malloc(sizeof(index_file))))
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    f->map = (const char *) map;
+    f->map_size = st.st_size;
+    f->header = h;
+    f->dict_blocks = (const uint32_t *) (f->map + h->dict_blocks_offset);
+    f->dict = f->map + h->dict_offset;
+    f->token_ids = (const index_file_token_id *) (f->map + h->token_ids_offset);
+    f->chunks = (const index_file_chunk *) (f->map + h->chunks_offset);
+    f->postings = f->map + h->postings_offset;
+    return f;
+}
+
+/**
+ * 关闭索引文件
+ * @param[in] f 索引文件。可以为NULL
+ */
+void
+close_index_file(index_file *f)
+{
+    if (f)
+    {
+        munmap((void *) f->map, f->map_size);
+        free(f);
+    }
+}
+
+/**
+ * 获取索引文件中记录的压缩方法、文档数和是否存储了位置信息
+ * @param[in] f 索引文件
+ * @param[out] compress 压缩倒排列表的方法
+ * @param[out] indexed_count 建立了索引的文档数
+ * @param[out] store_positions 倒排列表中是否存储了位置信息
+ */
+void
+get_index_file_settings(const index_file *f, compress_method *compress,
+                        int *indexed_count, int *store_positions)
+{
+    *compress = (compress_method) f->header->compress;
+    *indexed_count = f->header->indexed_count;
+    *store_positions =
+            !(f->header->flags & INDEX_FILE_FLAG_NO_POSITIONS);
+}
+
+/**
+ * 比较两个字节序列。与SQLite的BINARY排序规则一致，按字节比较
+ * @param[in] a 字节序列
+ * @param[in] a_size a的字节数
+ * @param[in] b 字节序列
+ * @param[in] b_size b的字节数
+ * @return 比较的结果
+ */
+static int
+compare_bytes(const void *a, unsigned int a_size,
+              const void *b, unsigned int b_size)
+{
+    int c = memcmp(a, b, a_size < b_size ? a_size : b_size);
+    return c ? c : (a_size > b_size) - (a_size < b_size);
+}
+
+/**
+ * 在索引文件的词典中查找词元，获取其编号
+ * 先在各个区块的第一个词元之间二分查找，再在找到的区块中依次比较。
+ * 依次比较时只需比较与查询的词元共同的前缀之后的部分，无需复原各个词元
+ * @param[in] f 索引文件
+ * @param[in] token 词元（UTF-8）
+ * @param[in] token_size 词元的字节数
+ * @param[out] docs_count 出现过该词元的文档数
+ * @return 词元编号。找不到时为0
+ */
+int
+index_file_get_token_id(const index_file *f,
+                        const char *token, unsigned int token_size,
+                        int *docs_count)
+{
+    const unsigned char *p, *end, *dict = (const unsigned char *) f->dict;
+    const unsigned char *t = (const unsigned char *) token;
+    unsigned int prefix, size, id, matched = 0;
+    int i, lo = 0, hi = (int) f->header->dict_blocks_count;
+
+    if (docs_count) { *docs_count = 0; }
+
+    /* 找出第一个词元小于等于查询的词元的最后一个区块 */
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        p = dict + f->dict_blocks[mid];
+        end = dict + f->header->dict_size;
+        if (p >= end || read_vbyte(&p, end, &prefix) ||
+            read_vbyte(&p, end, &size) || size > (unsigned int) (end - p))
+        {
+            return 0;
+        }
+        if (compare_bytes(p, size, t, token_size) <= 0) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    if (!lo) { return 0; }
+    p = dict + f->dict_blocks[lo - 1];
+    end = dict + (lo < (int) f->header->dict_blocks_count ?
+                  f->dict_blocks[lo] : f->header->dict_size);
+    if (p > end || end > dict + f->header->dict_size) { return 0; }
+
+    /* matched是查询的词元与当前的词元共同的前缀的字节数。
+       区块中的词元按升序排列，当前的词元小于查询的词元时，
+       若下一个词元与当前的词元共同的前缀比matched长，则它同样小于查询的词元；
+       若比matched短，则它大于查询的词元 */
+    for (i = 0; i < INDEX_FILE_DICT_BLOCK_TOKENS && p < end; i++)
+    {
+        int found = 0;
+
+        if (read_vbyte(&p, end, &prefix) || read_vbyte(&p, end, &size) ||
+            size > (unsigned int) (end - p) || prefix < matched)
+        {
+            return 0;
+        }
+        if (prefix == matched)
+        {
+            const unsigned char *s = p, *s_end = p + size;
+            while (s < s_end && matched < token_size && *s == t[matched])
+            {
+                s++;
+                matched++;
+            }
+            if (s == s_end)
+            {
+                found = matched == token_size;
+            }
+            else if (matched == token_size || *s > t[matched])
+            {
+                /* 当前的词元大于查询的词元 */
+                return 0;
+            }
+        }
+        p += size;
+        if (read_vbyte(&p, end, &id)) { return 0; }
+        if (found)
+        {
+            if (id > (unsigned int) f->header->max_token_id) { return 0; }
+            if (docs_count) { *docs_count = f->token_ids[id].docs_count; }
+            return (int) id;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 获取索引文件中的倒排列表中包含指定文档编号或位于其后的第一个块
+ * 块中的数据不会被复制，直接返回映射到内存中的地址
+ * @param[in] f 索引文件
+ * @param[in] token_id 词元编号
+ * @param[in] prev_first_document_id 上一个块中最初的文档编号。只获取在其之后的块
+ * @param[in] document_id 文档编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 块中的文档数
+ * @param[out] postings 块的数据。不存在时为NULL
+ * @param[out] postings_size 块的字节数
+ * @retval 0 成功
+ */
+int
+index_file_get_postings_chunk(const index_file *f, int token_id,
+                              int prev_first_document_id, int document_id,
+                              int *first_document_id,
+                              int *last_document_id, int *docs_count,
+                              const char **postings, int *postings_size)
+{
+    *first_document_id = *last_document_id = *docs_count = 0;
+    *postings = NULL;
+    *postings_size = 0;
+    if (token_id > 0 && token_id <= f->header->max_token_id)
+    {
+        const index_file_token_id *t = f->token_ids + token_id;
+        const index_file_chunk *c = f->chunks + t->chunks_start;
+        int lo = 0, hi = t->chunks_count;
+
+        /* 各个块中的文档编号按块的顺序递增，因此可以二分查找 */
+        while (lo < hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+            if (c[mid].last_document_id < document_id) { lo = mid + 1; }
+            else { hi = mid; }
+        }
+        for (; lo < (int) t->chunks_count &&
+               c[lo].first_document_id <= prev_first_document_id; lo++) {}
+        if (lo < (int) t->chunks_count)
+        {
+            *first_document_id = c[lo].first_document_id;
+            *last_document_id = c[lo].last_document_id;
+            *docs_count = c[lo].docs_count;
+            *postings = f->postings + c[lo].offset;
+            *postings_size = c[lo].size;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef __INDEXFILE_H__
+#define __INDEXFILE_H__
+
+#include "wiser.h"
+
+int export_index_file(const wiser_env *env, const char *path);
+
+index_file *open_index_file(const char *path);
+
+void close_index_file(index_file *f);
+
+void get_index_file_settings(const index_file *f, compress_method *compress,
+                             int *indexed_count, int *store_positions);
+
+int index_file_get_token_id(const index_file *f,
+                            const char *token, unsigned int token_size,
+                            int *docs_count);
+
+int index_file_get_postings_chunk(const index_file *f, int token_id,
+                                  int prev_first_document_id, int document_id,
+                                  int *first_document_id,
+                                  int *last_document_id, int *docs_count,
+                                  const char **postings, int *postings_size);
+
+#endif /* __INDEXFILE_H__ */
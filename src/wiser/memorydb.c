@@ -0,0 +1,1048 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "database.h"
+
+/* 文档 */
+typedef struct
+{
+    int id;             /* 文档编号 */
+    char *title;        /* 文档标题 */
+    int title_size;     /* 文档标题的字节数 */
+    char *body;         /* 文档正文 */
+    int body_size;      /* 文档正文的字节数 */
+    UT_hash_handle hh;  /* 以文档标题为键的哈希表的句柄 */
+} memory_document;
+
+/* 1个段中的倒排列表的1个块 */
+typedef struct
+{
+    int token_id;          /* 词元编号 */
+    int first_document_id; /* 块中最初的文档编号 */
+    int last_document_id;  /* 块中最后的文档编号 */
+    int segment;           /* 段的编号 */
+    int docs_count;        /* 块中的文档数 */
+    char *postings;        /* 块 */
+    int postings_size;     /* 块的字节数 */
+} memory_chunk;
+
+/* 词元 */
+typedef struct
+{
+    int id;             /* 词元编号 */
+    char *token;        /* 词元（UTF-8） */
+    int token_size;     /* 词元的字节数 */
+    int docs_count;     /* 出现过该词元的文档数 */
+    UT_array *chunks;   /* 块的指针的数组。按文档编号和段的编号排序 */
+    UT_hash_handle hh;  /* 以词元为键的哈希表的句柄 */
+} memory_token;
+
+/* 段 */
+typedef struct
+{
+    int id;    /* 段的编号 */
+    int level; /* 段的级别 */
+} memory_segment;
+
+/* 配置项 */
+typedef struct
+{
+    char *key;          /* 配置项的名称 */
+    char *value;        /* 配置项的取值 */
+    int value_size;     /* 配置项取值的字节数 */
+    UT_hash_handle hh;  /* 以配置项的名称为键的哈希表的句柄 */
+} memory_setting;
+
+/* 将所有数据保存在内存中的存储后端的实例
+   用于在不受存储开销影响的情况下测量分词和编码的性能。进程结束时数据会丢失 */
+typedef struct
+{
+    memory_document *documents; /* 以文档标题为键的哈希表 */
+    UT_array *documents_by_id;  /* 以文档编号减1为下标的文档的指针的数组 */
+    memory_token *tokens;       /* 以词元为键的哈希表 */
+    UT_array *tokens_by_id;     /* 以词元编号减1为下标的词元的指针的数组 */
+    UT_array *segments;         /* 段的数组。按段的编号排序 */
+    memory_setting *settings;   /* 以配置项的名称为键的哈希表 */
+
+    /* db_get_tokens和db_next_token的读取状态 */
+    UT_array *sorted_tokens;    /* 按字节顺序排序的词元的指针的数组 */
+    unsigned int next_token;    /* 下一个要读取的词元在sorted_tokens中的位置 */
+    /* db_get_postings和db_next_postings的读取状态 */
+    memory_token *postings_token; /* 正在读取其倒排列表的词元 */
+    unsigned int next_chunk;      /* 下一个要读取的块在postings_token中的位置 */
+    /* db_get_segment_postings和db_next_segment_postings的读取状态 */
+    UT_array *segment_chunks;     /* 待读取的块的指针的数组 */
+    unsigned int next_segment_chunk; /* 下一个要读取的块在segment_chunks中的位置 */
+} memory_db;
+
+static UT_icd memory_segment_icd = {sizeof(memory_segment), NULL, NULL, NULL};
+
+/**
+ * 复制一段二进制序列，并在结尾添加0
+ * @param[in] data 待复制的二进制序列
+ * @param[in] size 二进制序列的字节数
+ * @return 复制出的二进制序列。失败时为NULL
+ */
+static char *
+memorydb_copy(const void *data, int size)
+{
+    char *copy;
+    if ((copy = malloc(size + 1)))
+    {
+        memcpy(copy, data, size);
+        copy[size] = '\0';
+    }
+    return copy;
+}
+
+/**
+ * 初始化内存中的数据库
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] db_path 数据库的路径。不使用
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+memorydb_init(wiser_env *env, const char *db_path)
+{
+    memory_db *m;
+
+    (void) db_path;
+
+    if (!(m = calloc(1, sizeof(memory_db))))
+    {
+        print_error("cannot allocate memory for database.");
+        return -1;
+    }
+    utarray_new(m->documents_by_id, &ut_ptr_icd);
+    utarray_new(m->tokens_by_id, &ut_ptr_icd);
+    utarray_new(m->segments, &memory_segment_icd);
+    utarray_new(m->sorted_tokens, &ut_ptr_icd);
+    utarray_new(m->segment_chunks, &ut_ptr_icd);
+    env->db = m;
+    return 0;
+}
+
+/**
+ * 释放内存中的数据库
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static void
+memorydb_fin(wiser_env *env)
+{
+    memory_db *m = env->db;
+    memory_document *d, *dtmp;
+    memory_token *t, *ttmp;
+    memory_setting *s, *stmp;
+
+    HASH_ITER(hh, m->documents, d, dtmp)
+    {
+        HASH_DEL(m->documents, d);
+        free(d->title);
+        free(d->body);
+        free(d);
+    }
+    HASH_ITER(hh, m->tokens, t, ttmp)
+    {
+        memory_chunk **c;
+        HASH_DEL(m->tokens, t);
+        for (c = (memory_chunk **) utarray_front(t->chunks); c;
+             c = (memory_chunk **) utarray_next(t->chunks, c))
+        {
+            free((*c)->postings);
+            free(*c);
+        }
+        utarray_free(t->chunks);
+        free(t->token);
+        free(t);
+    }
+    HASH_ITER(hh, m->settings, s, stmp)
+    {
+        HASH_DEL(m->settings, s);
+        free(s->key);
+        free(s->value);
+        free(s);
+    }
+    utarray_free(m->documents_by_id);
+    utarray_free(m->tokens_by_id);
+    utarray_free(m->segments);
+    utarray_free(m->sorted_tokens);
+    utarray_free(m->segment_chunks);
+    free(m);
+    env->db = NULL;
+}
+
+/**
+ * 根据指定的文档标题获取文档编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] title 文档标题
+ * @param[in] title_size 文档标题的字节数
+ * @return 文档编号。不存在时为0
+ */
+static int
+memorydb_get_document_id(const wiser_env *env,
+                         const char *title, unsigned int title_size)
+{
+    memory_db *m = env->db;
+    memory_document *d;
+
+    HASH_FIND(hh, m->documents, title, title_size, d);
+    return d ? d->id : 0;
+}
+
+/**
+ * 根据指定的文档编号获取文档标题
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] document_id 文档编号
+ * @param[out] title 文档标题
+ * @param[out] title_size 文档标题的字节数
+ */
+static int
+memorydb_get_document_title(const wiser_env *env, int document_id,
+                            const char **title, int *title_size)
+{
+    memory_db *m = env->db;
+
+    if (document_id > 0 &&
+        (unsigned int) document_id <= utarray_len(m->documents_by_id))
+    {
+        memory_document *d = *(memory_document **) utarray_eltptr(
+                m->documents_by_id, (unsigned int) document_id - 1);
+        if (title) { *title = d->title; }
+        if (title_size) { *title_size = d->title_size; }
+    }
+    return 0;
+}
+
+/**
+ * 添加文档。已存在相同标题的文档时，更新其正文
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] title 文档标题
+ * @param[in] title_size 文档标题的字节数
+ * @param[in] body 文档正文
+ * @param[in] body_size 文档正文的字节数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+memorydb_add_document(const wiser_env *env,
+                      const char *title, unsigned int title_size,
+                      const char *body, unsigned int body_size)
+{
+    memory_db *m = env->db;
+    memory_document *d;
+    char *body_copy;
+
+    if (!(body_copy = memorydb_copy(body, body_size)))
+    {
+        print_error("cannot allocate memory for document.");
+        return -1;
+    }
+    HASH_FIND(hh, m->documents, title, title_size, d);
+    if (!d)
+    {
+        if (!(d = calloc(1, sizeof(memory_document))) ||
+            !(d->title = memorydb_copy(title, title_size)))
+        {
+            print_error("cannot allocate memory for document.");
+            free(d);
+            free(body_copy);
+            return -1;
+        }
+        d->title_size = title_size;
+        utarray_push_back(m->documents_by_id, &d);
+        d->id = utarray_len(m->documents_by_id);
+        HASH_ADD_KEYPTR(hh, m->documents, d->title, d->title_size, d);
+    }
+    free(d->body);
+    d->body = body_copy;
+    d->body_size = body_size;
+    return 0;
+}
+
+/**
+ * 获取已添加的文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+memorydb_get_document_count(const wiser_env *env)
+{
+    memory_db *m = env->db;
+    return utarray_len(m->documents_by_id);
+}
+
+/**
+ * 按照指定的映射改变所有文档的编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] document_ids_map 各个文档的新的编号。下标为原有的文档编号-1
+ * @param[in] documents_count 文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+memorydb_renumber_documents(const wiser_env *env,
+                            const int *document_ids_map, int documents_count)
+{
+    memory_db *m = env->db;
+    memory_document **documents;
+    int i;
+
+    if (documents_count != (int) utarray_len(m->documents_by_id))
+    {
+        print_error("invalid documents count. (%d)", documents_count);
+        return -1;
+    }
+    if (!(documents = malloc(sizeof(memory_document *) * documents_count)))
+    {
+        print_error("cannot allocate memory for renumbering documents.");
+        return -1;
+    }
+    for (i = 0; i < documents_count; i++)
+    {
+        documents[i] = *(memory_document **) utarray_eltptr(
+                m->documents_by_id, (unsigned int) i);
+    }
+    for (i = 0; i < documents_count; i++)
+    {
+        documents[i]->id = document_ids_map[i];
+        *(memory_document **) utarray_eltptr(
+                m->documents_by_id, (unsigned int) document_ids_map[i] - 1) =
+                documents[i];
+    }
+    free(documents);
+    return 0;
+}
+
+/**
+ * 获取指定词元的编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] str 词元（UTF-8）
+ * @param[in] str_size 词元的字节数
+ * @param[in] insert 当找不到指定词元时，是否要添加该词元
+ * @param[out] docs_count 出现过指定词元的文档数
+ * @return 词元编号。不存在时为0
+ */
+static int
+memorydb_get_token_id(const wiser_env *env,
+                      const char *str, unsigned int str_size, int insert,
+                      int *docs_count)
+{
+    memory_db *m = env->db;
+    memory_token *t;
+
+    HASH_FIND(hh, m->tokens, str, str_size, t);
+    if (!t && insert)
+    {
+        if (!(t = calloc(1, sizeof(memory_token))) ||
+            !(t->token = memorydb_copy(str, str_size)))
+        {
+            print_error("cannot allocate memory for token.");
+            free(t);
+            t = NULL;
+        }
+        else
+        {
+            t->token_size = str_size;
+            utarray_new(t->chunks, &ut_ptr_icd);
+            utarray_push_back(m->tokens_by_id, &t);
+            t->id = utarray_len(m->tokens_by_id);
+            HASH_ADD_KEYPTR(hh, m->tokens, t->token, t->token_size, t);
+        }
+    }
+    if (docs_count) { *docs_count = t ? t->docs_count : 0; }
+    return t ? t->id : 0;
+}
+
+/**
+ * 根据词元编号获取词元
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @return 词元。不存在时为NULL
+ */
+static memory_token *
+memorydb_find_token(const wiser_env *env, int token_id)
+{
+    memory_db *m = env->db;
+
+    if (token_id <= 0 ||
+        (unsigned int) token_id > utarray_len(m->tokens_by_id))
+    {
+        return NULL;
+    }
+    return *(memory_token **) utarray_eltptr(m->tokens_by_id,
+                                             (unsigned int) token_id - 1);
+}
+
+/**
+ * 根据词元编号获取词元
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[out] token 词元（UTF-8）
+ * @param[out] token_size 词元的字节数
+ */
+static int
+memorydb_get_token(const wiser_env *env, int token_id,
+                   const char **token, int *token_size)
+{
+    memory_token *t;
+
+    if ((t = memorydb_find_token(env, token_id)))
+    {
+        if (token) { *token = t->token; }
+        if (token_size) { *token_size = t->token_size; }
+    }
+    return 0;
+}
+
+/**
+ * 按字节顺序比较两个词元
+ * @param[in] a 指向词元的指针的指针
+ * @param[in] b 指向词元的指针的指针
+ * @return 比较的结果
+ */
+static int
+memorydb_token_cmp(const void *a, const void *b)
+{
+    const memory_token *ta = *(memory_token *const *) a;
+    const memory_token *tb = *(memory_token *const *) b;
+    int rc = memcmp(ta->token, tb->token, ta->token_size < tb->token_size
+                                          ? ta->token_size : tb->token_size);
+    return rc ? rc : ta->token_size - tb->token_size;
+}
+
+/**
+ * 按词元（UTF-8）的字节顺序获取下一个词元
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] token 词元（UTF-8）。已没有词元时为NULL
+ * @param[out] token_size 词元的字节数
+ * @param[out] docs_count 出现过该词元的文档数
+ */
+static int
+memorydb_next_token(const wiser_env *env, int *token_id,
+                    const char **token, int *token_size, int *docs_count)
+{
+    memory_db *m = env->db;
+
+    if (m->next_token < utarray_len(m->sorted_tokens))
+    {
+        memory_token *t = *(memory_token **) utarray_eltptr(m->sorted_tokens,
+                                                            m->next_token);
+        m->next_token++;
+        *token_id = t->id;
+        *token = t->token;
+        *token_size = t->token_size;
+        *docs_count = t->docs_count;
+        return 0;
+    }
+    *token_id = *token_size = *docs_count = 0;
+    *token = NULL;
+    return 0;
+}
+
+/**
+ * 按词元（UTF-8）的字节顺序获取第一个词元
+ * 其余的词元通过db_next_token获取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] token 词元（UTF-8）。已没有词元时为NULL
+ * @param[out] token_size 词元的字节数
+ * @param[out] docs_count 出现过该词元的文档数
+ */
+static int
+memorydb_get_tokens(const wiser_env *env, int *token_id,
+                    const char **token, int *token_size, int *docs_count)
+{
+    memory_db *m = env->db;
+
+    utarray_clear(m->sorted_tokens);
+    utarray_concat(m->sorted_tokens, m->tokens_by_id);
+    utarray_sort(m->sorted_tokens, memorydb_token_cmp);
+    m->next_token = 0;
+    return memorydb_next_token(env, token_id, token, token_size, docs_count);
+}
+
+/**
+ * 获取词元编号的最大值
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @return 词元编号的最大值。没有词元时为0
+ */
+static int
+memorydb_get_max_token_id(const wiser_env *env)
+{
+    memory_db *m = env->db;
+    return utarray_len(m->tokens_by_id);
+}
+
+/**
+ * 增加出现过指定词元的文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] docs_count 新增的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+memorydb_add_token_docs_count(const wiser_env *env, int token_id,
+                              int docs_count)
+{
+    memory_token *t;
+
+    if (!(t = memorydb_find_token(env, token_id))) { return -1; }
+    t->docs_count += docs_count;
+    return 0;
+}
+
+/**
+ * 获取词元的倒排列表中的第i个块
+ * @param[in] t 词元
+ * @param[in] i 块的位置
+ * @return 块
+ */
+static inline memory_chunk *
+memorydb_chunk_at(const memory_token *t, unsigned int i)
+{
+    return *(memory_chunk **) utarray_eltptr(t->chunks, i);
+}
+
+/**
+ * 获取词元的倒排列表中最初的文档编号不小于指定值的第一个块的位置
+ * @param[in] t 词元
+ * @param[in] document_id 文档编号
+ * @return 块的位置。不存在这样的块时为块数
+ */
+static unsigned int
+memorydb_lower_bound(const memory_token *t, int document_id)
+{
+    unsigned int lo = 0, hi = utarray_len(t->chunks);
+    while (lo < hi)
+    {
+        unsigned int mid = (lo + hi) / 2;
+        if (memorydb_chunk_at(t, mid)->first_document_id < document_id)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * 获取倒排列表的下一个块
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。已没有下一个块时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+memorydb_next_postings(const wiser_env *env,
+                       int *first_document_id, int *last_document_id,
+                       int *docs_count, void **postings, int *postings_size)
+{
+    memory_db *m = env->db;
+    memory_chunk *c = NULL;
+
+    if (m->postings_token &&
+        m->next_chunk < utarray_len(m->postings_token->chunks))
+    {
+        c = memorydb_chunk_at(m->postings_token, m->next_chunk++);
+    }
+    if (first_document_id)
+    {
+        *first_document_id = c ? c->first_document_id : 0;
+    }
+    if (last_document_id) { *last_document_id = c ? c->last_document_id : 0; }
+    if (docs_count) { *docs_count = c ? c->docs_count : 0; }
+    if (postings) { *postings = c ? c->postings : NULL; }
+    if (postings_size) { *postings_size = c ? c->postings_size : 0; }
+    return 0;
+}
+
+/**
+ * 根据词元编号获取倒排列表的第一个块
+ * 其余的块按文档编号的顺序通过db_next_postings获取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。不存在时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+memorydb_get_postings(const wiser_env *env, int token_id,
+                      int *first_document_id, int *last_document_id,
+                      int *docs_count, void **postings, int *postings_size)
+{
+    memory_db *m = env->db;
+
+    m->postings_token = memorydb_find_token(env, token_id);
+    m->next_chunk = 0;
+    return memorydb_next_postings(env, first_document_id, last_document_id,
+                                  docs_count, postings, postings_size);
+}
+
+/**
+ * 打开倒排列表中包含指定文档编号或位于其后的第一个块
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] prev_first_document_id 上一个块中最初的文档编号。只获取在其之后的块
+ * @param[in] document_id 文档编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 块中的文档数
+ * @param[in,out] chunk 块的句柄。不存在块时不改变
+ * @param[out] postings_size 块的字节数。不存在块时为0
+ * @retval 0 成功
+ */
+static int
+memorydb_open_postings_chunk(const wiser_env *env, int token_id,
+                             int prev_first_document_id, int document_id,
+                             int *first_document_id, int *last_document_id,
+                             int *docs_count, void **chunk,
+                             int *postings_size)
+{
+    memory_token *t;
+    unsigned int i, n;
+    int min_first_document_id = prev_first_document_id + 1;
+
+    *first_document_id = *last_document_id = *docs_count = 0;
+    *postings_size = 0;
+    if (!(t = memorydb_find_token(env, token_id))) { return 0; }
+    n = utarray_len(t->chunks);
+    /* 包含document_id的块不会早于最初的文档编号不大于document_id的最后一个块 */
+    if ((i = memorydb_lower_bound(t, document_id + 1)) > 0 &&
+        memorydb_chunk_at(t, i - 1)->first_document_id > min_first_document_id)
+    {
+        min_first_document_id = memorydb_chunk_at(t, i - 1)->first_document_id;
+    }
+    for (i = memorydb_lower_bound(t, min_first_document_id); i < n; i++)
+    {
+        memory_chunk *c = memorydb_chunk_at(t, i);
+        if (c->last_document_id >= document_id)
+        {
+            *first_document_id = c->first_document_id;
+            *last_document_id = c->last_document_id;
+            *docs_count = c->docs_count;
+            *postings_size = c->postings_size;
+            *chunk = c;
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 从打开的块中读取数据
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] chunk 块的句柄
+ * @param[out] buf 读取出的数据
+ * @param[in] size 读取的字节数
+ * @param[in] offset 读取的起始位置
+ * @retval 0 成功
+ * @retval -1 读取的范围超出了块
+ */
+static int
+memorydb_read_postings_chunk(const wiser_env *env, void *chunk,
+                             void *buf, int size, int offset)
+{
+    const memory_chunk *c = chunk;
+
+    (void) env;
+    if (offset < 0 || size < 0 || offset + size > c->postings_size)
+    {
+        return -1;
+    }
+    memcpy(buf, c->postings + offset, size);
+    return 0;
+}
+
+/**
+ * 关闭块的句柄。块的句柄直接指向内存中的块，不需要释放
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] chunk 块的句柄
+ */
+static void
+memorydb_close_postings_chunk(const wiser_env *env, void *chunk)
+{
+    (void) env;
+    (void) chunk;
+}
+
+/**
+ * 存储1个段中的倒排列表的1个块
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] first_document_id 块中最初的文档编号
+ * @param[in] last_document_id 块中最后的文档编号
+ * @param[in] segment 段的编号
+ * @param[in] docs_count 块中的文档数
+ * @param[in] postings 待存储的块
+ * @param[in] postings_size 块的字节数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+memorydb_insert_postings(const wiser_env *env, int token_id,
+                         int first_document_id, int last_document_id,
+                         int segment, int docs_count,
+                         const void *postings, int postings_size)
+{
+    memory_token *t;
+    memory_chunk *c;
+    unsigned int i, n;
+
+    if (!(t = memorydb_find_token(env, token_id)))
+    {
+        print_error("token not found: %d", token_id);
+        return -1;
+    }
+    if (!(c = malloc(sizeof(memory_chunk))) ||
+        !(c->postings = memorydb_copy(postings, postings_size)))
+    {
+        print_error("cannot allocate memory for postings.");
+        free(c);
+        return -1;
+    }
+    c->token_id = token_id;
+    c->first_document_id = first_document_id;
+    c->last_document_id = last_document_id;
+    c->segment = segment;
+    c->docs_count = docs_count;
+    c->postings_size = postings_size;
+    /* 按文档编号和段的编号的顺序插入 */
+    n = utarray_len(t->chunks);
+    for (i = memorydb_lower_bound(t, first_document_id);
+         i < n && memorydb_chunk_at(t, i)->first_document_id == first_document_id
+         && memorydb_chunk_at(t, i)->segment < segment; i++) {}
+    utarray_insert(t->chunks, &c, i);
+    return 0;
+}
+
+/**
+ * 获取编号在指定范围内的段中的下一个倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。已没有下一个倒排列表时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+memorydb_next_segment_postings(const wiser_env *env, int *token_id,
+                               int *first_document_id,
+                               int *last_document_id, int *docs_count,
+                               void **postings, int *postings_size)
+{
+    memory_db *m = env->db;
+    memory_chunk *c = NULL;
+
+    if (m->next_segment_chunk < utarray_len(m->segment_chunks))
+    {
+        c = *(memory_chunk **) utarray_eltptr(m->segment_chunks,
+                                              m->next_segment_chunk);
+        m->next_segment_chunk++;
+    }
+    if (token_id) { *token_id = c ? c->token_id : 0; }
+    if (first_document_id)
+    {
+        *first_document_id = c ? c->first_document_id : 0;
+    }
+    if (last_document_id) { *last_document_id = c ? c->last_document_id : 0; }
+    if (docs_count) { *docs_count = c ? c->docs_count : 0; }
+    if (postings) { *postings = c ? c->postings : NULL; }
+    if (postings_size) { *postings_size = c ? c->postings_size : 0; }
+    return 0;
+}
+
+/**
+ * 按词元编号和文档编号的顺序获取编号在指定范围内的段中的第一个块
+ * 其余的倒排列表通过db_next_segment_postings获取
+ * 待读取的块在调用时确定，之后新增的块不会被读取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] min_segment 段的编号的最小值
+ * @param[in] max_segment 段的编号的最大值
+ * @param[out] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。不存在时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+memorydb_get_segment_postings(const wiser_env *env,
+                              int min_segment, int max_segment,
+                              int *token_id, int *first_document_id,
+                              int *last_document_id, int *docs_count,
+                              void **postings, int *postings_size)
+{
+    memory_db *m = env->db;
+    memory_token **t;
+
+    utarray_clear(m->segment_chunks);
+    m->next_segment_chunk = 0;
+    for (t = (memory_token **) utarray_front(m->tokens_by_id); t;
+         t = (memory_token **) utarray_next(m->tokens_by_id, t))
+    {
+        memory_chunk **c;
+        for (c = (memory_chunk **) utarray_front((*t)->chunks); c;
+             c = (memory_chunk **) utarray_next((*t)->chunks, c))
+        {
+            if ((*c)->segment >= min_segment && (*c)->segment <= max_segment)
+            {
+                utarray_push_back(m->segment_chunks, c);
+            }
+        }
+    }
+    return memorydb_next_segment_postings(env, token_id, first_document_id,
+                                          last_document_id, docs_count,
+                                          postings, postings_size);
+}
+
+/**
+ * 添加新的段
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] level 段的级别
+ * @return 新的段的编号
+ */
+static int
+memorydb_add_segment(const wiser_env *env, int level)
+{
+    memory_db *m = env->db;
+    memory_segment s, *last;
+
+    last = (memory_segment *) utarray_back(m->segments);
+    s.id = last ? last->id + 1 : 1;
+    s.level = level;
+    utarray_push_back(m->segments, &s);
+    return s.id;
+}
+
+/**
+ * 获取指定级别的段的数量和编号的范围
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] level 段的级别
+ * @param[out] min_segment 段的编号的最小值
+ * @param[out] max_segment 段的编号的最大值
+ * @return 段的数量
+ */
+static int
+memorydb_get_segments(const wiser_env *env, int level,
+                      int *min_segment, int *max_segment)
+{
+    memory_db *m = env->db;
+    memory_segment *s;
+    int count = 0;
+
+    *min_segment = *max_segment = 0;
+    for (s = (memory_segment *) utarray_front(m->segments); s;
+         s = (memory_segment *) utarray_next(m->segments, s))
+    {
+        if (s->level != level) { continue; }
+        if (!count++) { *min_segment = s->id; }
+        *max_segment = s->id;
+    }
+    return count;
+}
+
+/**
+ * 删除编号在指定范围内的段及其中的所有倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] min_segment 段的编号的最小值
+ * @param[in] max_segment 段的编号的最大值
+ * @retval 0 成功
+ */
+static int
+memorydb_delete_segments(const wiser_env *env,
+                         int min_segment, int max_segment)
+{
+    memory_db *m = env->db;
+    memory_token **t;
+    unsigned int i, n;
+
+    /* 其中可能含有即将被释放的块 */
+    utarray_clear(m->segment_chunks);
+    m->next_segment_chunk = 0;
+    for (t = (memory_token **) utarray_front(m->tokens_by_id); t;
+         t = (memory_token **) utarray_next(m->tokens_by_id, t))
+    {
+        for (i = n = 0; i < utarray_len((*t)->chunks); i++)
+        {
+            memory_chunk *c = memorydb_chunk_at(*t, i);
+            if (c->segment >= min_segment && c->segment <= max_segment)
+            {
+                free(c->postings);
+                free(c);
+            }
+            else
+            {
+                *(memory_chunk **) utarray_eltptr((*t)->chunks, n) = c;
+                n++;
+            }
+        }
+        utarray_resize((*t)->chunks, n);
+    }
+    for (i = n = 0; i < utarray_len(m->segments); i++)
+    {
+        memory_segment *s = (memory_segment *) utarray_eltptr(m->segments, i);
+        if (s->id < min_segment || s->id > max_segment)
+        {
+            *(memory_segment *) utarray_eltptr(m->segments, n) = *s;
+            n++;
+        }
+    }
+    utarray_resize(m->segments, n);
+    return 0;
+}
+
+/**
+ * 获取配置信息
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] key 配置项的名称
+ * @param[in] key_size 配置项名称的字节数
+ * @param[out] value 配置项的取值
+ * @param[out] value_size 配置项取值的字节数
+ */
+static int
+memorydb_get_settings(const wiser_env *env, const char *key, int key_size,
+                      const char **value, int *value_size)
+{
+    memory_db *m = env->db;
+    memory_setting *s;
+
+    HASH_FIND(hh, m->settings, key, (unsigned int) key_size, s);
+    if (s)
+    {
+        if (value) { *value = s->value; }
+        if (value_size) { *value_size = s->value_size; }
+    }
+    return 0;
+}
+
+/**
+ * 更新配置信息
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] key 配置项的名称
+ * @param[in] key_size 配置项名称的字节数
+ * @param[in] value 配置项的取值
+ * @param[in] value_size 配置项取值的字节数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+memorydb_replace_settings(const wiser_env *env, const char *key,
+                          int key_size, const char *value, int value_size)
+{
+    memory_db *m = env->db;
+    memory_setting *s;
+    char *value_copy;
+
+    if (!(value_copy = memorydb_copy(value, value_size)))
+    {
+        print_error("cannot allocate memory for settings.");
+        return -1;
+    }
+    HASH_FIND(hh, m->settings, key, (unsigned int) key_size, s);
+    if (!s)
+    {
+        if (!(s = calloc(1, sizeof(memory_setting))) ||
+            !(s->key = memorydb_copy(key, key_size)))
+        {
+            print_error("cannot allocate memory for settings.");
+            free(s);
+            free(value_copy);
+            return -1;
+        }
+        HASH_ADD_KEYPTR(hh, m->settings, s->key, key_size, s);
+    }
+    free(s->value);
+    s->value = value_copy;
+    s->value_size = value_size;
+    return 0;
+}
+
+/**
+ * 开启事务。内存中的数据库不支持事务
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+memorydb_begin(const wiser_env *env)
+{
+    (void) env;
+    return 0;
+}
+
+/**
+ * 提交事务。内存中的数据库不支持事务
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+memorydb_commit(const wiser_env *env)
+{
+    (void) env;
+    return 0;
+}
+
+/**
+ * 回滚事务。内存中的数据库不支持事务，已写入的数据不会被撤销
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+memorydb_rollback(const wiser_env *env)
+{
+    (void) env;
+    return 0;
+}
+
+/**
+ * 回收未使用的空间。内存中的数据库不需要进行任何操作
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+memorydb_vacuum(const wiser_env *env)
+{
+    (void) env;
+    return 0;
+}
+
+/* 将所有数据保存在内存中的存储后端的操作表 */
+const db_backend memory_backend = {
+        "memory",
+        memorydb_init,
+        memorydb_fin,
+        memorydb_get_document_id,
+        memorydb_get_document_title,
+        memorydb_add_document,
+        memorydb_get_document_count,
+        memorydb_renumber_documents,
+        memorydb_get_token_id,
+        memorydb_get_token,
+        memorydb_get_tokens,
+        memorydb_next_token,
+        memorydb_get_max_token_id,
+        memorydb_add_token_docs_count,
+        memorydb_get_postings,
+        memorydb_next_postings,
+        memorydb_open_postings_chunk,
+        memorydb_read_postings_chunk,
+        memorydb_close_postings_chunk,
+        memorydb_insert_postings,
+        memorydb_get_segment_postings,
+        memorydb_next_segment_postings,
+        memorydb_add_segment,
+        memorydb_get_segments,
+        memorydb_delete_segments,
+        memorydb_get_settings,
+        memorydb_replace_settings,
+        memorydb_begin,
+        memorydb_commit,
+        memorydb_rollback,
+        memorydb_vacuum
+};
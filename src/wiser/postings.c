@@ -1,55 +1,255 @@
 #include <stdio.h>
+#include <pthread.h>
 
 #include "util.h"
+#include "postings.h"
+#include "streamvbyte.h"
 #include "database.h"
+#include "indexfile.h"
+
+/* 同一级别的段达到该数量时，将它们合并成1个上一级的段 */
+#define SEGMENT_MERGE_FACTOR 8
+/* 查找已有的段时检查的级别的上限 */
+#define SEGMENT_MAX_LEVEL 32
+
+/* 存储在数据库中的倒排列表的1个块（Chunk）中的文档数的上限 */
+#define POSTINGS_CHUNK_DOCUMENTS 1024
+
+/* 将元素pl添加到首元素为head、尾元素为tail的倒排列表的末尾 */
+#define POSTINGS_APPEND(head, tail, pl) do { \
+  (pl)->next = NULL; \
+  if (tail) { (tail)->next = (pl); } else { (head) = (pl); } \
+  (tail) = (pl); \
+} while (0)
+
+/* 从存储后端流式读取倒排列表时，每次读取的字节数 */
+#define POSTINGS_READ_WINDOW_SIZE 4096
+
+/* 在内存中对比特序列进行解码时，末尾追加的填充字节数
+   解码时每次读取8个字节，且对于不正确的编码，读取位置可能超出末尾数个字节 */
+#define BIT_STREAM_PADDING 16
+
+/* 经过编码的倒排列表的读取器
+   从内存中读取时，窗口就是整个倒排列表；从存储后端流式读取时，每次读取1个窗口 */
+typedef struct
+{
+    const char *curr;      /* 窗口中的当前读取位置 */
+    const char *end;       /* 窗口的结尾 */
+    unsigned char bit;     /* 当前字节中下一个要读取的比特 */
+    const wiser_env *env;  /* 存储着应用程序运行环境的结构体 */
+    void *handle;          /* 流式读取的块的句柄。从内存中读取时为NULL */
+    int offset;            /* 下一个窗口在块中的起始位置 */
+    int size;              /* 块的字节数 */
+    char window[POSTINGS_READ_WINDOW_SIZE]; /* 从块中读取的窗口 */
+} postings_reader;
 
 /**
- * 从字节序列中还原出倒排列表
- * @param[in] postings_e 待还原的倒排列表（字节序列）
- * @param[in] postings_e_size 待还原的倒排列表（字节序列）中的元素数
- * @param[out] postings 还原后的倒排列表
- * @param[out] postings_len 还原后的倒排列表中的元素数
+ * 初始化从内存中读取倒排列表的读取器
+ * @param[out] r 读取器
+ * @param[in] postings_e 经过编码的倒排列表
+ * @param[in] postings_e_size 经过编码的倒排列表的字节数
+ */
+static void
+init_postings_reader(postings_reader *r,
+                     const char *postings_e, int postings_e_size)
+{
+    r->curr = postings_e;
+    r->end = postings_e + postings_e_size;
+    r->bit = 0x80;
+    r->env = NULL;
+    r->handle = NULL;
+    r->offset = r->size = 0;
+}
+
+/**
+ * 初始化从存储后端中的块流式读取倒排列表的读取器
+ * @param[out] r 读取器
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] handle 通过db_open_postings_chunk打开的块的句柄
+ * @param[in] size 块的字节数
+ */
+static void
+init_postings_chunk_reader(postings_reader *r, const wiser_env *env,
+                           void *handle, int size)
+{
+    r->curr = r->end = r->window;
+    r->bit = 0x80;
+    r->env = env;
+    r->handle = handle;
+    r->offset = 0;
+    r->size = size;
+}
+
+/**
+ * 当前窗口已读完时，读取下一个窗口
+ * @param[in,out] r 读取器
+ * @retval 0 还有可读取的数据
+ * @retval -1 已读取到末尾或读取失败
+ */
+static inline int
+fill_postings_reader(postings_reader *r)
+{
+    int n;
+    if (r->curr < r->end) { return 0; }
+    if (!r->handle || r->offset >= r->size) { return -1; }
+    n = r->size - r->offset;
+    if (n > POSTINGS_READ_WINDOW_SIZE) { n = POSTINGS_READ_WINDOW_SIZE; }
+    if (db_read_postings_chunk(r->env, r->handle, r->window, n, r->offset))
+    {
+        print_error("cannot read postings list.");
+        r->offset = r->size;
+        return -1;
+    }
+    r->curr = r->window;
+    r->end = r->window + n;
+    r->offset += n;
+    return 0;
+}
+
+/**
+ * 判断读取器是否已读取到末尾
+ * @param[in,out] r 读取器
+ * @return 是否已读取到末尾
+ */
+static int
+postings_reader_eof(postings_reader *r)
+{
+    return fill_postings_reader(r) ? 1 : 0;
+}
+
+/**
+ * 跳过当前字节中剩余的比特，使读取位置与字节的边界对齐
+ * @param[in,out] r 读取器
+ */
+static inline void
+align_postings_reader(postings_reader *r)
+{
+    if (r->bit != 0x80)
+    {
+        r->curr++;
+        r->bit = 0x80;
+    }
+}
+
+/**
+ * 从读取器中读取1个int类型的值
+ * @param[in,out] r 读取器。读取位置必须与字节的边界对齐
+ * @param[out] value 读取出的值
  * @retval 0 成功
- *
+ * @retval -1 数据不足
  */
 static int
-decode_postings_none(const char *postings_e, int postings_e_size,
-                     postings_list **postings, int *postings_len)
+read_postings_int(postings_reader *r, int *value)
 {
-    const int *p, *pend;
+    if (r->end - r->curr >= (int) sizeof(int))
+    {
+        memcpy(value, r->curr, sizeof(int));
+        r->curr += sizeof(int);
+    }
+    else
+    {
+        /* 跨越了窗口的边界 */
+        int i;
+        char bytes[sizeof(int)];
+        for (i = 0; i < (int) sizeof(int); i++)
+        {
+            if (fill_postings_reader(r)) { return -1; }
+            bytes[i] = *(r->curr++);
+        }
+        memcpy(value, bytes, sizeof(int));
+    }
+    return 0;
+}
 
-    *postings = NULL;
-    *postings_len = 0;
-    for (p = (const int *) postings_e,
-                 pend = (const int *) (postings_e + postings_e_size); p < pend;)
+/**
+ * 从读取器中读取指定字节数的数据
+ * @param[in,out] r 读取器。读取位置必须与字节的边界对齐
+ * @param[out] buf 读取出的数据
+ * @param[in] size 要读取的字节数
+ * @retval 0 成功
+ * @retval -1 数据不足
+ */
+static int
+read_postings_bytes(postings_reader *r, void *buf, int size)
+{
+    char *p = (char *) buf;
+    while (size > 0)
+    {
+        int n;
+        if (fill_postings_reader(r)) { return -1; }
+        n = (int) (r->end - r->curr);
+        if (n > size) { n = size; }
+        memcpy(p, r->curr, n);
+        r->curr += n;
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/**
+ * 从读取器中读取1个字节
+ * @param[in,out] r 读取器。读取位置必须与字节的边界对齐
+ * @param[out] value 读取出的值
+ * @retval 0 成功
+ * @retval -1 数据不足
+ */
+static int
+read_postings_byte(postings_reader *r, unsigned char *value)
+{
+    if (fill_postings_reader(r)) { return -1; }
+    *value = (unsigned char) *(r->curr++);
+    return 0;
+}
+
+/**
+ * 从字节序列中还原出倒排列表
+ * @param[in,out] r 待还原的倒排列表（字节序列）的读取器
+ * @param[in] store_positions 是否存储了位置信息
+ * @param[in] docs_count 要还原的文档数。为负数时一直还原到末尾
+ * @param[in,out] postings 还原后的倒排列表。还原出的元素被追加到其末尾
+ * @param[in,out] tail 还原后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 还原后的倒排列表中的元素数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_postings_none(postings_reader *r, int store_positions, int docs_count,
+                     postings_list **postings, postings_list **tail,
+                     int *postings_len)
+{
+    for (; docs_count && !postings_reader_eof(r); docs_count--)
     {
         postings_list *pl;
-        int document_id, positions_count;
+        int i, document_id, positions_count;
 
-        document_id = *(p++);
-        positions_count = *(p++);
-        if ((pl = malloc(sizeof(postings_list))))
+        if (read_postings_int(r, &document_id) ||
+            read_postings_int(r, &positions_count))
         {
-            int i;
-            pl->document_id = document_id;
-            pl->positions_count = positions_count;
-            utarray_new(pl->positions, &ut_int_icd);
-            LL_APPEND(*postings, pl);
-            (*postings_len)++;
-
-            /* decode positions */
-            for (i = 0; i < positions_count; i++)
-            {
-                utarray_push_back(pl->positions, p);
-                p++;
-            }
+            return -1;
         }
-        else
+        if (!(pl = malloc(sizeof(postings_list))))
+        {
+            print_error("memory allocation failed.");
+            return -1;
+        }
+        pl->document_id = document_id;
+        pl->positions_count = positions_count;
+        utarray_new(pl->positions, &ut_int_icd);
+        POSTINGS_APPEND(*postings, *tail, pl);
+        (*postings_len)++;
+        if (!store_positions) { continue; }
+
+        /* decode positions */
+        utarray_reserve(pl->positions, positions_count);
+        for (i = 0; i < positions_count; i++)
         {
-            p += positions_count;
+            int position;
+            if (read_postings_int(r, &position)) { return -1; }
+            utarray_push_back(pl->positions, &position);
         }
     }
-    return 0;
+    return docs_count > 0 ? -1 : 0;
 }
 
 /**
@@ -79,25 +279,23 @@ encode_postings_none(const postings_list *postings,
 }
 
 /**
- * 从数据中的指定位置读取1个比特
- * @param[in,out] buf 数据的开头
- * @param[in] buf_end 数据的结尾
- * @param[in,out] bit 从变量buf的哪个位置读取1个比特
- * @return 读取出的比特值
+ * 从读取器的当前位置读取1个比特
+ * @param[in,out] r 读取器
+ * @return 读取出的比特值。已读取到末尾时为-1
  */
 static inline int
-read_bit(const char **buf, const char *buf_end, unsigned char *bit)
+read_bit(postings_reader *r)
 {
-    int r;
-    if (*buf >= buf_end) { return -1; }
-    r = (**buf & *bit) ? 1 : 0;
-    *bit >>= 1;
-    if (!*bit)
+    int v;
+    if (fill_postings_reader(r)) { return -1; }
+    v = (*r->curr & r->bit) ? 1 : 0;
+    r->bit >>= 1;
+    if (!r->bit)
     {
-        *bit = 0x80;
-        (*buf)++;
+        r->bit = 0x80;
+        r->curr++;
     }
-    return r;
+    return v;
 }
 
 /**
@@ -120,19 +318,16 @@ calc_golomb_params(int m, int *b, int *t)
  * @param[in] m Golomb编码中的参数m
  * @param[in] b Golomb编码中的参数b。ceil(log2(m))
  * @param[in] t pow2(b) - m
- * @param[in,out] buf 待解码的数据
- * @param[in] buf_end 待解码数据的结尾
- * @param[in,out] bit 待解码数据的起始比特
+ * @param[in,out] reader 待解码数据的读取器
  * @return 解码后的数值
  */
 static inline int
-golomb_decoding(int m, int b, int t,
-                const char **buf, const char *buf_end, unsigned char *bit)
+golomb_decoding(int m, int b, int t, postings_reader *reader)
 {
     int n = 0;
 
     /* decode (n / m) with unary code */
-    while (read_bit(buf, buf_end, bit) == 1)
+    while (read_bit(reader) == 1)
     {
         n += m;
     }
@@ -142,7 +337,7 @@ golomb_decoding(int m, int b, int t,
         int i, r = 0;
         for (i = 0; i < b - 1; i++)
         {
-            int z = read_bit(buf, buf_end, bit);
+            int z = read_bit(reader);
             if (z == -1)
             {
                 print_error("invalid golomb code");
@@ -152,7 +347,7 @@ golomb_decoding(int m, int b, int t,
         }
         if (r >= t)
         {
-            int z = read_bit(buf, buf_end, bit);
+            int z = read_bit(reader);
             if (z == -1)
             {
                 print_error("invalid golomb code");
@@ -206,116 +401,106 @@ golomb_encoding(int m, int b, int t, int n, buffer *buf)
 }
 
 /**
- * 对经过Golomb编码的倒排列表进行解码
- * @param[in] postings_e 经过Golomb编码的倒排列表
- * @param[in] postings_e_size 经过Golomb编码的倒排列表中的元素数
- * @param[out] postings 解码后的倒排列表
- * @param[out] postings_len 解码后的倒排列表中的元素数
+ * 对块中经过Golomb编码的位置信息进行解码
+ * 每个文档的位置信息由出现次数、参数m和经过Golomb编码的位置之差组成，并与字节的边界对齐
+ * @param[in,out] r 经过Golomb编码的倒排列表的读取器
+ * @param[in,out] block_head 块中最初的元素。解码出的位置信息被存储到各个元素中
+ * @param[in] docs_count 块中的文档数
  * @retval 0 成功
+ * @retval -1 失败
  */
 static int
-decode_postings_golomb(const char *postings_e, int postings_e_size,
-                       postings_list **postings, int *postings_len)
+decode_positions_golomb(postings_reader *r, postings_list *block_head,
+                        int docs_count)
 {
-    const char *pend;
-    unsigned char bit;
+    int i;
+    postings_list *pl;
 
-    pend = postings_e + postings_e_size;
-    bit = 0x80;
-    *postings = NULL;
-    *postings_len = 0;
+    for (i = 0, pl = block_head; i < docs_count && pl; i++, pl = pl->next)
     {
-        int i, docs_count;
-        postings_list *pl;
-        {
-            int m, b, t, pre_document_id = 0;
+        int j, mp, bp, tp, position = -1;
 
-            docs_count = *((int *) postings_e);
-            postings_e += sizeof(int);
-            m = *((int *) postings_e);
-            postings_e += sizeof(int);
-            calc_golomb_params(m, &b, &t);
-            for (i = 0; i < docs_count; i++)
-            {
-                int gap = golomb_decoding(m, b, t, &postings_e, pend, &bit);
-                if ((pl = malloc(sizeof(postings_list))))
-                {
-                    pl->document_id = pre_document_id + gap + 1;
-                    utarray_new(pl->positions, &ut_int_icd);
-                    LL_APPEND(*postings, pl);
-                    (*postings_len)++;
-                    pre_document_id = pl->document_id;
-                }
-                else
-                {
-                    print_error("memory allocation failed.");
-                }
-            }
-        }
-        if (bit != 0x80)
+        if (read_postings_int(r, &pl->positions_count) ||
+            read_postings_int(r, &mp))
         {
-            postings_e++;
-            bit = 0x80;
+            return -1;
         }
-        for (i = 0, pl = *postings; i < docs_count; i++, pl = pl->next)
+        calc_golomb_params(mp, &bp, &tp);
+        utarray_reserve(pl->positions, pl->positions_count);
+        for (j = 0; j < pl->positions_count; j++)
         {
-            int j, mp, bp, tp, position = -1;
-
-            pl->positions_count = *((int *) postings_e);
-            postings_e += sizeof(int);
-            mp = *((int *) postings_e);
-            postings_e += sizeof(int);
-            calc_golomb_params(mp, &bp, &tp);
-            for (j = 0; j < pl->positions_count; j++)
-            {
-                int gap = golomb_decoding(mp, bp, tp, &postings_e, pend, &bit);
-                position += gap + 1;
-                utarray_push_back(pl->positions, &position);
-            }
-            if (bit != 0x80)
-            {
-                postings_e++;
-                bit = 0x80;
-            }
+            int gap = golomb_decoding(mp, bp, tp, r);
+            position += gap + 1;
+            utarray_push_back(pl->positions, &position);
         }
+        align_postings_reader(r);
     }
     return 0;
 }
 
 /**
- * 对倒排列表进行Golomb编码
- * @param[in] documents_count 文档总数
- * @param[in] postings 待编码的倒排列表
- * @param[in] postings_len 待编码的倒排列表中的元素数
- * @param[in] postings_e 编码后的倒排列表
+ * 对块中经过Golomb编码的文档编号进行解码
+ * 块中的文档编号之差都以基准文档编号为起点
+ * @param[in,out] r 经过Golomb编码的倒排列表的读取器
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 解码后的倒排列表。解码出的元素被追加到其末尾
+ * @param[in,out] tail 解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 解码后的倒排列表中的元素数
+ * @param[out] block_head 块中最初的元素
+ * @param[out] docs_count 块中的文档数
  * @retval 0 成功
+ * @retval -1 失败
  */
 static int
-encode_postings_golomb(int documents_count,
-                       const postings_list *postings, const int postings_len,
-                       buffer *postings_e)
+decode_document_ids_golomb(postings_reader *r, int base_document_id,
+                           postings_list **postings, postings_list **tail,
+                           int *postings_len,
+                           postings_list **block_head, int *docs_count)
 {
-    const postings_list *p;
+    int i, m, b, t, pre_document_id = base_document_id;
 
-    append_buffer(postings_e, &postings_len, sizeof(int));
-    if (postings && postings_len)
+    *block_head = NULL;
+    if (read_postings_int(r, docs_count))
     {
-        int m, b, t;
-        m = documents_count / postings_len;
-        append_buffer(postings_e, &m, sizeof(int));
-        calc_golomb_params(m, &b, &t);
+        return -1;
+    }
+    if (!*docs_count) { return 0; }
+    if (read_postings_int(r, &m))
+    {
+        return -1;
+    }
+    calc_golomb_params(m, &b, &t);
+    for (i = 0; i < *docs_count; i++)
+    {
+        postings_list *pl;
+        int gap = golomb_decoding(m, b, t, r);
+        if (!(pl = malloc(sizeof(postings_list))))
         {
-            int pre_document_id = 0;
-
-            LL_FOREACH(postings, p)
-            {
-                int gap = p->document_id - pre_document_id - 1;
-                golomb_encoding(m, b, t, gap, postings_e);
-                pre_document_id = p->document_id;
-            }
+            print_error("memory allocation failed.");
+            return -1;
         }
-        append_buffer(postings_e, NULL, 0);
+        pl->document_id = pre_document_id + gap + 1;
+        utarray_new(pl->positions, &ut_int_icd);
+        POSTINGS_APPEND(*postings, *tail, pl);
+        if (!*block_head) { *block_head = pl; }
+        (*postings_len)++;
+        pre_document_id = pl->document_id;
     }
+    align_postings_reader(r);
+    return 0;
+}
+
+/**
+ * 对块中各个文档的位置信息进行Golomb编码
+ * 参数m取位置的最大值除以出现次数，即位置之差的平均值
+ * @param[in] postings 待编码的倒排列表
+ * @param[out] postings_e 编码后的倒排列表
+ */
+static void
+encode_positions_golomb(const postings_list *postings, buffer *postings_e)
+{
+    const postings_list *p;
+
     LL_FOREACH(postings, p)
     {
         append_buffer(postings_e, &p->positions_count, sizeof(int));
@@ -338,215 +523,3375 @@ encode_postings_golomb(int documents_count,
             append_buffer(postings_e, NULL, 0);
         }
     }
-    return 0;
 }
 
 /**
- * 对倒排列表进行还原或解码
- * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in] postings_e 待还原或解码前的倒排列表
- * @param[in] postings_e_size 待还原或解码前的倒排列表中的元素数
- * @param[out] postings 还原或解码后的倒排列表
- * @param[out] postings_len 还原或解码后的倒排列表中的元素数
- * @retval 0 成功
+ * 对块中的文档编号进行Golomb编码
+ * 参数m取该块所覆盖的文档编号的范围除以文档数，即文档编号之差的平均值
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ */
+static void
+encode_document_ids_golomb(int base_document_id,
+                           const postings_list *postings,
+                           const int postings_len, buffer *postings_e)
+{
+    const postings_list *p;
+
+    append_buffer(postings_e, &postings_len, sizeof(int));
+    if (postings && postings_len)
+    {
+        int m, b, t;
+        for (p = postings; p->next; p = p->next) {}
+        m = (p->document_id - base_document_id) / postings_len;
+        if (m < 1) { m = 1; }
+        append_buffer(postings_e, &m, sizeof(int));
+        calc_golomb_params(m, &b, &t);
+        {
+            int pre_document_id = base_document_id;
+
+            LL_FOREACH(postings, p)
+            {
+                int gap = p->document_id - pre_document_id - 1;
+                golomb_encoding(m, b, t, gap, postings_e);
+                pre_document_id = p->document_id;
+            }
+        }
+        append_buffer(postings_e, NULL, 0);
+    }
+}
+
+/**
+ * 根据数值的平均值，计算出Rice编码中的参数k
+ * 相当于将Golomb编码中的参数m向下取整为2的幂，余数因此总是k个比特的定长字段
+ * @param[in] m 数值的平均值
+ * @return Rice编码中的参数k。floor(log2(m))，m小于2时为0
  */
 static int
-decode_postings(const wiser_env *env,
-                const char *postings_e, int postings_e_size,
-                postings_list **postings, int *postings_len)
+calc_rice_param(int m)
+{
+    int k = 0;
+    while (m >> (k + 1)) { k++; }
+    return k;
+}
+
+/**
+ * 用Rice编码对1个数值进行编码
+ * @param[in] k Rice编码中的参数k
+ * @param[in] n 待编码的数值
+ * @param[in] buf 编码后的数据
+ */
+static inline void
+rice_encoding(int k, int n, buffer *buf)
+{
+    int i;
+    /* encode (n >> k) with unary code */
+    for (i = n >> k; i; i--) { append_buffer_bit(buf, 1); }
+    append_buffer_bit(buf, 0);
+    /* encode (n & (2^k - 1)) */
+    for (i = k - 1; i >= 0; i--) { append_buffer_bit(buf, (n >> i) & 1); }
+}
+
+/**
+ * 从比特序列的指定位置开始，读取64个比特
+ * 读取出的值中，从最高位开始至少有57个比特是有效的
+ * @param[in] in 比特序列。末尾必须有BIT_STREAM_PADDING个字节的0
+ * @param[in] pos 读取位置（比特）
+ * @return 读取出的比特。最高位为读取位置上的比特
+ */
+static inline uint64_t
+peek_bits(const unsigned char *in, uint64_t pos)
+{
+    uint64_t w;
+    memcpy(&w, in + (pos >> 3), sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w << (pos & 7);
+}
+
+/**
+ * 从比特序列的指定位置开始，读取64个比特。比特序列中的比特从各个字节的最低位开始排列
+ * 读取出的值中，从最低位开始至少有57个比特是有效的
+ * @param[in] in 比特序列。末尾必须有8个字节的空余
+ * @param[in] pos 读取位置（比特）
+ * @return 读取出的比特。最低位为读取位置上的比特
+ */
+static inline uint64_t
+peek_bits_lsb(const unsigned char *in, uint64_t pos)
 {
-    switch (env->compress)
+    uint64_t w;
+    memcpy(&w, in + (pos >> 3), sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w >> (pos & 7);
+}
+
+/**
+ * 用Rice编码对1个数值进行解码
+ * 商的一元编码用前导零的个数求出，余数用移位求出，通常情况下没有分支
+ * @param[in] k Rice编码中的参数k。0以上31以下
+ * @param[in] in 经过Rice编码的比特序列。末尾必须有BIT_STREAM_PADDING个字节的0
+ * @param[in,out] pos 读取位置（比特）
+ * @return 解码后的数值
+ */
+static inline uint32_t
+rice_decoding(int k, const unsigned char *in, uint64_t *pos)
+{
+    uint64_t w = peek_bits(in, *pos);
+    uint32_t q = 0, u;
+
+    /* 一元编码长达56个比特以上时，每次跳过56个比特 */
+    while ((w | 0xff) == ~(uint64_t) 0)
     {
-        case compress_none:
-            return decode_postings_none(postings_e, postings_e_size,
-                                        postings, postings_len);
-        case compress_golomb:
-            return decode_postings_golomb(postings_e, postings_e_size,
-                                          postings, postings_len);
-        default:
-            abort();
+        q += 56;
+        *pos += 56;
+        w = peek_bits(in, *pos);
     }
+    u = (uint32_t) __builtin_clzll(~w);
+    q += u;
+    *pos += u + 1;
+    w = peek_bits(in, *pos);
+    *pos += k;
+    return (q << k) | (uint32_t) ((w >> 1) >> (63 - k));
 }
 
 /**
- * 对倒排列表进行转换或编码
- * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in] postings 待转换或编码前的倒排列表
- * @param[in] postings_len 待转换或编码前的倒排列表中的元素数
- * @param[out] postings_e 转换或编码后的倒排列表
+ * 从经过Rice编码的比特序列中连续解码出指定个数的数值
+ * @param[in] in 经过Rice编码的比特序列。末尾必须有BIT_STREAM_PADDING个字节的0
+ * @param[in] size 比特序列的字节数（不含填充）
+ * @param[in,out] pos 读取位置（比特）
+ * @param[in] k Rice编码中的参数k
+ * @param[in] n 要解码的数值的个数
+ * @param[out] out 解码后的数值
  * @retval 0 成功
+ * @retval -1 超出了比特序列的末尾
  */
 static int
-encode_postings(const wiser_env *env,
-                const postings_list *postings, const int postings_len,
-                buffer *postings_e)
+decode_rice_values(const unsigned char *in, int size, uint64_t *pos,
+                   int k, int n, uint32_t *out)
 {
-    switch (env->compress)
+    int i;
+    uint64_t limit = (uint64_t) size * 8;
+
+    for (i = 0; i < n && *pos <= limit; i++)
     {
-        case compress_none:
-            return encode_postings_none(postings, postings_len, postings_e);
-        case compress_golomb:
-            return encode_postings_golomb(db_get_document_count(env),
-                                          postings, postings_len, postings_e);
-        default:
-            abort();
+        out[i] = rice_decoding(k, in, pos);
+    }
+    if (*pos > limit)
+    {
+        print_error("invalid rice code");
+        return -1;
     }
+    return 0;
 }
 
 /**
- * 从数据库中获取关联到指定词元上的倒排列表
- * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in] token_id 词元编号
- * @param[out] postings 获取到的倒排列表
- * @param[out] postings_len 获取到的倒排列表中的元素数
+ * 计算对1个文档的位置信息进行Rice编码时的参数k
+ * 与Golomb编码相同，取位置的最大值除以出现次数，即位置之差的平均值
+ * @param[in] p 倒排列表中的元素
+ * @return Rice编码中的参数k
+ */
+static int
+calc_positions_rice_param(const postings_list *p)
+{
+    if (!p->positions || !p->positions_count) { return 0; }
+    return calc_rice_param((*(const int *) utarray_back(p->positions) + 1) /
+                           p->positions_count);
+}
+
+/**
+ * 对块中经过Rice编码的位置信息进行解码
+ * 开头是各个文档的出现次数和参数k，其后是比特序列的字节数和所有文档的位置之差连在一起的比特序列
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in,out] block_head 块中最初的元素。解码出的位置信息被存储到各个元素中
+ * @param[in] docs_count 块中的文档数
  * @retval 0 成功
  * @retval -1 失败
  */
-int
-fetch_postings(const wiser_env *env, const int token_id,
-               postings_list **postings, int *postings_len)
+static int
+decode_positions_rice(postings_reader *r, postings_list *block_head,
+                      int docs_count)
 {
-    char *postings_e;
-    int postings_e_size, docs_count, rc;
+    int i, size, max_count = 1, rc = -1, *ks = NULL;
+    uint64_t pos = 0;
+    unsigned char *in = NULL;
+    uint32_t *gaps = NULL;
+    postings_list *pl;
 
-    rc = db_get_postings(env, token_id, &docs_count, (void **) &postings_e,
-                         &postings_e_size);
-    if (!rc && postings_e_size)
+    if (!docs_count) { return 0; }
+    if (!(ks = malloc(sizeof(int) * docs_count)))
     {
-        /* 只有当倒排列表非空时，才进行解码 */
-        int decoded_len;
-        if (decode_postings(env, postings_e, postings_e_size, postings,
-                            &decoded_len))
+        print_error("memory allocation failed.");
+        return -1;
+    }
+    for (i = 0, pl = block_head; i < docs_count && pl; i++, pl = pl->next)
+    {
+        if (read_postings_int(r, &pl->positions_count) ||
+            read_postings_int(r, &ks[i]) ||
+            pl->positions_count < 0 || ks[i] < 0 || ks[i] > 31)
         {
-            print_error("postings list decode error");
-            rc = -1;
+            goto exit;
         }
-        else if (docs_count != decoded_len)
+        if (pl->positions_count > max_count)
         {
-            print_error("postings list decode error: stored:%d decoded:%d.\n",
-                        *postings_len, decoded_len);
-            rc = -1;
+            max_count = pl->positions_count;
         }
-        if (postings_len) { *postings_len = decoded_len; }
     }
-    else
+    if (read_postings_int(r, &size) || size < 0) { goto exit; }
+    if (!(in = calloc(size + BIT_STREAM_PADDING, 1)) ||
+        !(gaps = malloc(sizeof(uint32_t) * max_count)))
     {
-        *postings = NULL;
-        if (postings_len) { *postings_len = 0; }
+        print_error("memory allocation failed.");
+        goto exit;
     }
-    return rc;
-}
+    if (read_postings_bytes(r, in, size)) { goto exit; }
+    for (i = 0, pl = block_head; i < docs_count && pl; i++, pl = pl->next)
+    {
+        int j, position = -1;
+
+        if (decode_rice_values(in, size, &pos, ks[i], pl->positions_count,
+                               gaps))
+        {
+            goto exit;
+        }
+        utarray_reserve(pl->positions, pl->positions_count);
+        for (j = 0; j < pl->positions_count; j++)
+        {
+            position += (int) gaps[j] + 1;
+            utarray_push_back(pl->positions, &position);
+        }
+    }
+    rc = 0;
+exit:
+    free(ks);
+    free(in);
+    free(gaps);
+    return rc;
+}
+
+/**
+ * 对块中经过Rice编码的文档编号进行解码
+ * 块中的文档编号之差都以基准文档编号为起点
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 解码后的倒排列表。解码出的元素被追加到其末尾
+ * @param[in,out] tail 解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 解码后的倒排列表中的元素数
+ * @param[out] block_head 块中最初的元素
+ * @param[out] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_document_ids_rice(postings_reader *r, int base_document_id,
+                         postings_list **postings, postings_list **tail,
+                         int *postings_len,
+                         postings_list **block_head, int *docs_count)
+{
+    int i, k, size, pre_document_id = base_document_id, rc = -1;
+    uint64_t pos = 0;
+    unsigned char *in = NULL;
+    uint32_t *gaps = NULL;
+
+    *block_head = NULL;
+    if (read_postings_int(r, docs_count))
+    {
+        return -1;
+    }
+    if (!*docs_count) { return 0; }
+    if (read_postings_int(r, &k) || read_postings_int(r, &size) ||
+        *docs_count < 0 || k < 0 || k > 31 || size < 0)
+    {
+        return -1;
+    }
+    if (!(in = calloc(size + BIT_STREAM_PADDING, 1)) ||
+        !(gaps = malloc(sizeof(uint32_t) * *docs_count)))
+    {
+        print_error("memory allocation failed.");
+        goto exit;
+    }
+    if (read_postings_bytes(r, in, size) ||
+        decode_rice_values(in, size, &pos, k, *docs_count, gaps))
+    {
+        goto exit;
+    }
+    for (i = 0; i < *docs_count; i++)
+    {
+        postings_list *pl;
+        if (!(pl = malloc(sizeof(postings_list))))
+        {
+            print_error("memory allocation failed.");
+            goto exit;
+        }
+        pl->document_id = pre_document_id + (int) gaps[i] + 1;
+        utarray_new(pl->positions, &ut_int_icd);
+        POSTINGS_APPEND(*postings, *tail, pl);
+        if (!*block_head) { *block_head = pl; }
+        (*postings_len)++;
+        pre_document_id = pl->document_id;
+    }
+    rc = 0;
+exit:
+    free(in);
+    free(gaps);
+    return rc;
+}
+
+/**
+ * 对块中各个文档的位置信息进行Rice编码
+ * 先记录各个文档的出现次数和参数k，再记录所有文档的位置之差连在一起的比特序列
+ * @param[in] postings 待编码的倒排列表
+ * @param[out] postings_e 编码后的倒排列表
+ */
+static void
+encode_positions_rice(const postings_list *postings, buffer *postings_e)
+{
+    int size, size_offset;
+    const postings_list *p;
+
+    if (!postings) { return; }
+    LL_FOREACH(postings, p)
+    {
+        int k = calc_positions_rice_param(p);
+        append_buffer(postings_e, &p->positions_count, sizeof(int));
+        append_buffer(postings_e, &k, sizeof(int));
+    }
+    /* 比特序列的字节数在编码后写入 */
+    size_offset = BUFFER_SIZE(postings_e);
+    append_buffer(postings_e, &size_offset, sizeof(int));
+    LL_FOREACH(postings, p)
+    {
+        const int *pp = NULL;
+        int k = calc_positions_rice_param(p), pre_position = -1;
+
+        if (!p->positions) { continue; }
+        while ((pp = (const int *) utarray_next(p->positions, pp)))
+        {
+            rice_encoding(k, *pp - pre_position - 1, postings_e);
+            pre_position = *pp;
+        }
+    }
+    append_buffer(postings_e, NULL, 0);
+    size = BUFFER_SIZE(postings_e) - size_offset - (int) sizeof(int);
+    memcpy(BUFFER_PTR(postings_e) + size_offset, &size, sizeof(int));
+}
+
+/**
+ * 对块中的文档编号进行Rice编码
+ * 参数k由该块所覆盖的文档编号的范围除以文档数，即文档编号之差的平均值求出
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ */
+static void
+encode_document_ids_rice(int base_document_id,
+                         const postings_list *postings,
+                         const int postings_len, buffer *postings_e)
+{
+    const postings_list *p;
+
+    append_buffer(postings_e, &postings_len, sizeof(int));
+    if (postings && postings_len)
+    {
+        int k, size, size_offset, pre_document_id = base_document_id;
+
+        for (p = postings; p->next; p = p->next) {}
+        k = calc_rice_param((p->document_id - base_document_id) /
+                            postings_len);
+        append_buffer(postings_e, &k, sizeof(int));
+        /* 比特序列的字节数在编码后写入 */
+        size_offset = BUFFER_SIZE(postings_e);
+        append_buffer(postings_e, &size_offset, sizeof(int));
+        LL_FOREACH(postings, p)
+        {
+            rice_encoding(k, p->document_id - pre_document_id - 1, postings_e);
+            pre_document_id = p->document_id;
+        }
+        append_buffer(postings_e, NULL, 0);
+        size = BUFFER_SIZE(postings_e) - size_offset - (int) sizeof(int);
+        memcpy(BUFFER_PTR(postings_e) + size_offset, &size, sizeof(int));
+    }
+}
+
+/**
+ * 用截断二进制编码对[0, r)范围内的1个数值进行编码
+ * 与Golomb编码中的余数部分相同，r为1时不输出任何比特
+ * @param[in] r 数值的范围
+ * @param[in] v 待编码的数值
+ * @param[in] buf 编码后的数据
+ */
+static void
+truncated_binary_encoding(int r, int v, buffer *buf)
+{
+    int i, b, t;
+
+    if (r <= 1) { return; }
+    calc_golomb_params(r, &b, &t);
+    if (v < t)
+    {
+        for (i = 1 << (b - 2); i; i >>= 1) { append_buffer_bit(buf, v & i); }
+    }
+    else
+    {
+        v += t;
+        for (i = 1 << (b - 1); i; i >>= 1) { append_buffer_bit(buf, v & i); }
+    }
+}
+
+/**
+ * 用截断二进制编码对[0, r)范围内的1个数值进行解码
+ * @param[in] r 数值的范围
+ * @param[in] in 比特序列。末尾必须有BIT_STREAM_PADDING个字节的0
+ * @param[in,out] pos 读取位置（比特）
+ * @return 解码后的数值
+ */
+static inline int
+truncated_binary_decoding(int r, const unsigned char *in, uint64_t *pos)
+{
+    int b, t, v = 0;
+
+    if (r <= 1) { return 0; }
+    calc_golomb_params(r, &b, &t);
+    if (b > 1)
+    {
+        v = (int) (peek_bits(in, *pos) >> (65 - b));
+        *pos += b - 1;
+    }
+    if (v >= t)
+    {
+        v = ((v << 1) | (int) (peek_bits(in, *pos) >> 63)) - t;
+        *pos += 1;
+    }
+    return v;
+}
+
+/**
+ * 用Elias-gamma编码对1个正整数进行编码
+ * @param[in] n 待编码的数值。1以上
+ * @param[in] buf 编码后的数据
+ */
+static void
+gamma_encoding(int n, buffer *buf)
+{
+    int i, b;
+
+    for (b = 0; n >> (b + 1); b++) { append_buffer_bit(buf, 0); }
+    for (i = b; i >= 0; i--) { append_buffer_bit(buf, (n >> i) & 1); }
+}
+
+/**
+ * 用Elias-gamma编码对1个正整数进行解码
+ * @param[in] in 比特序列。末尾必须有BIT_STREAM_PADDING个字节的0
+ * @param[in,out] pos 读取位置（比特）
+ * @return 解码后的数值。编码不正确时为-1
+ */
+static inline int
+gamma_decoding(const unsigned char *in, uint64_t *pos)
+{
+    int b;
+    uint64_t w = peek_bits(in, *pos);
+
+    if (!w || (b = __builtin_clzll(w)) > 30) { return -1; }
+    w = peek_bits(in, *pos + b) >> (63 - b);
+    *pos += 2 * b + 1;
+    return (int) w;
+}
+
+/**
+ * 用二元插值编码（Binary Interpolative Coding）对升序排列的整数进行编码
+ * 先对中央的值进行编码，其可取的范围由两侧的值的个数限定，再对左右两半递归地进行编码。
+ * 连续的值的范围被限定为1个值，因此不输出任何比特
+ * @param[in] values 待编码的整数。必须严格递增，且都在[low, high]范围内
+ * @param[in] n 待编码的整数的个数
+ * @param[in] low 整数的下限
+ * @param[in] high 整数的上限
+ * @param[in] buf 编码后的数据
+ */
+static void
+encode_interpolative(const int *values, int n, int low, int high,
+                     buffer *buf)
+{
+    int mid;
+
+    if (n <= 0) { return; }
+    mid = n / 2;
+    truncated_binary_encoding(high - low - n + 2, values[mid] - low - mid,
+                              buf);
+    encode_interpolative(values, mid, low, values[mid] - 1, buf);
+    encode_interpolative(values + mid + 1, n - mid - 1, values[mid] + 1, high,
+                         buf);
+}
+
+/**
+ * 对经过二元插值编码的整数进行解码
+ * @param[in] in 比特序列。末尾必须有BIT_STREAM_PADDING个字节的0
+ * @param[in] limit 比特序列的比特数
+ * @param[in,out] pos 读取位置（比特）
+ * @param[out] values 解码后的整数
+ * @param[in] n 要解码的整数的个数
+ * @param[in] low 整数的下限
+ * @param[in] high 整数的上限
+ * @retval 0 成功
+ * @retval -1 编码不正确
+ */
+static int
+decode_interpolative(const unsigned char *in, uint64_t limit, uint64_t *pos,
+                     int *values, int n, int low, int high)
+{
+    int mid;
+
+    if (n <= 0) { return 0; }
+    if (*pos > limit || high - low - n + 2 < 1)
+    {
+        print_error("invalid interpolative code");
+        return -1;
+    }
+    mid = n / 2;
+    values[mid] = low + mid +
+                  truncated_binary_decoding(high - low - n + 2, in, pos);
+    if (decode_interpolative(in, limit, pos, values, mid, low,
+                             values[mid] - 1) ||
+        decode_interpolative(in, limit, pos, values + mid + 1, n - mid - 1,
+                             values[mid] + 1, high))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 对块中经过二元插值编码的位置信息进行解码
+ * 每个文档的出现次数加1和最后的位置加1用Elias-gamma编码记录，
+ * 其余的位置用二元插值编码记录，所有文档的比特序列连在一起
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in,out] block_head 块中最初的元素。解码出的位置信息被存储到各个元素中
+ * @param[in] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_positions_interpolative(postings_reader *r, postings_list *block_head,
+                               int docs_count)
+{
+    int i, size, rc = -1;
+    uint64_t pos = 0, limit;
+    unsigned char *in = NULL;
+    postings_list *pl;
+
+    if (!docs_count) { return 0; }
+    if (read_postings_int(r, &size) || size < 0) { return -1; }
+    if (!(in = calloc(size + BIT_STREAM_PADDING, 1)))
+    {
+        print_error("memory allocation failed.");
+        return -1;
+    }
+    if (read_postings_bytes(r, in, size)) { goto exit; }
+    limit = (uint64_t) size * 8;
+    for (i = 0, pl = block_head; i < docs_count && pl; i++, pl = pl->next)
+    {
+        int count, last;
+        int *positions;
+
+        if (pos > limit || (count = gamma_decoding(in, &pos) - 1) < 0)
+        {
+            goto exit;
+        }
+        pl->positions_count = count;
+        if (!count) { continue; }
+        if ((last = gamma_decoding(in, &pos) - 1) < 0) { goto exit; }
+        utarray_resize(pl->positions, count);
+        positions = (int *) utarray_front(pl->positions);
+        positions[count - 1] = last;
+        if (decode_interpolative(in, limit, &pos, positions, count - 1,
+                                 0, last - 1))
+        {
+            goto exit;
+        }
+    }
+    rc = pos > limit ? -1 : 0;
+exit:
+    free(in);
+    return rc;
+}
+
+/**
+ * 对块中经过二元插值编码的文档编号进行解码
+ * 开头记录着最后的文档编号，其余的文档编号用二元插值编码记录
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 解码后的倒排列表。解码出的元素被追加到其末尾
+ * @param[in,out] tail 解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 解码后的倒排列表中的元素数
+ * @param[out] block_head 块中最初的元素
+ * @param[out] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_document_ids_interpolative(postings_reader *r, int base_document_id,
+                                  postings_list **postings,
+                                  postings_list **tail, int *postings_len,
+                                  postings_list **block_head,
+                                  int *docs_count)
+{
+    int i, last_document_id, size, rc = -1;
+    int *document_ids = NULL;
+    uint64_t pos = 0;
+    unsigned char *in = NULL;
+
+    *block_head = NULL;
+    if (read_postings_int(r, docs_count))
+    {
+        return -1;
+    }
+    if (!*docs_count) { return 0; }
+    if (read_postings_int(r, &last_document_id) ||
+        read_postings_int(r, &size) || *docs_count < 0 || size < 0)
+    {
+        return -1;
+    }
+    if (!(in = calloc(size + BIT_STREAM_PADDING, 1)) ||
+        !(document_ids = malloc(sizeof(int) * *docs_count)))
+    {
+        print_error("memory allocation failed.");
+        goto exit;
+    }
+    document_ids[*docs_count - 1] = last_document_id;
+    if (read_postings_bytes(r, in, size) ||
+        decode_interpolative(in, (uint64_t) size * 8, &pos, document_ids,
+                             *docs_count - 1, base_document_id + 1,
+                             last_document_id - 1))
+    {
+        goto exit;
+    }
+    for (i = 0; i < *docs_count; i++)
+    {
+        postings_list *pl;
+        if (!(pl = malloc(sizeof(postings_list))))
+        {
+            print_error("memory allocation failed.");
+            goto exit;
+        }
+        pl->document_id = document_ids[i];
+        utarray_new(pl->positions, &ut_int_icd);
+        POSTINGS_APPEND(*postings, *tail, pl);
+        if (!*block_head) { *block_head = pl; }
+        (*postings_len)++;
+    }
+    rc = 0;
+exit:
+    free(in);
+    free(document_ids);
+    return rc;
+}
+
+/**
+ * 对块中各个文档的位置信息进行二元插值编码
+ * @param[in] postings 待编码的倒排列表
+ * @param[out] postings_e 编码后的倒排列表
+ */
+static void
+encode_positions_interpolative(const postings_list *postings,
+                               buffer *postings_e)
+{
+    int size, size_offset;
+    const postings_list *p;
+
+    if (!postings) { return; }
+    /* 比特序列的字节数在编码后写入 */
+    size_offset = BUFFER_SIZE(postings_e);
+    append_buffer(postings_e, &size_offset, sizeof(int));
+    LL_FOREACH(postings, p)
+    {
+        int count = p->positions ? (int) utarray_len(p->positions) : 0;
+
+        gamma_encoding(count + 1, postings_e);
+        if (count)
+        {
+            const int *positions = (const int *) utarray_front(p->positions);
+            gamma_encoding(positions[count - 1] + 1, postings_e);
+            encode_interpolative(positions, count - 1,
+                                 0, positions[count - 1] - 1, postings_e);
+        }
+    }
+    append_buffer(postings_e, NULL, 0);
+    size = BUFFER_SIZE(postings_e) - size_offset - (int) sizeof(int);
+    memcpy(BUFFER_PTR(postings_e) + size_offset, &size, sizeof(int));
+}
+
+/**
+ * 对块中的文档编号进行二元插值编码
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_document_ids_interpolative(int base_document_id,
+                                  const postings_list *postings,
+                                  const int postings_len, buffer *postings_e)
+{
+    int i, size, size_offset, *document_ids;
+    const postings_list *p;
+
+    append_buffer(postings_e, &postings_len, sizeof(int));
+    if (!postings || !postings_len) { return 0; }
+    if (!(document_ids = malloc(sizeof(int) * postings_len)))
+    {
+        print_error("cannot allocate memory for interpolative code.");
+        return -1;
+    }
+    i = 0;
+    LL_FOREACH(postings, p) { document_ids[i++] = p->document_id; }
+    append_buffer(postings_e, &document_ids[postings_len - 1], sizeof(int));
+    /* 比特序列的字节数在编码后写入 */
+    size_offset = BUFFER_SIZE(postings_e);
+    append_buffer(postings_e, &size_offset, sizeof(int));
+    encode_interpolative(document_ids, postings_len - 1, base_document_id + 1,
+                         document_ids[postings_len - 1] - 1, postings_e);
+    append_buffer(postings_e, NULL, 0);
+    size = BUFFER_SIZE(postings_e) - size_offset - (int) sizeof(int);
+    memcpy(BUFFER_PTR(postings_e) + size_offset, &size, sizeof(int));
+    free(document_ids);
+    return 0;
+}
+
+/**
+ * 对块中用位图存储的文档编号进行解码
+ * 位图中的第i个比特表示文档编号为基准文档编号+i+1的文档是否出现在块中
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 解码后的倒排列表。解码出的元素被追加到其末尾
+ * @param[in,out] tail 解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 解码后的倒排列表中的元素数
+ * @param[out] block_head 块中最初的元素
+ * @param[out] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_document_ids_bitmap(postings_reader *r, int base_document_id,
+                           postings_list **postings, postings_list **tail,
+                           int *postings_len,
+                           postings_list **block_head, int *docs_count)
+{
+    int i, bitmap_size, n = 0;
+
+    *block_head = NULL;
+    if (read_postings_int(r, docs_count)) { return -1; }
+    if (!*docs_count) { return 0; }
+    if (read_postings_int(r, &bitmap_size)) { return -1; }
+    for (i = 0; i < bitmap_size; i++)
+    {
+        unsigned char bits;
+
+        if (read_postings_byte(r, &bits)) { return -1; }
+        while (bits)
+        {
+            postings_list *pl;
+            int bit = __builtin_ctz(bits);
+
+            bits &= bits - 1;
+            if (!(pl = malloc(sizeof(postings_list))))
+            {
+                print_error("memory allocation failed.");
+                return -1;
+            }
+            pl->document_id = base_document_id + i * 8 + bit + 1;
+            utarray_new(pl->positions, &ut_int_icd);
+            POSTINGS_APPEND(*postings, *tail, pl);
+            if (!*block_head) { *block_head = pl; }
+            n++;
+        }
+    }
+    *postings_len += n;
+    if (n != *docs_count)
+    {
+        print_error("invalid postings bitmap. (stored:%d decoded:%d)",
+                    *docs_count, n);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 用位图存储块中的文档编号
+ * 文档密集地出现时，位图比文档编号之差的序列更小，解码也更快
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_document_ids_bitmap(int base_document_id,
+                           const postings_list *postings,
+                           const int postings_len, buffer *postings_e)
+{
+    const postings_list *p;
+
+    append_buffer(postings_e, &postings_len, sizeof(int));
+    if (postings && postings_len)
+    {
+        int bitmap_size;
+        unsigned char *bitmap;
+
+        for (p = postings; p->next; p = p->next) {}
+        bitmap_size = (p->document_id - base_document_id + 7) / 8;
+        if (!(bitmap = calloc(bitmap_size, 1)))
+        {
+            print_error("cannot allocate memory for a postings bitmap.");
+            return -1;
+        }
+        LL_FOREACH(postings, p)
+        {
+            int i = p->document_id - base_document_id - 1;
+            bitmap[i / 8] |= 1 << (i % 8);
+        }
+        append_buffer(postings_e, &bitmap_size, sizeof(int));
+        append_buffer(postings_e, bitmap, bitmap_size);
+        free(bitmap);
+    }
+    return 0;
+}
+
+/* Elias-Fano编码的高位数组中，每隔多少个0记录1次其后的比特位置 */
+#define EF_SELECT_SAMPLE_INTERVAL 256
+
+/**
+ * 对块中经过Elias-Fano编码的文档编号进行解码
+ * 文档编号减去基准文档编号再减1后，低l比特依次存储在低位数组中，
+ * 高位部分则以一元码的形式存储在高位数组中：第i个值的高位为h时，第h+i个比特为1。
+ * 低位数组之前的采样只用于游标的查找，解码时跳过
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 解码后的倒排列表。解码出的元素被追加到其末尾
+ * @param[in,out] tail 解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 解码后的倒排列表中的元素数
+ * @param[out] block_head 块中最初的元素
+ * @param[out] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_document_ids_elias_fano(postings_reader *r, int base_document_id,
+                               postings_list **postings, postings_list **tail,
+                               int *postings_len,
+                               postings_list **block_head, int *docs_count)
+{
+    int i, l, low_size, high_size, samples_count, n = 0;
+    unsigned char *bits;
+
+    *block_head = NULL;
+    if (read_postings_int(r, docs_count)) { return -1; }
+    if (!*docs_count) { return 0; }
+    if (read_postings_int(r, &l) || read_postings_int(r, &high_size) ||
+        read_postings_int(r, &samples_count))
+    {
+        return -1;
+    }
+    for (i = 0; i < samples_count; i++)
+    {
+        int sample;
+        if (read_postings_int(r, &sample)) { return -1; }
+    }
+    low_size = (int) (((long long) *docs_count * l + 7) / 8);
+    /* 读取低位时每次读取8个字节，因此在末尾留出空余 */
+    if (!(bits = calloc(low_size + high_size + 8, 1)))
+    {
+        print_error("memory allocation failed.");
+        return -1;
+    }
+    if (read_postings_bytes(r, bits, low_size + high_size))
+    {
+        free(bits);
+        return -1;
+    }
+    for (i = 0; i < high_size && n < *docs_count; i++)
+    {
+        unsigned int byte = bits[low_size + i];
+        while (byte && n < *docs_count)
+        {
+            postings_list *pl;
+            int j, high = i * 8 + __builtin_ctz(byte) - n;
+            long long offset = (long long) n * l;
+            uint64_t low = 0;
+
+            byte &= byte - 1;
+            for (j = 0; j < 8; j++)
+            {
+                low |= (uint64_t) bits[offset / 8 + j] << (j * 8);
+            }
+            low = (low >> (offset % 8)) & (((uint64_t) 1 << l) - 1);
+            if (!(pl = malloc(sizeof(postings_list))))
+            {
+                print_error("memory allocation failed.");
+                free(bits);
+                return -1;
+            }
+            pl->document_id = base_document_id + 1 +
+                              (int) (((uint64_t) high << l) | low);
+            utarray_new(pl->positions, &ut_int_icd);
+            POSTINGS_APPEND(*postings, *tail, pl);
+            if (!*block_head) { *block_head = pl; }
+            n++;
+        }
+    }
+    free(bits);
+    *postings_len += n;
+    if (n != *docs_count)
+    {
+        print_error("invalid elias-fano code. (stored:%d decoded:%d)",
+                    *docs_count, n);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 用Elias-Fano编码存储块中的文档编号
+ * 低位的比特数l取floor(log2(U/n))，U为块所覆盖的文档编号的范围，n为文档数。
+ * 每个文档编号约占2+log2(U/n)比特，与文档的分布无关。
+ * 低位数组之前记录高位数组中每EF_SELECT_SAMPLE_INTERVAL个0之后的比特位置，
+ * 游标据此直接跳到高位不小于指定值的元素附近，而不必解码整个块
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_document_ids_elias_fano(int base_document_id,
+                               const postings_list *postings,
+                               const int postings_len, buffer *postings_e)
+{
+    const postings_list *p;
+
+    append_buffer(postings_e, &postings_len, sizeof(int));
+    if (postings && postings_len)
+    {
+        int i, l, low_size, high_size, samples_count, zeros;
+        long long range;
+        unsigned char *bits;
+
+        for (p = postings; p->next; p = p->next) {}
+        range = p->document_id - base_document_id;
+        for (l = 0; ((long long) postings_len << (l + 1)) <= range; l++) {}
+        low_size = (int) (((long long) postings_len * l + 7) / 8);
+        high_size = (int) ((postings_len + ((range - 1) >> l) + 1 + 7) / 8);
+        if (!(bits = calloc(low_size + high_size, 1)))
+        {
+            print_error("cannot allocate memory for elias-fano code.");
+            return -1;
+        }
+        i = 0;
+        LL_FOREACH(postings, p)
+        {
+            int j;
+            long long x = p->document_id - base_document_id - 1,
+                    offset = (long long) i * l,
+                    high = (x >> l) + i;
+            for (j = 0; j < l; j++, offset++)
+            {
+                if (x & (1LL << j))
+                {
+                    bits[offset / 8] |= 1 << (offset % 8);
+                }
+            }
+            bits[low_size + high / 8] |= 1 << (high % 8);
+            i++;
+        }
+        /* 高位数组中0的个数等于最后的文档编号的高位 */
+        samples_count = (int) (((range - 1) >> l) / EF_SELECT_SAMPLE_INTERVAL);
+        append_buffer(postings_e, &l, sizeof(int));
+        append_buffer(postings_e, &high_size, sizeof(int));
+        append_buffer(postings_e, &samples_count, sizeof(int));
+        for (i = 0, zeros = 0; zeros < samples_count * EF_SELECT_SAMPLE_INTERVAL;
+             i++)
+        {
+            if (!(bits[low_size + i / 8] & (1 << (i % 8))) &&
+                !(++zeros % EF_SELECT_SAMPLE_INTERVAL))
+            {
+                int sample = i + 1;
+                append_buffer(postings_e, &sample, sizeof(int));
+            }
+        }
+        append_buffer(postings_e, bits, low_size + high_size);
+        free(bits);
+    }
+    return 0;
+}
+
+/**
+ * 对块中经过Golomb编码、并在之前记录了字节数的位置信息进行解码
+ * 用于Elias-Fano编码的块。游标据此不解码位置信息就能找到下一个块的开头
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in,out] block_head 块中最初的元素。解码出的位置信息被存储到各个元素中
+ * @param[in] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_positions_elias_fano(postings_reader *r, postings_list *block_head,
+                            int docs_count)
+{
+    int size;
+
+    if (!docs_count) { return 0; }
+    if (read_postings_int(r, &size) || size < 0) { return -1; }
+    return decode_positions_golomb(r, block_head, docs_count);
+}
+
+/**
+ * 对块中各个文档的位置信息进行Golomb编码，并在之前记录其字节数
+ * @param[in] postings 待编码的倒排列表
+ * @param[out] postings_e 编码后的倒排列表
+ */
+static void
+encode_positions_elias_fano(const postings_list *postings, buffer *postings_e)
+{
+    int size, size_offset;
+
+    if (!postings) { return; }
+    /* 位置信息的字节数在编码后写入 */
+    size_offset = BUFFER_SIZE(postings_e);
+    append_buffer(postings_e, &size_offset, sizeof(int));
+    encode_positions_golomb(postings, postings_e);
+    append_buffer(postings_e, NULL, 0);
+    size = BUFFER_SIZE(postings_e) - size_offset - (int) sizeof(int);
+    memcpy(BUFFER_PTR(postings_e) + size_offset, &size, sizeof(int));
+}
+
+/**
+ * 对块中经过Stream-VByte编码的位置信息进行解码
+ * 块中所有文档的出现次数和位置之差被排成1个整数的序列，一并进行解码
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in,out] block_head 块中最初的元素。解码出的位置信息被存储到各个元素中
+ * @param[in] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_positions_streamvbyte(postings_reader *r, postings_list *block_head,
+                             int docs_count)
+{
+    int i, n, size, rc = -1;
+    unsigned char *in = NULL;
+    uint32_t *values = NULL, *v, *end;
+    postings_list *pl;
+
+    if (!docs_count) { return 0; }
+    if (read_postings_int(r, &n) || read_postings_int(r, &size) ||
+        n < docs_count || size < 0)
+    {
+        return -1;
+    }
+    if (!(in = calloc(size + STREAMVBYTE_PADDING, 1)) ||
+        !(values = malloc(sizeof(uint32_t) * n)))
+    {
+        print_error("memory allocation failed.");
+        goto exit;
+    }
+    if (read_postings_bytes(r, in, size) ||
+        streamvbyte_decode(in, n, values) != size)
+    {
+        goto exit;
+    }
+    for (i = 0, pl = block_head, v = values, end = values + n;
+         i < docs_count && pl; i++, pl = pl->next)
+    {
+        int j, position = -1;
+
+        if (v >= end) { goto exit; }
+        pl->positions_count = (int) *v++;
+        if (pl->positions_count > end - v) { goto exit; }
+        utarray_reserve(pl->positions, pl->positions_count);
+        for (j = 0; j < pl->positions_count; j++)
+        {
+            position += (int) *v++ + 1;
+            utarray_push_back(pl->positions, &position);
+        }
+    }
+    rc = 0;
+exit:
+    free(in);
+    free(values);
+    return rc;
+}
+
+/**
+ * 对块中各个文档的位置信息进行Stream-VByte编码
+ * 按文档的顺序，将出现次数和位置之差减1的值排成1个整数的序列后进行编码
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_positions_streamvbyte(const postings_list *postings,
+                             const int postings_len, buffer *postings_e)
+{
+    int n = 0, size;
+    uint32_t *values;
+    unsigned char *out;
+    const postings_list *p;
+
+    if (!postings_len) { return 0; }
+    LL_FOREACH(postings, p) { n += 1 + p->positions_count; }
+    if (!(values = malloc(sizeof(uint32_t) * n)))
+    {
+        print_error("cannot allocate memory for stream-vbyte code.");
+        return -1;
+    }
+    if (!(out = malloc(streamvbyte_max_size(n))))
+    {
+        print_error("cannot allocate memory for stream-vbyte code.");
+        free(values);
+        return -1;
+    }
+    n = 0;
+    LL_FOREACH(postings, p)
+    {
+        const int *pp = NULL;
+        int pre_position = -1;
+
+        values[n++] = (uint32_t) p->positions_count;
+        while ((pp = (const int *) utarray_next(p->positions, pp)))
+        {
+            values[n++] = (uint32_t) (*pp - pre_position - 1);
+            pre_position = *pp;
+        }
+    }
+    size = streamvbyte_encode(values, n, out);
+    append_buffer(postings_e, &n, sizeof(int));
+    append_buffer(postings_e, &size, sizeof(int));
+    append_buffer(postings_e, out, size);
+    free(out);
+    free(values);
+    return 0;
+}
+
+/**
+ * 对块中经过Elias-gamma编码的出现次数进行解码。用于不存储位置信息的索引
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in,out] block_head 块中最初的元素。解码出的出现次数被存储到各个元素中
+ * @param[in] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_frequencies(postings_reader *r, postings_list *block_head,
+                   int docs_count)
+{
+    int i, size, rc = -1;
+    uint64_t pos = 0, limit;
+    unsigned char *in = NULL;
+    postings_list *pl;
+
+    if (!docs_count) { return 0; }
+    if (read_postings_int(r, &size) || size < 0) { return -1; }
+    if (!(in = calloc(size + BIT_STREAM_PADDING, 1)))
+    {
+        print_error("memory allocation failed.");
+        return -1;
+    }
+    if (read_postings_bytes(r, in, size)) { goto exit; }
+    limit = (uint64_t) size * 8;
+    for (i = 0, pl = block_head; i < docs_count && pl; i++, pl = pl->next)
+    {
+        if (pos > limit ||
+            (pl->positions_count = gamma_decoding(in, &pos)) < 0)
+        {
+            goto exit;
+        }
+    }
+    rc = pos > limit ? -1 : 0;
+exit:
+    free(in);
+    return rc;
+}
+
+/**
+ * 对块中各个文档的出现次数进行Elias-gamma编码。用于不存储位置信息的索引
+ * 大多数词元在1个文档中只出现1次，此时只需1个比特
+ * @param[in] postings 待编码的倒排列表
+ * @param[out] postings_e 编码后的倒排列表
+ */
+static void
+encode_frequencies(const postings_list *postings, buffer *postings_e)
+{
+    int size, size_offset;
+    const postings_list *p;
+
+    if (!postings) { return; }
+    /* 比特序列的字节数在编码后写入 */
+    size_offset = BUFFER_SIZE(postings_e);
+    append_buffer(postings_e, &size_offset, sizeof(int));
+    LL_FOREACH(postings, p)
+    {
+        gamma_encoding(p->positions_count, postings_e);
+    }
+    append_buffer(postings_e, NULL, 0);
+    size = BUFFER_SIZE(postings_e) - size_offset - (int) sizeof(int);
+    memcpy(BUFFER_PTR(postings_e) + size_offset, &size, sizeof(int));
+}
+
+/* 自适应压缩的块的标记中，表示位置信息使用Stream-VByte编码的比特 */
+#define ADAPTIVE_STREAMVBYTE_POSITIONS 0x80
+
+/* 自适应压缩时依次尝试的文档编号的压缩方法 */
+static const compress_method adaptive_compress_methods[] = {
+        compress_golomb,
+        compress_bitmap,
+        compress_elias_fano
+};
+#define ADAPTIVE_COMPRESS_METHODS_COUNT \
+  ((int) (sizeof(adaptive_compress_methods) / \
+          sizeof(adaptive_compress_methods[0])))
+
+/**
+ * 按照指定的压缩方法，对块中的文档编号进行解码
+ * @param[in] compress 文档编号的压缩方法
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 解码后的倒排列表。解码出的元素被追加到其末尾
+ * @param[in,out] tail 解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 解码后的倒排列表中的元素数
+ * @param[out] block_head 块中最初的元素
+ * @param[out] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_document_ids(compress_method compress, postings_reader *r,
+                    int base_document_id,
+                    postings_list **postings, postings_list **tail,
+                    int *postings_len,
+                    postings_list **block_head, int *docs_count)
+{
+    switch (compress)
+    {
+        case compress_golomb:
+        case compress_streamvbyte:
+            return decode_document_ids_golomb(r, base_document_id,
+                                              postings, tail, postings_len,
+                                              block_head, docs_count);
+        case compress_bitmap:
+            return decode_document_ids_bitmap(r, base_document_id,
+                                              postings, tail, postings_len,
+                                              block_head, docs_count);
+        case compress_elias_fano:
+            return decode_document_ids_elias_fano(r, base_document_id,
+                                                  postings, tail,
+                                                  postings_len,
+                                                  block_head, docs_count);
+        case compress_rice:
+            return decode_document_ids_rice(r, base_document_id,
+                                            postings, tail, postings_len,
+                                            block_head, docs_count);
+        case compress_interpolative:
+            return decode_document_ids_interpolative(r, base_document_id,
+                                                     postings, tail,
+                                                     postings_len,
+                                                     block_head, docs_count);
+        default:
+            print_error("invalid compress method for document ids(%d).",
+                        compress);
+            return -1;
+    }
+}
+
+/**
+ * 按照指定的压缩方法，对块中的文档编号进行编码
+ * @param[in] compress 文档编号的压缩方法
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_document_ids(compress_method compress, int base_document_id,
+                    const postings_list *postings, const int postings_len,
+                    buffer *postings_e)
+{
+    switch (compress)
+    {
+        case compress_golomb:
+        case compress_streamvbyte:
+            encode_document_ids_golomb(base_document_id, postings,
+                                       postings_len, postings_e);
+            return 0;
+        case compress_bitmap:
+            return encode_document_ids_bitmap(base_document_id, postings,
+                                              postings_len, postings_e);
+        case compress_elias_fano:
+            return encode_document_ids_elias_fano(base_document_id, postings,
+                                                  postings_len, postings_e);
+        case compress_rice:
+            encode_document_ids_rice(base_document_id, postings,
+                                     postings_len, postings_e);
+            return 0;
+        case compress_interpolative:
+            return encode_document_ids_interpolative(base_document_id,
+                                                     postings, postings_len,
+                                                     postings_e);
+        default:
+            abort();
+    }
+}
+
+/**
+ * 对块中的位置信息进行解码
+ * @param[in] compress 位置信息的压缩方法。Stream-VByte、Rice和二元插值编码以外使用Golomb编码，
+ *                     Elias-Fano编码时在之前记录其字节数
+ * @param[in,out] r 倒排列表的读取器
+ * @param[in,out] block_head 块中最初的元素。解码出的位置信息被存储到各个元素中
+ * @param[in] docs_count 块中的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_positions(compress_method compress, postings_reader *r,
+                 postings_list *block_head, int docs_count)
+{
+    switch (compress)
+    {
+        case compress_streamvbyte:
+            return decode_positions_streamvbyte(r, block_head, docs_count);
+        case compress_rice:
+            return decode_positions_rice(r, block_head, docs_count);
+        case compress_interpolative:
+            return decode_positions_interpolative(r, block_head, docs_count);
+        case compress_elias_fano:
+            return decode_positions_elias_fano(r, block_head, docs_count);
+        default:
+            return decode_positions_golomb(r, block_head, docs_count);
+    }
+}
+
+/**
+ * 对块中的位置信息进行编码
+ * @param[in] compress 位置信息的压缩方法。Stream-VByte、Rice和二元插值编码以外使用Golomb编码，
+ *                     Elias-Fano编码时在之前记录其字节数
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_positions(compress_method compress, const postings_list *postings,
+                 const int postings_len, buffer *postings_e)
+{
+    switch (compress)
+    {
+        case compress_streamvbyte:
+            return encode_positions_streamvbyte(postings, postings_len,
+                                                postings_e);
+        case compress_rice:
+            encode_positions_rice(postings, postings_e);
+            return 0;
+        case compress_interpolative:
+            encode_positions_interpolative(postings, postings_e);
+            return 0;
+        case compress_elias_fano:
+            encode_positions_elias_fano(postings, postings_e);
+            return 0;
+        default:
+            encode_positions_golomb(postings, postings_e);
+            return 0;
+    }
+}
+
+/**
+ * 对自适应压缩的倒排列表中的1个块进行解码
+ * 块的开头是1个字节的标记，记录着该块的文档编号所使用的压缩方法，
+ * 以及位置信息是否使用Stream-VByte编码（ADAPTIVE_STREAMVBYTE_POSITIONS）
+ * @param[in,out] r 自适应压缩的倒排列表的读取器
+ * @param[in] store_positions 是否存储了位置信息。为0时块中只有出现次数
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 解码后的倒排列表。解码出的元素被追加到其末尾
+ * @param[in,out] tail 解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 解码后的倒排列表中的元素数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_postings_adaptive(postings_reader *r, int store_positions,
+                         int base_document_id,
+                         postings_list **postings, postings_list **tail,
+                         int *postings_len)
+{
+    unsigned char tag;
+    int docs_count;
+    postings_list *block_head;
+
+    if (read_postings_byte(r, &tag)) { return -1; }
+    if (tag == compress_none)
+    {
+        /* 不压缩的块中没有记录文档数，因此在标记之后记录 */
+        if (read_postings_int(r, &docs_count)) { return -1; }
+        return decode_postings_none(r, store_positions, docs_count,
+                                    postings, tail, postings_len);
+    }
+    if (decode_document_ids(
+            (compress_method) (tag & ~ADAPTIVE_STREAMVBYTE_POSITIONS), r,
+            base_document_id, postings, tail, postings_len,
+            &block_head, &docs_count))
+    {
+        return -1;
+    }
+    if (!store_positions)
+    {
+        return decode_frequencies(r, block_head, docs_count);
+    }
+    return decode_positions((tag & ADAPTIVE_STREAMVBYTE_POSITIONS) ?
+                            compress_streamvbyte : compress_golomb,
+                            r, block_head, docs_count);
+}
+
+/**
+ * 对倒排列表进行自适应压缩，生成1个块
+ * 分别为文档编号和位置信息选择字节数最少的压缩方法，并在块的开头记录其标记。
+ * 两者之和不小于不压缩时的字节数时，不进行压缩。
+ * 文档的密度不低于env->bitmap_threshold的块总是用位图存储文档编号，以便检索时按位图查找
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待编码的倒排列表
+ * @param[in] postings_len 待编码的倒排列表中的元素数
+ * @param[out] postings_e 编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_postings_adaptive(const wiser_env *env, int base_document_id,
+                         const postings_list *postings, const int postings_len,
+                         buffer *postings_e)
+{
+    int i, rc = -1, dense = 0, range = 0;
+    unsigned char tag = compress_none;
+    buffer *best = NULL, *candidate = NULL, *positions = NULL, *tmp;
+
+    if (postings)
+    {
+        const postings_list *p;
+        for (p = postings; p->next; p = p->next) {}
+        range = p->document_id - base_document_id;
+        dense = env->bitmap_threshold > 0 &&
+                postings_len >= env->bitmap_threshold * range;
+    }
+    if (!(best = alloc_buffer()) || !(candidate = alloc_buffer()) ||
+        !(positions = alloc_buffer()))
+    {
+        print_error("cannot allocate memory for encoding postings.");
+        goto exit;
+    }
+
+    /* 文档编号 */
+    for (i = 0; i < ADAPTIVE_COMPRESS_METHODS_COUNT; i++)
+    {
+        compress_method compress = adaptive_compress_methods[i];
+
+        if (dense && compress != compress_bitmap) { continue; }
+        /* 位图本身已经比其他压缩方法的结果大时，不再进行编码 */
+        if (!dense && compress == compress_bitmap &&
+            BUFFER_SIZE(best) && range / 8 >= BUFFER_SIZE(best))
+        {
+            continue;
+        }
+        BUFFER_CLEAR(candidate);
+        if (encode_document_ids(compress, base_document_id,
+                                postings, postings_len, candidate))
+        {
+            continue;
+        }
+        append_buffer(candidate, NULL, 0);
+        if (!BUFFER_SIZE(best) || BUFFER_SIZE(candidate) < BUFFER_SIZE(best))
+        {
+            tmp = best;
+            best = candidate;
+            candidate = tmp;
+            tag = (unsigned char) compress;
+        }
+    }
+    if (!BUFFER_SIZE(best)) { goto exit; }
+
+    /* 位置信息 */
+    if (!env->store_positions)
+    {
+        encode_frequencies(postings, positions);
+    }
+    else if (encode_positions(compress_golomb, postings, postings_len,
+                              positions))
+    {
+        goto exit;
+    }
+    BUFFER_CLEAR(candidate);
+    if (env->store_positions &&
+        !encode_positions(compress_streamvbyte, postings, postings_len,
+                          candidate) &&
+        BUFFER_SIZE(candidate) < BUFFER_SIZE(positions))
+    {
+        tmp = positions;
+        positions = candidate;
+        candidate = tmp;
+        tag |= ADAPTIVE_STREAMVBYTE_POSITIONS;
+    }
+
+    /* 不压缩 */
+    BUFFER_CLEAR(candidate);
+    append_buffer(candidate, &postings_len, sizeof(int));
+    encode_postings_none(postings, postings_len, candidate);
+    if (BUFFER_SIZE(candidate) <= BUFFER_SIZE(best) + BUFFER_SIZE(positions))
+    {
+        tag = compress_none;
+        append_buffer(postings_e, &tag, 1);
+        append_buffer(postings_e, BUFFER_PTR(candidate), BUFFER_SIZE(candidate));
+    }
+    else
+    {
+        append_buffer(postings_e, &tag, 1);
+        append_buffer(postings_e, BUFFER_PTR(best), BUFFER_SIZE(best));
+        append_buffer(postings_e, BUFFER_PTR(positions),
+                      BUFFER_SIZE(positions));
+    }
+    rc = 0;
+exit:
+    if (best) { free_buffer(best); }
+    if (candidate) { free_buffer(candidate); }
+    if (positions) { free_buffer(positions); }
+    return rc;
+}
+
+/**
+ * 按照指定的压缩方法，从读取器中对倒排列表中的1个块进行还原或解码
+ * 不压缩时，块一直持续到倒排列表的末尾
+ * @param[in] env 存储着应用程序运行环境的结构体。根据其中的设置判断是否存储了位置信息
+ * @param[in] compress 压缩方法
+ * @param[in,out] r 待还原或解码前的倒排列表的读取器
+ * @param[in] base_document_id 基准文档编号。与编码时相同
+ * @param[in,out] postings 还原或解码后的倒排列表。还原出的元素被追加到其末尾
+ * @param[in,out] tail 还原或解码后的倒排列表中的最后一个元素
+ * @param[in,out] postings_len 还原或解码后的倒排列表中的元素数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_postings_block(const wiser_env *env, compress_method compress,
+                      postings_reader *r, int base_document_id,
+                      postings_list **postings, postings_list **tail,
+                      int *postings_len)
+{
+    int docs_count;
+    postings_list *block_head;
+
+    switch (compress)
+    {
+        case compress_none:
+            return decode_postings_none(r, env->store_positions, -1,
+                                        postings, tail, postings_len);
+        case compress_adaptive:
+            return decode_postings_adaptive(r, env->store_positions,
+                                            base_document_id,
+                                            postings, tail, postings_len);
+        default:
+            if (decode_document_ids(compress, r, base_document_id,
+                                    postings, tail, postings_len,
+                                    &block_head, &docs_count))
+            {
+                return -1;
+            }
+            if (!env->store_positions)
+            {
+                return decode_frequencies(r, block_head, docs_count);
+            }
+            return decode_positions(compress, r, block_head, docs_count);
+    }
+}
+
+/**
+ * 从读取器中对倒排列表进行还原或解码
+ * 存储在数据库中的倒排列表由1个以上的块组成。最初和最后的文档编号记录在数据库的行中，
+ * 第一个块以最初的文档编号减1为基准文档编号，其余的块以前一个块中最后的文档编号为基准
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in,out] r 待还原或解码前的倒排列表的读取器
+ * @param[in] first_document_id 倒排列表中最初的文档编号
+ * @param[out] postings 还原或解码后的倒排列表。失败时为NULL
+ * @param[out] postings_len 还原或解码后的倒排列表中的元素数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+read_postings(const wiser_env *env, postings_reader *r, int first_document_id,
+              postings_list **postings, int *postings_len)
+{
+    int rc = 0;
+    postings_list *tail = NULL;
+
+    *postings = NULL;
+    *postings_len = 0;
+    while (!rc && !postings_reader_eof(r))
+    {
+        rc = decode_postings_block(env, env->compress, r,
+                                   tail ? tail->document_id
+                                        : first_document_id - 1,
+                                   postings, &tail, postings_len);
+    }
+    if (rc)
+    {
+        free_postings_list(*postings);
+        *postings = NULL;
+        *postings_len = 0;
+    }
+    return rc;
+}
+
+/**
+ * 对倒排列表进行还原或解码
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] postings_e 待还原或解码前的倒排列表
+ * @param[in] postings_e_size 待还原或解码前的倒排列表中的元素数
+ * @param[in] first_document_id 倒排列表中最初的文档编号
+ * @param[out] postings 还原或解码后的倒排列表
+ * @param[out] postings_len 还原或解码后的倒排列表中的元素数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+decode_postings(const wiser_env *env,
+                const char *postings_e, int postings_e_size,
+                int first_document_id,
+                postings_list **postings, int *postings_len)
+{
+    postings_reader r;
+    init_postings_reader(&r, postings_e, postings_e_size);
+    return read_postings(env, &r, first_document_id, postings, postings_len);
+}
+
+/**
+ * 按照指定的压缩方法对倒排列表进行转换或编码，生成1个块
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] compress 压缩方法
+ * @param[in] base_document_id 基准文档编号。必须小于该块中最初的文档编号
+ * @param[in] postings 待转换或编码前的倒排列表
+ * @param[in] postings_len 待转换或编码前的倒排列表中的元素数
+ * @param[out] postings_e 转换或编码后的倒排列表
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_postings_block(const wiser_env *env, compress_method compress,
+                      int base_document_id,
+                      const postings_list *postings, const int postings_len,
+                      buffer *postings_e)
+{
+    switch (compress)
+    {
+        case compress_none:
+            return encode_postings_none(postings, postings_len, postings_e);
+        case compress_adaptive:
+            return encode_postings_adaptive(env, base_document_id,
+                                            postings, postings_len, postings_e);
+        default:
+            if (encode_document_ids(compress, base_document_id,
+                                    postings, postings_len, postings_e))
+            {
+                return -1;
+            }
+            if (!env->store_positions)
+            {
+                encode_frequencies(postings, postings_e);
+                return 0;
+            }
+            return encode_positions(compress, postings, postings_len,
+                                    postings_e);
+    }
+}
+
+/**
+ * 对倒排列表进行转换或编码，生成存储在数据库中的由1个块组成的倒排列表
+ * 块以最初的文档编号减1为基准文档编号，因此解码时需要数据库的行中记录的最初的文档编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] postings 待转换或编码前的倒排列表
+ * @param[in] postings_len 待转换或编码前的倒排列表中的元素数
+ * @param[out] postings_e 转换或编码后的倒排列表
+ * @retval 0 成功
+ */
+static int
+encode_postings(const wiser_env *env,
+                const postings_list *postings, const int postings_len,
+                buffer *postings_e)
+{
+    return encode_postings_block(env, env->compress,
+                                 postings ? postings->document_id - 1 : 0,
+                                 postings, postings_len, postings_e);
+}
+
+/**
+ * 将内存上的倒排索引中存储的倒排列表还原成链表
+ * 不存储位置信息的索引项中，只还原出现次数
+ * @param[in] ii 内存上的倒排索引
+ * @param[in] p 倒排索引中的索引项
+ * @param[out] postings 还原后的倒排列表
+ * @param[out] postings_len 还原后的倒排列表中的元素数。调用时可将该参数设为NULL
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+get_buffered_postings(const inverted_index *ii,
+                      const inverted_index_value *p,
+                      postings_list **postings, int *postings_len)
+{
+    int document_id = 0, len = 0;
+    int has_positions = p->positions.upto != p->positions.start;
+    unsigned int gap;
+    byte_slice_reader docs, positions;
+    postings_list *tail = NULL;
+
+    *postings = NULL;
+    init_byte_slice_reader(&docs, ii->pool, &p->documents);
+    init_byte_slice_reader(&positions, ii->pool, &p->positions);
+    while (!read_byte_slice_vbyte(&docs, &gap))
+    {
+        int i, position = 0;
+        unsigned int positions_count;
+        postings_list *pl;
+
+        /* 最后一个文档中的出现次数存储在索引项中 */
+        if (read_byte_slice_vbyte(&docs, &positions_count))
+        {
+            positions_count = p->doc_positions_count;
+        }
+        if (!(pl = malloc(sizeof(postings_list))))
+        {
+            print_error("cannot allocate memory for a postings list.");
+            free_postings_list(*postings);
+            *postings = NULL;
+            return -1;
+        }
+        document_id += gap;
+        pl->document_id = document_id;
+        pl->positions_count = positions_count;
+        utarray_new(pl->positions, &ut_int_icd);
+        if (has_positions)
+        {
+            utarray_reserve(pl->positions, positions_count);
+        }
+        for (i = 0; has_positions && i < (int) positions_count; i++)
+        {
+            unsigned int position_gap;
+            if (read_byte_slice_vbyte(&positions, &position_gap))
+            {
+                print_error("buffered postings list is broken.");
+                break;
+            }
+            position += position_gap;
+            utarray_push_back(pl->positions, &position);
+        }
+        POSTINGS_APPEND(*postings, tail, pl);
+        len++;
+    }
+    if (postings_len) { *postings_len = len; }
+    return 0;
+}
+
+/**
+ * 获取将两个倒排列表合并后得到的倒排列表
+ * @param[in] pa 要合并的倒排列表
+ * @param[in] pb 要合并的倒排列表
+ *
+ * @return 合并后的倒排列表
+ *
+ * @attention pa和pb都必须按文档编号升序排列。fetch_postings通过concat_postings合并各个段的
+ *            倒排列表时调用该函数，若二者中的任意一个被破坏了，
+ *            或者二者中含有相同的文档编号，则该函数的行为不可预知
+ */
+static postings_list *
+merge_postings(postings_list *pa, postings_list *pb)
+{
+    postings_list *ret = NULL, *p;
+    /* 用pa和pb分别遍历已读取的段和新读取的段（参见函数fetch_postings）中的倒排列表中的元素， */
+    /* 将二者连接成按文档编号升序排列的链表 */
+    while (pa || pb)
+    {
+        postings_list *e;
+        if (!pb || (pa && pa->document_id <= pb->document_id))
+        {
+            e = pa;
+            pa = pa->next;
+        }
+        else if (!pa || pa->document_id >= pb->document_id)
+        {
+            e = pb;
+            pb = pb->next;
+        }
+        else
+        {
+            abort();
+        }
+        e->next = NULL;
+        if (!ret)
+        {
+            ret = e;
+        }
+        else
+        {
+            p->next = e;
+        }
+        p = e;
+    }
+    return ret;
+}
+
+/**
+ * 将倒排列表连接或合并到另一个倒排列表的末尾
+ * @param[in,out] postings 被连接的倒排列表
+ * @param[in,out] tail 被连接的倒排列表中的最后一个元素
+ * @param[in] pl 要连接的倒排列表
+ */
+static void
+concat_postings(postings_list **postings, postings_list **tail,
+                postings_list *pl)
+{
+    if (!pl) { return; }
+    if (!*tail)
+    {
+        *postings = *tail = pl;
+    }
+    else if ((*tail)->document_id < pl->document_id)
+    {
+        /* 两个倒排列表中的文档编号不重叠时，直接连接 */
+        (*tail)->next = pl;
+    }
+    else
+    {
+        *postings = merge_postings(*postings, pl);
+    }
+    while ((*tail)->next) { *tail = (*tail)->next; }
+}
+
+/**
+ * 从数据库中获取关联到指定词元上的倒排列表
+ * 依次读取各个段中的倒排列表并将它们合并成1个倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[out] postings 获取到的倒排列表
+ * @param[out] postings_len 获取到的倒排列表中的元素数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+fetch_postings(const wiser_env *env, const int token_id,
+               postings_list **postings, int *postings_len)
+{
+    char *postings_e;
+    int postings_e_size, first_document_id, docs_count, rc, len = 0;
+    postings_list *tail = NULL;
+
+    *postings = NULL;
+    for (rc = db_get_postings(env, token_id, &first_document_id, NULL,
+                              &docs_count, (void **) &postings_e,
+                              &postings_e_size);
+         !rc && postings_e;
+         rc = db_next_postings(env, &first_document_id, NULL, &docs_count,
+                               (void **) &postings_e, &postings_e_size))
+    {
+        int decoded_len;
+        postings_list *pl;
+
+        if (decode_postings(env, postings_e, postings_e_size,
+                            first_document_id, &pl, &decoded_len))
+        {
+            print_error("postings list decode error");
+            rc = -1;
+            break;
+        }
+        if (docs_count != decoded_len)
+        {
+            print_error("postings list decode error: stored:%d decoded:%d.\n",
+                        docs_count, decoded_len);
+            free_postings_list(pl);
+            rc = -1;
+            break;
+        }
+        concat_postings(postings, &tail, pl);
+        len += decoded_len;
+    }
+    if (rc)
+    {
+        free_postings_list(*postings);
+        *postings = NULL;
+        len = 0;
+    }
+    if (postings_len) { *postings_len = len; }
+    return rc;
+}
+
+/**
+ * 释放游标中当前块的位图
+ * @param[in,out] cursor 倒排列表的游标
+ */
+static void
+free_postings_cursor_bitmap(postings_cursor *cursor)
+{
+    free(cursor->bitmap);
+    free(cursor->bitmap_ranks);
+    free(cursor->elements);
+    cursor->bitmap = NULL;
+    cursor->bitmap_ranks = NULL;
+    cursor->elements = NULL;
+    cursor->bitmap_words = 0;
+}
+
+/**
+ * 当前块中文档的密度不低于env->bitmap_threshold时，为其创建位图
+ * 之后在该块中查找文档编号时，不再沿着链表查找，而是在位图中查找
+ * @param[in,out] cursor 倒排列表的游标
+ * @param[in] docs_count 当前块中的文档数
+ */
+static void
+build_postings_cursor_bitmap(postings_cursor *cursor, int docs_count)
+{
+    int i, n, range, words;
+    postings_list *pl;
+
+    if (!cursor->chunk || cursor->env->bitmap_threshold <= 0) { return; }
+    for (pl = cursor->chunk; pl->next; pl = pl->next) {}
+    range = pl->document_id - cursor->chunk->document_id + 1;
+    if (docs_count < cursor->env->bitmap_threshold * range) { return; }
+
+    words = (range + 63) / 64;
+    cursor->bitmap = (uint64_t *) calloc(words, sizeof(uint64_t));
+    cursor->bitmap_ranks = (int *) malloc(sizeof(int) * words);
+    cursor->elements = (postings_list **) malloc(
+            sizeof(postings_list *) * docs_count);
+    if (!cursor->bitmap || !cursor->bitmap_ranks || !cursor->elements)
+    {
+        /* 无法创建位图时，仍然沿着链表查找 */
+        free_postings_cursor_bitmap(cursor);
+        return;
+    }
+    cursor->bitmap_base = cursor->chunk->document_id;
+    for (i = 0, pl = cursor->chunk; pl && i < docs_count; i++, pl = pl->next)
+    {
+        int bit = pl->document_id - cursor->bitmap_base;
+        cursor->bitmap[bit / 64] |= (uint64_t) 1 << (bit % 64);
+        cursor->elements[i] = pl;
+    }
+    for (i = 0, n = 0; i < words; i++)
+    {
+        cursor->bitmap_ranks[i] = n;
+        n += __builtin_popcountll(cursor->bitmap[i]);
+    }
+    cursor->bitmap_words = words;
+}
+
+/**
+ * 在当前块的位图中查找文档编号不小于指定文档编号的第一个元素
+ * @param[in] cursor 倒排列表的游标
+ * @param[in] document_id 文档编号
+ * @return 找到的元素。不存在时为NULL
+ */
+static postings_list *
+probe_postings_cursor_bitmap(const postings_cursor *cursor, int document_id)
+{
+    int bit, w;
+    uint64_t word;
+
+    bit = document_id - cursor->bitmap_base;
+    if (bit < 0) { bit = 0; }
+    if ((w = bit / 64) >= cursor->bitmap_words) { return NULL; }
+    word = cursor->bitmap[w] & (~(uint64_t) 0 << (bit % 64));
+    while (!word)
+    {
+        if (++w >= cursor->bitmap_words) { return NULL; }
+        word = cursor->bitmap[w];
+    }
+    bit = __builtin_ctzll(word);
+    return cursor->elements[cursor->bitmap_ranks[w] +
+                            __builtin_popcountll(cursor->bitmap[w] &
+                                                 (((uint64_t) 1 << bit) - 1))];
+}
+
+/**
+ * 求出Elias-Fano编码的区块中指定元素的文档编号
+ * @param[in] ef 区块中的查找状态
+ * @param[in] index 元素的下标
+ * @param[in] position 元素在高位数组中对应的比特的位置
+ * @return 文档编号
+ */
+static inline int
+elias_fano_value(const elias_fano_cursor *ef, int index, int position)
+{
+    uint64_t low = peek_bits_lsb(ef->low, (uint64_t) index * ef->l) &
+                   (((uint64_t) 1 << ef->l) - 1);
+    return ef->base_document_id + 1 +
+           (int) (((uint64_t) (position - index) << ef->l) | low);
+}
+
+/**
+ * 在高位数组中，查找指定位置及其之后的第一个1
+ * @param[in] ef 区块中的查找状态
+ * @param[in] position 开始查找的位置（比特）
+ * @return 找到的1的位置。调用者需保证其存在
+ */
+static inline int
+elias_fano_next_one(const elias_fano_cursor *ef, int position)
+{
+    uint64_t w;
+    /* 每次读取出的比特中至少有57个是有效的 */
+    while (!(w = peek_bits_lsb(ef->high, position))) { position += 56; }
+    return position + __builtin_ctzll(w);
+}
+
+/**
+ * 在Elias-Fano编码的区块中，将查找状态移动到文档编号不小于指定文档编号的第一个元素上
+ * 文档编号的高位为h的元素位于高位数组中第h个0之后，因此先从采样中找到
+ * 第h个0之前最近的位置，再按64比特的字数出剩余的0，最后在低位上逐个比较
+ * @param[in,out] ef 区块中的查找状态。只会向前移动
+ * @param[in] document_id 文档编号。不能大于区块中最后的文档编号
+ */
+static void
+elias_fano_next_geq(elias_fano_cursor *ef, int document_id)
+{
+    int h, k, index, zeros = 0, position = 0;
+
+    if (document_id <= ef->base_document_id + 1) { return; }
+    h = (int) (((long long) document_id - ef->base_document_id - 1) >> ef->l);
+    if ((k = h / EF_SELECT_SAMPLE_INTERVAL) > ef->samples_count)
+    {
+        k = ef->samples_count;
+    }
+    if (k)
+    {
+        memcpy(&position, ef->samples + (k - 1) * sizeof(int), sizeof(int));
+        zeros = k * EF_SELECT_SAMPLE_INTERVAL;
+    }
+    while (zeros < h)
+    {
+        uint64_t w = ~peek_bits_lsb(ef->high, position) &
+                     (((uint64_t) 1 << 56) - 1);
+        int c = __builtin_popcountll(w);
+        if (zeros + c < h)
+        {
+            zeros += c;
+            position += 56;
+            continue;
+        }
+        for (c = h - zeros; c > 1; c--) { w &= w - 1; }
+        position += __builtin_ctzll(w) + 1;
+        zeros = h;
+    }
+    /* 第h个0之前的1的个数，即为高位不小于h的第一个元素的下标 */
+    if ((index = position - h) > ef->index)
+    {
+        ef->index = index;
+        ef->position = elias_fano_next_one(ef, position);
+    }
+    while (elias_fano_value(ef, ef->index, ef->position) < document_id)
+    {
+        ef->index++;
+        ef->position = elias_fano_next_one(ef, ef->position + 1);
+    }
+}
+
+/**
+ * 打开游标的当前块中从指定位置开始的Elias-Fano编码的区块，但不对其进行解码
+ * 读取区块开头的文档数、低位的比特数和采样数，以及位置信息（或出现次数）的字节数，
+ * 求出区块的结尾和区块中最后的文档编号，并移动到区块中的第一个元素上
+ * @param[in,out] cursor 倒排列表的游标
+ * @param[in] offset 区块在块中的起始位置
+ * @param[in] base_document_id 区块的基准文档编号
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+open_elias_fano_block(postings_cursor *cursor, int offset, int base_document_id)
+{
+    elias_fano_cursor *ef = &cursor->ef;
+    const unsigned char *block;
+    int i, header[4], low_size, high_size, size, ones = 0, last_byte = -1;
+    long long end;
+
+    /* 释放前一个区块解码后的倒排列表 */
+    free_postings_list(cursor->chunk);
+    cursor->chunk = NULL;
+    free_postings_cursor_bitmap(cursor);
+
+    memset(ef, 0, sizeof(elias_fano_cursor));
+    ef->base_document_id = ef->last_document_id = base_document_id;
+    ef->offset = offset;
+    block = (const unsigned char *) cursor->data + offset;
+    if (cursor->data_size - offset < (int) sizeof(int)) { goto invalid; }
+    memcpy(&ef->docs_count, block, sizeof(int));
+    if (!ef->docs_count)
+    {
+        ef->end = offset + (int) sizeof(int);
+        return 0;
+    }
+    if (ef->docs_count < 0 ||
+        cursor->data_size - offset < (int) sizeof(header))
+    {
+        goto invalid;
+    }
+    memcpy(header, block, sizeof(header));
+    ef->l = header[1];
+    high_size = header[2];
+    ef->samples_count = header[3];
+    if (ef->l < 0 || ef->l > 31 || high_size <= 0 || ef->samples_count < 0)
+    {
+        goto invalid;
+    }
+    low_size = (int) (((long long) ef->docs_count * ef->l + 7) / 8);
+    end = offset + (long long) sizeof(header) +
+          (long long) ef->samples_count * sizeof(int) + low_size + high_size;
+    if (end + (long long) sizeof(int) > cursor->data_size) { goto invalid; }
+    ef->samples = block + sizeof(header);
+    ef->low = ef->samples + ef->samples_count * sizeof(int);
+    ef->high = ef->low + low_size;
+    ef->high_bits = high_size * 8;
+    memcpy(&size, cursor->data + end, sizeof(int));
+    end += (long long) sizeof(int) + size;
+    if (size < 0 || end > cursor->data_size) { goto invalid; }
+    ef->end = (int) end;
+
+    /* 查找时不检查边界，因此事先确认1的个数与文档数一致、采样都在高位数组中 */
+    for (i = 0; i < high_size; i++)
+    {
+        if (ef->high[i])
+        {
+            ones += __builtin_popcount(ef->high[i]);
+            last_byte = i;
+        }
+    }
+    if (ones != ef->docs_count) { goto invalid; }
+    for (i = 0; i < ef->samples_count; i++)
+    {
+        int sample;
+        memcpy(&sample, ef->samples + i * sizeof(int), sizeof(int));
+        if (sample <= 0 || sample > ef->high_bits) { goto invalid; }
+    }
+    ef->last_document_id = elias_fano_value(
+            ef, ef->docs_count - 1,
+            last_byte * 8 + 31 - __builtin_clz(ef->high[last_byte]));
+    ef->position = elias_fano_next_one(ef, 0);
+    return 0;
+
+invalid:
+    print_error("invalid elias-fano block: token(%d).", cursor->token_id);
+    return -1;
+}
+
+/**
+ * 将游标的current设置为Elias-Fano编码的区块中的当前元素
+ * 区块尚未解码时，current指向只有文档编号的元素
+ * @param[in,out] cursor 倒排列表的游标
+ */
+static void
+set_elias_fano_current(postings_cursor *cursor)
+{
+    const elias_fano_cursor *ef = &cursor->ef;
+
+    if (cursor->elements)
+    {
+        cursor->current = cursor->elements[ef->index];
+        return;
+    }
+    cursor->element.document_id = elias_fano_value(ef, ef->index,
+                                                   ef->position);
+    cursor->element.positions = NULL;
+    cursor->element.positions_count = 0;
+    cursor->element.next = NULL;
+    cursor->current = &cursor->element;
+}
+
+/**
+ * 在游标的当前块中，跳过所有文档编号都小于指定文档编号的Elias-Fano编码的区块，
+ * 并将游标移动到区块中文档编号不小于指定文档编号的第一个元素上
+ * @param[in,out] cursor 倒排列表的游标
+ * @param[in] document_id 文档编号。不能大于当前块中最后的文档编号
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+seek_elias_fano_block(postings_cursor *cursor, int document_id)
+{
+    while (!cursor->ef.docs_count ||
+           cursor->ef.last_document_id < document_id)
+    {
+        if (cursor->ef.end >= cursor->data_size)
+        {
+            print_error("postings list decode error: token(%d).",
+                        cursor->token_id);
+            return -1;
+        }
+        if (open_elias_fano_block(cursor, cursor->ef.end,
+                                  cursor->ef.last_document_id))
+        {
+            return -1;
+        }
+    }
+    elias_fano_next_geq(&cursor->ef, document_id);
+    set_elias_fano_current(cursor);
+    return 0;
+}
+
+/**
+ * 读取倒排列表中包含指定文档编号或位于其后的第一个块，
+ * 并将游标移动到该块中文档编号不小于指定文档编号的第一个元素上
+ * @param[in,out] cursor 倒排列表的游标
+ * @param[in] document_id 文档编号
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+load_postings_chunk(postings_cursor *cursor, int document_id)
+{
+    int postings_e_size, docs_count, decoded_len;
+    const char *postings_e = NULL;
+    postings_reader r;
+
+    free_postings_list(cursor->chunk);
+    cursor->chunk = cursor->current = NULL;
+    free_postings_cursor_bitmap(cursor);
+    free(cursor->data);
+    cursor->data = NULL;
+    cursor->data_size = 0;
+    if (cursor->env->index_file)
+    {
+        /* 除Elias-Fano以外，直接解码映射到内存中的块，不进行复制 */
+        if (index_file_get_postings_chunk(cursor->env->index_file,
+                                          cursor->token_id,
+                                          cursor->chunk_first_document_id,
+                                          document_id,
+                                          &cursor->chunk_first_document_id,
+                                          &cursor->chunk_last_document_id,
+                                          &docs_count, &postings_e,
+                                          &postings_e_size))
+        {
+            return -1;
+        }
+        if (!postings_e) { return 0; }
+        init_postings_reader(&r, postings_e, postings_e_size);
+    }
+    else if (db_open_postings_chunk(cursor->env, cursor->token_id,
+                                    cursor->chunk_first_document_id,
+                                    document_id,
+                                    &cursor->chunk_first_document_id,
+                                    &cursor->chunk_last_document_id,
+                                    &docs_count, &cursor->handle,
+                                    &postings_e_size))
+    {
+        return -1;
+    }
+    else if (!postings_e_size)
+    {
+        return 0;
+    }
+    else if (cursor->env->compress != compress_elias_fano)
+    {
+        /* 按固定大小的窗口读取并解码，不将整个块读入内存 */
+        init_postings_chunk_reader(&r, cursor->env, cursor->handle,
+                                   postings_e_size);
+    }
+    if (cursor->env->compress == compress_elias_fano)
+    {
+        /* 将整个块读入内存，在各个区块的高位数组中查找文档编号，
+           只在需要位置信息时才解码区块。末尾留出读取比特时的空余 */
+        if (!(cursor->data = (char *) calloc(postings_e_size + 8, 1)))
+        {
+            print_error("cannot allocate memory for a postings chunk.");
+            return -1;
+        }
+        cursor->data_size = postings_e_size;
+        if (postings_e)
+        {
+            memcpy(cursor->data, postings_e, postings_e_size);
+        }
+        else if (db_read_postings_chunk(cursor->env, cursor->handle,
+                                        cursor->data, postings_e_size, 0))
+        {
+            print_error("cannot read postings list.");
+            return -1;
+        }
+        if (open_elias_fano_block(cursor, 0,
+                                  cursor->chunk_first_document_id - 1))
+        {
+            return -1;
+        }
+        return seek_elias_fano_block(cursor, document_id);
+    }
+    if (read_postings(cursor->env, &r, cursor->chunk_first_document_id,
+                      &cursor->chunk, &decoded_len) ||
+        docs_count != decoded_len)
+    {
+        print_error("postings list decode error: token(%d).", cursor->token_id);
+        return -1;
+    }
+    build_postings_cursor_bitmap(cursor, decoded_len);
+    if (cursor->bitmap_words)
+    {
+        cursor->current = probe_postings_cursor_bitmap(cursor, document_id);
+        return 0;
+    }
+    for (cursor->current = cursor->chunk;
+         cursor->current && cursor->current->document_id < document_id;
+         cursor->current = cursor->current->next) {}
+    return 0;
+}
+
+/**
+ * 打开倒排列表的游标，并移动到倒排列表中的第一个元素上
+ * 倒排列表按块读取，只有游标经过的块才会被读取和解码
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[out] cursor 倒排列表的游标。倒排列表为空时，其current为NULL
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+open_postings_cursor(const wiser_env *env, int token_id,
+                     postings_cursor *cursor)
+{
+    memset(cursor, 0, sizeof(postings_cursor));
+    cursor->env = env;
+    cursor->token_id = token_id;
+    return load_postings_chunk(cursor, 0);
+}
+
+/**
+ * 将游标移动到倒排列表中的下一个元素上
+ * @param[in,out] cursor 倒排列表的游标。到达末尾时，其current为NULL
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+postings_cursor_next(postings_cursor *cursor)
+{
+    if (!cursor->current) { return 0; }
+    if (cursor->data)
+    {
+        elias_fano_cursor *ef = &cursor->ef;
+        if (++ef->index < ef->docs_count)
+        {
+            ef->position = elias_fano_next_one(ef, ef->position + 1);
+            set_elias_fano_current(cursor);
+            return 0;
+        }
+        if (ef->end < cursor->data_size)
+        {
+            return seek_elias_fano_block(cursor, ef->last_document_id + 1);
+        }
+        return load_postings_chunk(cursor, 0);
+    }
+    if (!(cursor->current = cursor->current->next))
+    {
+        return load_postings_chunk(cursor, 0);
+    }
+    return 0;
+}
+
+/**
+ * 将游标移动到倒排列表中文档编号不小于指定文档编号的第一个元素上
+ * 所有文档编号都小于指定文档编号的块会被跳过，不会被读取。
+ * 当前块中的文档足够密集时，在位图中查找而不沿着链表查找。
+ * 压缩方法为Elias-Fano时，通过高位数组中的采样查找，不解码区块
+ * @param[in,out] cursor 倒排列表的游标。到达末尾时，其current为NULL
+ * @param[in] document_id 文档编号
+ * @retval 0 成功
+ * @retval -1 失败
+ *
+ * @attention 假定各个块中的文档编号互不重叠
+ */
+int
+postings_cursor_seek(postings_cursor *cursor, int document_id)
+{
+    if (!cursor->current || cursor->current->document_id >= document_id)
+    {
+        return 0;
+    }
+    if (cursor->chunk_last_document_id < document_id)
+    {
+        return load_postings_chunk(cursor, document_id);
+    }
+    if (cursor->data)
+    {
+        return seek_elias_fano_block(cursor, document_id);
+    }
+    if (cursor->bitmap_words)
+    {
+        cursor->current = probe_postings_cursor_bitmap(cursor, document_id);
+        return 0;
+    }
+    while (cursor->current->document_id < document_id)
+    {
+        cursor->current = cursor->current->next;
+    }
+    return 0;
+}
+
+/**
+ * 对游标的当前元素所在的区块进行解码，使当前元素中包含位置信息（或出现次数）
+ * 只有压缩方法为Elias-Fano时才需要解码，其他情况下什么也不做
+ * @param[in,out] cursor 倒排列表的游标
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+postings_cursor_load_positions(postings_cursor *cursor)
+{
+    int i, len = 0;
+    postings_list *pl, *tail = NULL;
+    postings_reader r;
+    const elias_fano_cursor *ef = &cursor->ef;
+
+    if (!cursor->data || !cursor->current || cursor->elements) { return 0; }
+    init_postings_reader(&r, cursor->data + ef->offset,
+                         ef->end - ef->offset);
+    if (decode_postings_block(cursor->env, compress_elias_fano, &r,
+                              ef->base_document_id, &cursor->chunk, &tail,
+                              &len) ||
+        len != ef->docs_count)
+    {
+        print_error("postings list decode error: token(%d).", cursor->token_id);
+        return -1;
+    }
+    if (!(cursor->elements = (postings_list **) malloc(
+            sizeof(postings_list *) * len)))
+    {
+        print_error("memory allocation failed.");
+        return -1;
+    }
+    for (i = 0, pl = cursor->chunk; pl; i++, pl = pl->next)
+    {
+        cursor->elements[i] = pl;
+    }
+    cursor->current = cursor->elements[ef->index];
+    return 0;
+}
+
+/**
+ * 关闭倒排列表的游标
+ * @param[in] cursor 倒排列表的游标
+ */
+void
+close_postings_cursor(postings_cursor *cursor)
+{
+    free_postings_list(cursor->chunk);
+    cursor->chunk = cursor->current = NULL;
+    free_postings_cursor_bitmap(cursor);
+    free(cursor->data);
+    cursor->data = NULL;
+    if (cursor->handle)
+    {
+        db_close_postings_chunk(cursor->env, cursor->handle);
+        cursor->handle = NULL;
+    }
+}
+
+/**
+ * 将倒排列表分割成多个块，并将各个块编码成存储在数据库中的形式
+ * 每个块之前都附加了该块中的文档数、该块的字节数，以及该块中最初和最后的文档编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] postings 待编码的倒排列表
+ * @param[out] chunks 编码后的块的序列
+ */
+static void
+encode_postings_chunks(const wiser_env *env, postings_list *postings,
+                       buffer *chunks)
+{
+    while (postings)
+    {
+        int frame[4] = {0, 0, 0, 0};
+        size_t frame_offset;
+        postings_list *tail, *next;
+
+        /* 暂时切断链表，使其只包含1个块中的元素 */
+        for (tail = postings, frame[0] = 1;
+             tail->next && frame[0] < POSTINGS_CHUNK_DOCUMENTS;
+             tail = tail->next, frame[0]++) {}
+        next = tail->next;
+        tail->next = NULL;
+        frame[2] = postings->document_id;
+        frame[3] = tail->document_id;
+
+        frame_offset = BUFFER_SIZE(chunks);
+        append_buffer(chunks, frame, sizeof(frame));
+        encode_postings(env, postings, frame[0], chunks);
+        frame[1] = (int) (BUFFER_SIZE(chunks) - frame_offset - sizeof(frame));
+        memcpy(BUFFER_PTR(chunks) + frame_offset, frame, sizeof(frame));
+
+        tail->next = next;
+        postings = next;
+    }
+}
+
+/**
+ * 将内存上（小倒排索引中）的倒排列表编码成存储在数据库中的形式
+ * 该函数不访问数据库，因此可以在多个线程中同时调用
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] ii 内存上的倒排索引
+ * @param[in] p 含有倒排列表的倒排索引中的索引项
+ * @param[out] chunks 编码后的块的序列
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+encode_buffered_postings(const wiser_env *env, const inverted_index *ii,
+                         const inverted_index_value *p, buffer *chunks)
+{
+    int rc;
+    postings_list *postings;
+
+    if ((rc = get_buffered_postings(ii, p, &postings, NULL)))
+    {
+        return rc;
+    }
+    encode_postings_chunks(env, postings, chunks);
+    free_postings_list(postings);
+    return 0;
+}
+
+/**
+ * 将编码后的倒排列表的各个块作为指定段的一部分存储到数据库中
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] segment 段的编号
+ * @param[in] token_id 词元编号
+ * @param[in] chunks 编码后的块的序列
+ * @return 写入的块的字节数之和
+ * @retval -1 失败
+ */
+static long long
+write_postings_chunks(const wiser_env *env, int segment, int token_id,
+                      const buffer *chunks)
+{
+    long long written_size = 0;
+    const char *c = BUFFER_PTR(chunks), *end = c + BUFFER_SIZE(chunks);
+    while (c < end)
+    {
+        int frame[4];
+
+        memcpy(frame, c, sizeof(frame));
+        c += sizeof(frame);
+        if (db_insert_postings(env, token_id, frame[2], frame[3], segment,
+                               frame[0], c, frame[1]))
+        {
+            return -1;
+        }
+        c += frame[1];
+        written_size += frame[1];
+    }
+    return written_size;
+}
+
+/**
+ * 将编码后的倒排列表的各个块作为指定段的一部分存储到数据库中，并更新词元的文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] segment 段的编号
+ * @param[in] p 含有倒排列表的倒排索引中的索引项
+ * @param[in] chunks 编码后的块的序列
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+write_postings(const wiser_env *env, int segment,
+               const inverted_index_value *p, const buffer *chunks)
+{
+    if (write_postings_chunks(env, segment, p->token_id, chunks) < 0 ||
+        db_add_token_docs_count(env, p->token_id, p->docs_count))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 将内存上（小倒排索引中）的倒排列表作为指定段的一部分存储到数据库中
+ * 不读取也不改写已经存储在数据库中的其他段
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] segment 段的编号
+ * @param[in] ii 内存上的倒排索引
+ * @param[in] p 含有倒排列表的倒排索引中的索引项
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+update_postings(const wiser_env *env, int segment, const inverted_index *ii,
+                const inverted_index_value *p)
+{
+    int rc = -1;
+    buffer *buf;
+    if ((buf = alloc_buffer()))
+    {
+        if (!encode_buffered_postings(env, ii, p, buf))
+        {
+            rc = write_postings(env, segment, p, buf);
+        }
+        free_buffer(buf);
+    }
+    return rc;
+}
+
+/**
+ * 比较两个倒排列表项的文档编号。用于对重新编号后的倒排列表进行排序
+ * @param[in] a 倒排列表项
+ * @param[in] b 倒排列表项
+ * @return 比较的结果
+ */
+static int
+postings_document_id_cmp(postings_list *a, postings_list *b)
+{
+    return a->document_id - b->document_id;
+}
+
+/**
+ * 将从数据库中读取的若干个块解码、合并后，重新编码成存储在数据库中的形式
+ * 该函数不访问数据库，因此可以在多个线程中同时调用
+ * @param[in] source_env 用于解码原有的块的运行环境
+ * @param[in] env 用于编码的运行环境
+ * @param[in] source 原有的块的序列。每个块之前都附加了该块中的文档数、该块的字节数，
+ *                   以及该块中最初和最后的文档编号
+ * @param[in] document_ids_map 各个文档的新的编号。下标为原有的文档编号-1。
+ *                             为NULL时不改变文档编号
+ * @param[out] chunks 重新编码后的块的序列
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+reencode_postings_chunks(const wiser_env *source_env, const wiser_env *env,
+                         const buffer *source, const int *document_ids_map,
+                         buffer *chunks)
+{
+    const char *c = BUFFER_PTR(source), *end = c + BUFFER_SIZE(source);
+    postings_list *postings = NULL, *tail = NULL;
+
+    while (c < end)
+    {
+        int frame[4], decoded_len;
+        postings_list *pl;
+
+        memcpy(frame, c, sizeof(frame));
+        c += sizeof(frame);
+        if (decode_postings(source_env, c, frame[1], frame[2], &pl,
+                            &decoded_len) ||
+            decoded_len != frame[0])
+        {
+            print_error("postings list decode error");
+            free_postings_list(pl);
+            free_postings_list(postings);
+            return -1;
+        }
+        concat_postings(&postings, &tail, pl);
+        c += frame[1];
+    }
+    if (document_ids_map)
+    {
+        postings_list *p;
+        LL_FOREACH(postings, p)
+        {
+            p->document_id = document_ids_map[p->document_id - 1];
+        }
+        LL_SORT(postings, postings_document_id_cmp);
+    }
+    encode_postings_chunks(env, postings, chunks);
+    free_postings_list(postings);
+    return 0;
+}
+
+/* 并行更新倒排列表时，每个线程最多同时处理多少个索引项 */
+#define FLUSH_JOBS_PER_THREAD 64
+
+/* 并行更新倒排列表时的1个任务 */
+typedef struct _flush_job
+{
+    const inverted_index_value *entry; /* 待更新的索引项。重新编码时为NULL */
+    int token_id;                /* 重新编码时的词元编号 */
+    buffer *source;              /* 重新编码时，待重新编码的块的序列 */
+    buffer *postings_e;          /* 编码后的块的序列 */
+    int rc;                      /* 编码的结果 */
+    int done;                    /* 是否已编码完毕 */
+    struct _flush_job *next;     /* 指向队列中下一个任务（按添加的顺序）的指针 */
+} flush_job;
+
+/* 在写入数据库的线程与进行编码的线程之间共享的任务队列 */
+typedef struct
+{
+    const wiser_env *env;  /* 存储着应用程序运行环境的结构体 */
+    const wiser_env *source_env; /* 重新编码时，用于解码原有的块的运行环境 */
+    const inverted_index *ii; /* 内存上的倒排索引 */
+    const int *document_ids_map; /* 重新编码时，各个文档的新的编号。为NULL时不改变 */
+    int segment;           /* 写入的段的编号 */
+    flush_job *head;       /* 尚未写入数据库的任务中最早添加的任务 */
+    flush_job *tail;       /* 最后添加的任务 */
+    flush_job *todo;       /* 尚未开始编码的任务中最早添加的任务 */
+    int closed;            /* 是否已不会再添加新任务 */
+    pthread_t *threads;    /* 进行编码的线程 */
+    int n_threads;         /* 进行编码的线程数。为0时在当前线程中编码 */
+    int n_jobs;            /* 已添加但尚未写入数据库的任务数 */
+    long long written_size; /* 写入数据库的块的字节数之和 */
+    int rc;                /* 有任务失败时为-1。此后的任务只编码不写入 */
+    pthread_mutex_t mutex;
+    pthread_cond_t todo_cond;
+    pthread_cond_t done_cond;
+} flush_queue;
+
+/**
+ * 对1个任务进行编码。不访问数据库
+ * @param[in] q 任务队列
+ * @param[in,out] job 任务
+ */
+static void
+encode_flush_job(const flush_queue *q, flush_job *job)
+{
+    if (!(job->postings_e = alloc_buffer()))
+    {
+        job->rc = -1;
+    }
+    else if (job->entry)
+    {
+        job->rc = encode_buffered_postings(q->env, q->ii, job->entry,
+                                           job->postings_e);
+    }
+    else
+    {
+        job->rc = reencode_postings_chunks(q->source_env, q->env,
+                                           job->source, q->document_ids_map,
+                                           job->postings_e);
+    }
+}
+
+/**
+ * 将编码完毕的1个任务的结果写入数据库，并释放该任务
+ * 已有任务失败时不再写入，只释放任务
+ * @param[in,out] q 任务队列
+ * @param[in] job 任务
+ */
+static void
+write_flush_job(flush_queue *q, flush_job *job)
+{
+    if (q->rc)
+    {
+        /* do nothing */
+    }
+    else if (job->rc)
+    {
+        print_error("cannot encode postings list.");
+        q->rc = -1;
+    }
+    else if (job->entry)
+    {
+        if (write_postings(q->env, q->segment, job->entry, job->postings_e))
+        {
+            q->rc = -1;
+        }
+    }
+    else
+    {
+        long long size = write_postings_chunks(q->env, q->segment,
+                                               job->token_id, job->postings_e);
+        if (size < 0)
+        {
+            q->rc = -1;
+        }
+        else
+        {
+            q->written_size += size;
+        }
+    }
+    if (job->source) { free_buffer(job->source); }
+    if (job->postings_e) { free_buffer(job->postings_e); }
+    free(job);
+}
+
+/**
+ * 进行编码的线程的主函数。不断从队列中取出任务进行编码
+ * @param[in] arg 任务队列
+ * @return NULL
+ */
+static void *
+flush_worker(void *arg)
+{
+    flush_queue *q = (flush_queue *) arg;
+    while (1)
+    {
+        flush_job *job;
+
+        pthread_mutex_lock(&q->mutex);
+        while (!q->todo && !q->closed)
+        {
+            pthread_cond_wait(&q->todo_cond, &q->mutex);
+        }
+        if (!(job = q->todo))
+        {
+            pthread_mutex_unlock(&q->mutex);
+            break;
+        }
+        q->todo = job->next;
+        pthread_mutex_unlock(&q->mutex);
+
+        encode_flush_job(q, job);
+
+        pthread_mutex_lock(&q->mutex);
+        job->done = 1;
+        pthread_cond_signal(&q->done_cond);
+        pthread_mutex_unlock(&q->mutex);
+    }
+    return NULL;
+}
+
+/**
+ * 将编码完毕的任务的结果按照添加任务的顺序写入数据库
+ * 只写入从最早添加的任务开始连续编码完毕的任务，使写入的顺序与添加的顺序一致
+ * @param[in] q 任务队列
+ * @param[in] wait 最早添加的任务尚未编码完毕时，是否要等待
+ */
+static void
+write_flushed_postings(flush_queue *q, int wait)
+{
+    flush_job *jobs, *job, *tmp;
+
+    pthread_mutex_lock(&q->mutex);
+    while (wait && !q->head->done)
+    {
+        pthread_cond_wait(&q->done_cond, &q->mutex);
+    }
+    jobs = q->head;
+    for (job = NULL; q->head && q->head->done; q->head = q->head->next)
+    {
+        job = q->head;
+    }
+    if (!job)
+    {
+        jobs = NULL;
+    }
+    else
+    {
+        job->next = NULL;
+    }
+    if (!q->head)
+    {
+        q->tail = NULL;
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    LL_FOREACH_SAFE(jobs, job, tmp)
+    {
+        write_flush_job(q, job);
+        q->n_jobs--;
+    }
+}
+
+/**
+ * 初始化任务队列，并启动进行编码的线程
+ * @param[out] q 任务队列。调用前需设定env、source_env、ii和segment以外的成员为0
+ * @param[in] n_threads 进行编码的线程数。不足2时在当前线程中编码
+ */
+static void
+start_flush_queue(flush_queue *q, int n_threads)
+{
+    int i;
+
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->todo_cond, NULL);
+    pthread_cond_init(&q->done_cond, NULL);
+    if (n_threads <= 1 ||
+        !(q->threads = (pthread_t *) malloc(sizeof(pthread_t) * n_threads)))
+    {
+        return;
+    }
+    for (i = 0; i < n_threads; i++)
+    {
+        if (pthread_create(&q->threads[i], NULL, flush_worker, q))
+        {
+            print_error("cannot create flush thread.");
+            break;
+        }
+    }
+    q->n_threads = i;
+}
+
+/**
+ * 将任务添加到队列中。没有进行编码的线程时，立即在当前线程中编码并写入
+ * @param[in,out] q 任务队列
+ * @param[in] job 任务
+ */
+static void
+submit_flush_job(flush_queue *q, flush_job *job)
+{
+    if (!q->n_threads)
+    {
+        encode_flush_job(q, job);
+        write_flush_job(q, job);
+        return;
+    }
+    pthread_mutex_lock(&q->mutex);
+    if (q->tail)
+    {
+        q->tail->next = job;
+    }
+    else
+    {
+        q->head = job;
+    }
+    q->tail = job;
+    if (!q->todo)
+    {
+        q->todo = job;
+    }
+    pthread_cond_signal(&q->todo_cond);
+    pthread_mutex_unlock(&q->mutex);
+    q->n_jobs++;
+
+    /* 处理中的任务过多时，等待编码完毕后再继续添加任务 */
+    write_flushed_postings(q, q->n_jobs >= q->n_threads * FLUSH_JOBS_PER_THREAD);
+}
 
 /**
- * 获取将两个倒排列表合并后得到的倒排列表
- * @param[in] pa 要合并的倒排列表
- * @param[in] pb 要合并的倒排列表
- *
- * @return 合并后的倒排列表
- *
- * @attention 若base和to_be_added（参见函数merge_inverted_index）中的任意一个被破坏了，
- *            或者二者中含有相同的文档编号，则该函数的行为不可预知
+ * 等待所有任务写入数据库后，结束进行编码的线程并释放任务队列
+ * @param[in,out] q 任务队列
  */
-static postings_list *
-merge_postings(postings_list *pa, postings_list *pb)
+static void
+finish_flush_queue(flush_queue *q)
 {
-    postings_list *ret = NULL, *p;
-    /* 用pa和pb分别遍历base和to_be_added（参见函数merge_inverted_index）中的倒排列表中的元素， */
-    /* 将二者连接成按文档编号升序排列的链表 */
-    while (pa || pb)
+    int i;
+
+    pthread_mutex_lock(&q->mutex);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->todo_cond);
+    pthread_mutex_unlock(&q->mutex);
+    while (q->n_jobs > 0)
     {
-        postings_list *e;
-        if (!pb || (pa && pa->document_id <= pb->document_id))
-        {
-            e = pa;
-            pa = pa->next;
-        }
-        else if (!pa || pa->document_id >= pb->document_id)
-        {
-            e = pb;
-            pb = pb->next;
-        }
-        else
-        {
-            abort();
-        }
-        e->next = NULL;
-        if (!ret)
+        write_flushed_postings(q, 1);
+    }
+    for (i = 0; i < q->n_threads; i++)
+    {
+        pthread_join(q->threads[i], NULL);
+    }
+    free(q->threads);
+    pthread_cond_destroy(&q->done_cond);
+    pthread_cond_destroy(&q->todo_cond);
+    pthread_mutex_destroy(&q->mutex);
+}
+
+/**
+ * 按照词元编号比较两个索引项
+ * @param[in] a 指向索引项a的指针
+ * @param[in] b 指向索引项b的指针
+ * @return 词元编号的大小关系
+ */
+static int
+inverted_index_value_token_id_asc_sort(const void *a, const void *b)
+{
+    int ta = (*(const inverted_index_value **) a)->token_id,
+            tb = (*(const inverted_index_value **) b)->token_id;
+    return (ta > tb) - (ta < tb);
+}
+
+/**
+ * 将内存上的倒排索引中的所有倒排列表作为1个新的段存储到数据库中
+ * 按照词元编号的升序依次写入，使对postings表的写入集中在B树中相邻的位置上。
+ * 编码由多个线程并行进行，只有对数据库的写入在调用该函数的线程中进行
+ * 失败时已写入的部分不会撤销，需要由调用者回滚事务
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] ii 内存上的倒排索引
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+update_inverted_index(const wiser_env *env, const inverted_index *ii)
+{
+    int i, n_threads, n_entries, segment;
+    inverted_index_value *p, **entries;
+    flush_queue q;
+
+    if ((segment = db_add_segment(env, 0)) < 0)
+    {
+        print_error("cannot add a segment.");
+        return -1;
+    }
+    if (!(entries = (inverted_index_value **) malloc(
+            sizeof(inverted_index_value *) * (ii->entries_count + 1))))
+    {
+        print_error("cannot allocate memory for flushing.");
+        return -1;
+    }
+    for (n_entries = 0, p = inverted_index_next(ii, NULL); p;
+         n_entries++, p = inverted_index_next(ii, p))
+    {
+        entries[n_entries] = p;
+    }
+    qsort(entries, n_entries, sizeof(inverted_index_value *),
+          inverted_index_value_token_id_asc_sort);
+
+    memset(&q, 0, sizeof(flush_queue));
+    q.env = env;
+    q.ii = ii;
+    q.segment = segment;
+    n_threads = env->flush_threads;
+    if (n_threads > n_entries) { n_threads = n_entries; }
+    start_flush_queue(&q, n_threads);
+    for (i = 0; i < n_entries && !q.rc; i++)
+    {
+        flush_job *job;
+
+        if (!(job = (flush_job *) calloc(1, sizeof(flush_job))))
         {
-            ret = e;
+            print_error("cannot allocate memory for a flush job.");
+            q.rc = -1;
+            break;
         }
-        else
+        job->entry = entries[i];
+        submit_flush_job(&q, job);
+    }
+    finish_flush_queue(&q);
+    free(entries);
+    if (q.rc)
+    {
+        print_error("cannot update inverted index.");
+    }
+    return q.rc;
+}
+
+/**
+ * 将1个块追加到合并中的块的末尾
+ * 两个块中的文档编号不重叠时，只对追加的块中的第一个区块重新编码，
+ * 使其以合并中的块中最后的文档编号为基准文档编号，其余的区块原样连接起来
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in,out] chunk 合并中的块。为空时直接复制postings_e
+ * @param[in,out] chunk_first_document_id 合并中的块中最初的文档编号
+ * @param[in,out] chunk_last_document_id 合并中的块中最后的文档编号
+ * @param[in] postings_e 要追加的块
+ * @param[in] postings_e_size 要追加的块的字节数
+ * @param[in] first_document_id 要追加的块中最初的文档编号
+ * @param[in] last_document_id 要追加的块中最后的文档编号
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+append_postings_chunk(const wiser_env *env, buffer *chunk,
+                      int *chunk_first_document_id,
+                      int *chunk_last_document_id,
+                      const char *postings_e, int postings_e_size,
+                      int first_document_id, int last_document_id)
+{
+    int len = 0;
+    postings_list *postings = NULL, *tail = NULL, *pl;
+
+    if (!BUFFER_SIZE(chunk))
+    {
+        append_buffer(chunk, postings_e, postings_e_size);
+        *chunk_first_document_id = first_document_id;
+        *chunk_last_document_id = last_document_id;
+        return 0;
+    }
+    if (first_document_id > *chunk_last_document_id)
+    {
+        /* 不压缩时没有基准文档编号；基准文档编号恰好一致时也可以原样连接 */
+        if (env->compress != compress_none &&
+            first_document_id - 1 != *chunk_last_document_id)
         {
-            p->next = e;
+            postings_reader r;
+
+            init_postings_reader(&r, postings_e, postings_e_size);
+            if (decode_postings_block(env, env->compress, &r,
+                                      first_document_id - 1,
+                                      &postings, &tail, &len) ||
+                encode_postings_block(env, env->compress,
+                                      *chunk_last_document_id,
+                                      postings, len, chunk))
+            {
+                print_error("postings list decode error");
+                free_postings_list(postings);
+                return -1;
+            }
+            free_postings_list(postings);
+            postings_e_size -= (int) (r.curr - postings_e);
+            postings_e = r.curr;
         }
-        p = e;
+        append_buffer(chunk, postings_e, postings_e_size);
+        *chunk_last_document_id = last_document_id;
+        return 0;
     }
-    return ret;
+    /* 文档编号重叠时，解码后再合并 */
+    if (decode_postings(env, BUFFER_PTR(chunk), BUFFER_SIZE(chunk),
+                        *chunk_first_document_id, &postings, &len) ||
+        decode_postings(env, postings_e, postings_e_size, first_document_id,
+                        &pl, &len))
+    {
+        print_error("postings list decode error");
+        free_postings_list(postings);
+        return -1;
+    }
+    concat_postings(&postings, &tail, pl);
+    for (len = 0, pl = postings; pl; pl = pl->next) { len++; }
+    BUFFER_CLEAR(chunk);
+    encode_postings(env, postings, len, chunk);
+    *chunk_first_document_id = postings->document_id;
+    *chunk_last_document_id = tail->document_id;
+    free_postings_list(postings);
+    return 0;
 }
 
 /**
- * 将内存上（小倒排索引中）的倒排列表与存储器上的倒排列表合并后存储到数据库中
+ * 将合并后的块写入数据库
  * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in] p 含有倒排列表的倒排索引中的索引项
+ * @param[in] token_id 词元编号
+ * @param[in] segment 段的编号
+ * @param[in] first_document_id 块中最初的文档编号
+ * @param[in] last_document_id 块中最后的文档编号
+ * @param[in] docs_count 块中的文档数
+ * @param[in,out] chunk 合并后的块。写入后被清空
+ * @retval 0 成功
+ * @retval -1 失败
  */
-void
-update_postings(const wiser_env *env, inverted_index_value *p)
+static int
+write_postings_chunk(const wiser_env *env, int token_id, int segment,
+                     int first_document_id, int last_document_id,
+                     int docs_count, buffer *chunk)
+{
+    int rc;
+
+    rc = db_insert_postings(env, token_id, first_document_id,
+                            last_document_id, segment, docs_count,
+                            BUFFER_PTR(chunk), BUFFER_SIZE(chunk));
+    BUFFER_CLEAR(chunk);
+    return rc;
+}
+
+/**
+ * 将编号在指定范围内的段合并成1个新的段
+ * 同一个词元的相邻的块被连接起来，直到块中的文档数达到POSTINGS_CHUNK_DOCUMENTS为止
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] level 被合并的段的级别
+ * @param[in] min_segment 被合并的段的编号的最小值
+ * @param[in] max_segment 被合并的段的编号的最大值
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+merge_segments(const wiser_env *env, int level,
+               int min_segment, int max_segment)
 {
-    int old_postings_len;
-    postings_list *old_postings;
+    int rc, segment, token_id = 0, docs_count = 0;
+    int first_document_id = 0, last_document_id = 0;
+    int next_token_id, next_first, next_last, next_docs_count;
+    int postings_e_size;
+    char *e;
+    buffer *chunk;
 
-    if (!fetch_postings(env, p->token_id, &old_postings,
-                        &old_postings_len))
+    /* 合并后的段的编号大于所有被合并的段，因此段的顺序与文档编号的顺序保持一致 */
+    if ((segment = db_add_segment(env, level + 1)) < 0)
+    {
+        return -1;
+    }
+    if (!(chunk = alloc_buffer()))
+    {
+        print_error("cannot allocate memory for merging segments.");
+        return -1;
+    }
+    rc = db_get_segment_postings(env, min_segment, max_segment, &next_token_id,
+                                 &next_first, &next_last, &next_docs_count,
+                                 (void **) &e, &postings_e_size);
+    while (!rc)
     {
-        buffer *buf;
-        if (old_postings_len)
+        if (docs_count)
         {
-            p->postings_list = merge_postings(old_postings, p->postings_list);
-            p->docs_count += old_postings_len;
+            /* 词元改变了，或者块已满且文档编号不重叠时，写出合并中的块 */
+            if (!e || next_token_id != token_id ||
+                (docs_count + next_docs_count > POSTINGS_CHUNK_DOCUMENTS &&
+                 next_first > last_document_id))
+            {
+                if ((rc = write_postings_chunk(env, token_id, segment,
+                                               first_document_id,
+                                               last_document_id,
+                                               docs_count, chunk)))
+                {
+                    break;
+                }
+                docs_count = 0;
+            }
         }
-        if ((buf = alloc_buffer()))
+        if (!e) { break; }
+        /* 从数据库中读取的字节序列在下次访问数据库时就会失效，所以在此复制到块中 */
+        if ((rc = append_postings_chunk(env, chunk, &first_document_id,
+                                        &last_document_id, e, postings_e_size,
+                                        next_first, next_last)))
         {
-            encode_postings(env, p->postings_list, p->docs_count, buf);
-            db_update_postings(env, p->token_id, p->docs_count,
-                               BUFFER_PTR(buf), BUFFER_SIZE(buf));
-            free_buffer(buf);
+            break;
         }
+        token_id = next_token_id;
+        docs_count += next_docs_count;
+        rc = db_next_segment_postings(env, &next_token_id, &next_first,
+                                      &next_last, &next_docs_count,
+                                      (void **) &e, &postings_e_size);
     }
-    else
+    if (!rc && db_delete_segments(env, min_segment, max_segment))
     {
-        print_error("cannot fetch old postings list of token(%d) for update.",
-                    p->token_id);
+        rc = -1;
     }
+    free_buffer(chunk);
+    return rc;
 }
 
 /**
- * 合并两个倒排索引
- * @param[in] base 合并后其中的元素会增多的倒排索引（合并目标）
- * @param[in] to_be_added 合并后就被释放的倒排索引（合并源）
- *
+ * 按照分级（Tiered）合并策略合并段
+ * 同一级别的段达到SEGMENT_MERGE_FACTOR个时，将它们合并成1个上一级的段，
+ * 并对上一级的段重复同样的检查
+ * @param[in] env 存储着应用程序运行环境的结构体
  */
 void
-merge_inverted_index(inverted_index_hash *base,
-                     inverted_index_hash *to_be_added)
+compact_segments(const wiser_env *env)
+{
+    int level;
+    for (level = 0;; level++)
+    {
+        int count, min_segment, max_segment;
+
+        count = db_get_segments(env, level, &min_segment, &max_segment);
+        if (count < SEGMENT_MERGE_FACTOR) { break; }
+        if (merge_segments(env, level, min_segment, max_segment))
+        {
+            print_error("cannot merge segments. (level: %d)", level);
+            break;
+        }
+        print_error("segments merged. (level: %d, segments: %d)",
+                    level, count);
+    }
+}
+
+/**
+ * 将数据库中的所有段合并成1个新的段，并对所有倒排列表重新编码
+ * 同一个词元的块被解码、合并后，按照当前的压缩方法重新编码，
+ * 因此每个块都只由1个以最新的参数编码的区块构成。
+ * 重新编码由多个线程并行进行，只有对数据库的读写在调用该函数的线程中进行
+ * @param[in] env 存储着应用程序运行环境的结构体。按照其中的压缩方法重新编码
+ * @param[in] source_compress 数据库中原有的倒排列表的压缩方法
+ * @param[in] document_ids_map 各个文档的新的编号。下标为原有的文档编号-1。
+ *                             为NULL时不改变文档编号
+ * @param[out] source_size 原有的倒排列表的字节数之和
+ * @param[out] optimized_size 重新编码后的倒排列表的字节数之和
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+optimize_index(const wiser_env *env, compress_method source_compress,
+               const int *document_ids_map,
+               long long *source_size, long long *optimized_size)
 {
-    inverted_index_value *p, *temp;
+    int rc, level, top_level = 0, segment, n_threads;
+    int token_id = 0, docs_count = 0, last_document_id = 0;
+    int next_token_id, next_first, next_last, next_docs_count;
+    int postings_e_size;
+    char *e;
+    wiser_env source_env;
+    flush_job *job = NULL;
+    flush_queue q;
 
-    HASH_ITER(hh, to_be_added, p, temp)
+    *source_size = *optimized_size = 0;
+    source_env = *env;
+    source_env.compress = source_compress;
+
+    /* 新的段的级别高于所有已有的段，之后的合并不会再涉及它 */
+    for (level = 0; level < SEGMENT_MAX_LEVEL; level++)
     {
-        inverted_index_value *t;
-        HASH_DEL(to_be_added, p);
-        HASH_FIND_INT(base, &p->token_id, t);
-        if (t)
+        int min_segment, max_segment;
+        if (db_get_segments(env, level, &min_segment, &max_segment) > 0)
         {
-            t->postings_list = merge_postings(t->postings_list, p->postings_list);
-            t->docs_count += p->docs_count;
-            free(p);
+            top_level = level;
+        }
+    }
+    if ((segment = db_add_segment(env, top_level + 1)) < 0)
+    {
+        return -1;
+    }
+
+    memset(&q, 0, sizeof(flush_queue));
+    q.env = env;
+    q.source_env = &source_env;
+    q.document_ids_map = document_ids_map;
+    q.segment = segment;
+    n_threads = env->flush_threads;
+    start_flush_queue(&q, n_threads);
+
+    rc = db_get_segment_postings(env, 0, segment - 1, &next_token_id,
+                                 &next_first, &next_last, &next_docs_count,
+                                 (void **) &e, &postings_e_size);
+    while (!rc)
+    {
+        if (job)
+        {
+            /* 词元改变了，或者块已满且文档编号不重叠时，提交合并中的块。
+               改变文档编号时，同一个词元的块需要整体重新排序，因此只在词元改变时提交 */
+            if (!e || next_token_id != token_id ||
+                (!document_ids_map &&
+                 docs_count + next_docs_count > POSTINGS_CHUNK_DOCUMENTS &&
+                 next_first > last_document_id))
+            {
+                submit_flush_job(&q, job);
+                job = NULL;
+                docs_count = 0;
+            }
+        }
+        if (!e) { break; }
+        if (!job)
+        {
+            if (!(job = (flush_job *) calloc(1, sizeof(flush_job))) ||
+                !(job->source = alloc_buffer()))
+            {
+                print_error("cannot allocate memory for optimizing index.");
+                free(job);
+                job = NULL;
+                rc = -1;
+                break;
+            }
+            job->token_id = next_token_id;
         }
-        else
         {
-            HASH_ADD_INT(base, token_id, p);
+            int frame[4];
+            frame[0] = next_docs_count;
+            frame[1] = postings_e_size;
+            frame[2] = next_first;
+            frame[3] = next_last;
+            /* 从数据库中读取的字节序列在下次访问数据库时就会失效，所以在此复制 */
+            append_buffer(job->source, frame, sizeof(frame));
+            append_buffer(job->source, e, postings_e_size);
+            if (!docs_count || next_last > last_document_id)
+            {
+                last_document_id = next_last;
+            }
         }
+        *source_size += postings_e_size;
+        token_id = next_token_id;
+        docs_count += next_docs_count;
+        rc = db_next_segment_postings(env, &next_token_id, &next_first,
+                                      &next_last, &next_docs_count,
+                                      (void **) &e, &postings_e_size);
+    }
+    if (job)
+    {
+        free_buffer(job->source);
+        free(job);
+    }
+    finish_flush_queue(&q);
+    if (q.rc) { rc = -1; }
+    if (!rc && db_delete_segments(env, 0, segment - 1))
+    {
+        rc = -1;
     }
+    *optimized_size = q.written_size;
+    return rc;
 }
 
 /**
@@ -593,19 +3938,23 @@ free_postings_list(postings_list *pl)
 
 /**
  * 输出倒排索引的内容
+ * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] ii 指向倒排索引的指针
  */
 void
-dump_inverted_index(wiser_env *env, inverted_index_hash *ii)
+dump_inverted_index(wiser_env *env, const inverted_index *ii)
 {
     inverted_index_value *it;
-    for (it = ii; it != NULL; it = it->hh.next)
+    for (it = inverted_index_next(ii, NULL); it != NULL;
+         it = inverted_index_next(ii, it))
     {
-        int token_len;
-        const char *token;
+        postings_list *postings;
 
         if (it->token_id)
         {
+            int token_len;
+            const char *token;
+
             db_get_token(env, it->token_id, &token, &token_len);
             printf("TOKEN %d.%.*s(%d):\n", it->token_id, token_len, token,
                    it->docs_count);
@@ -614,31 +3963,218 @@ dump_inverted_index(wiser_env *env, inverted_index_hash *ii)
         {
             puts("TOKEN NONE:");
         }
-        if (it->postings_list)
+        if (!get_buffered_postings(ii, it, &postings, NULL) && postings)
         {
             printf("POSTINGS: [\n  ");
-            dump_postings_list(it->postings_list);
+            dump_postings_list(postings);
             puts("]");
+            free_postings_list(postings);
         }
     }
 }
 
+/* 倒排索引的初始槽数（以2为底的对数） */
+#define II_INITIAL_SLOTS_BITS 6
+
+/**
+ * 为倒排索引分配指定数量的空槽
+ * @param[in,out] ii 指向倒排索引的指针
+ * @param[in] bits 槽数（以2为底的对数）
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+alloc_inverted_index_slots(inverted_index *ii, unsigned int bits)
+{
+    unsigned int i;
+    inverted_index_value *slots;
+
+    if (!(slots = malloc(sizeof(inverted_index_value) << bits)))
+    {
+        return -1;
+    }
+    for (i = 0; i < 1U << bits; i++)
+    {
+        slots[i].token_id = II_EMPTY_SLOT;
+    }
+    ii->slots = slots;
+    ii->slots_count = 1U << bits;
+    ii->slots_shift = 32 - bits;
+    return 0;
+}
+
 /**
- * 释放倒排索引
+ * 计算词元编号所对应的槽的编号（Fibonacci散列）
  * @param[in] ii 指向倒排索引的指针
+ * @param[in] token_id 词元编号
+ * @return 槽的编号
  */
-void
-free_inverted_index(inverted_index_hash *ii)
+static inline unsigned int
+inverted_index_slot(const inverted_index *ii, int token_id)
+{
+    return ((uint32_t) token_id * 2654435769U) >> ii->slots_shift;
+}
+
+/**
+ * 将倒排索引的槽数扩大为原来的2倍
+ * 依次扫描旧的槽的数组，把索引项移动到新的槽中
+ * @param[in,out] ii 指向倒排索引的指针
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+grow_inverted_index(inverted_index *ii)
+{
+    unsigned int old_slots_count = ii->slots_count;
+    inverted_index_value *old_slots = ii->slots, *p;
+
+    if (alloc_inverted_index_slots(ii, 33 - ii->slots_shift))
+    {
+        return -1;
+    }
+    for (p = old_slots; p < old_slots + old_slots_count; p++)
+    {
+        unsigned int i;
+        if (p->token_id == II_EMPTY_SLOT) { continue; }
+        for (i = inverted_index_slot(ii, p->token_id);
+             ii->slots[i].token_id != II_EMPTY_SLOT;
+             i = (i + 1) & (ii->slots_count - 1)) {}
+        ii->slots[i] = *p;
+    }
+    free(old_slots);
+    return 0;
+}
+
+/**
+ * 从倒排索引中获取指定词元的索引项，找不到时添加新的索引项
+ * @param[in,out] ii 指向倒排索引的指针
+ * @param[in] token_id 词元编号
+ * @param[out] created 是否添加了新的索引项。新的索引项中只设定了token_id
+ * @return 索引项。添加失败时返回NULL
+ *
+ * @attention 添加索引项后，之前获取的指向索引项的指针都会失效
+ */
+inverted_index_value *
+get_inverted_index_value(inverted_index *ii, int token_id, int *created)
+{
+    unsigned int i;
+
+    for (i = inverted_index_slot(ii, token_id);
+         ii->slots[i].token_id != II_EMPTY_SLOT;
+         i = (i + 1) & (ii->slots_count - 1))
+    {
+        if (ii->slots[i].token_id == token_id)
+        {
+            *created = 0;
+            return &ii->slots[i];
+        }
+    }
+    /* 为了缩短探测的距离，使负载率不超过1/2 */
+    if ((ii->entries_count + 1) * 2 > ii->slots_count)
+    {
+        if (grow_inverted_index(ii))
+        {
+            print_error("cannot allocate memory for an inverted index.");
+            return NULL;
+        }
+        for (i = inverted_index_slot(ii, token_id);
+             ii->slots[i].token_id != II_EMPTY_SLOT;
+             i = (i + 1) & (ii->slots_count - 1)) {}
+    }
+    ii->slots[i].token_id = token_id;
+    ii->entries_count++;
+    *created = 1;
+    return &ii->slots[i];
+}
+
+/**
+ * 获取倒排索引中的下一个索引项
+ * @param[in] ii 指向倒排索引的指针
+ * @param[in] p 当前的索引项。为NULL时获取第一个索引项
+ * @return 下一个索引项。没有下一个索引项时返回NULL
+ */
+inverted_index_value *
+inverted_index_next(const inverted_index *ii, const inverted_index_value *p)
+{
+    const inverted_index_value *end = ii->slots + ii->slots_count;
+    for (p = p ? p + 1 : ii->slots; p < end; p++)
+    {
+        if (p->token_id != II_EMPTY_SLOT)
+        {
+            return (inverted_index_value *) p;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 分配一个空的倒排索引
+ * @return 指向分配好的倒排索引的指针
+ */
+inverted_index *
+alloc_inverted_index(void)
 {
-    inverted_index_value *cur;
-    while (ii)
+    inverted_index *ii;
+    if ((ii = malloc(sizeof(inverted_index))))
     {
-        cur = ii;
-        HASH_DEL(ii, cur);
-        if (cur->postings_list)
+        ii->entries_count = 0;
+        if (!(ii->pool = alloc_byte_pool()))
+        {
+            free(ii);
+            ii = NULL;
+        }
+        else if (alloc_inverted_index_slots(ii, II_INITIAL_SLOTS_BITS))
         {
-            free_postings_list(cur->postings_list);
+            free_byte_pool(ii->pool);
+            free(ii);
+            ii = NULL;
         }
-        free(cur);
     }
+    if (!ii)
+    {
+        print_error("cannot allocate memory for an inverted index.");
+    }
+    return ii;
+}
+
+/**
+ * 获取倒排索引占用的字节数
+ * @param[in] ii 指向倒排索引的指针
+ * @return 槽的数组和字节池占用的字节数之和
+ */
+size_t
+inverted_index_size(const inverted_index *ii)
+{
+    return sizeof(inverted_index) + byte_pool_size(ii->pool)
+           + ii->slots_count * sizeof(inverted_index_value);
+}
+
+/**
+ * 获取倒排索引中的词元的出现次数之和，即其中所有文档的长度之和
+ * @param[in] ii 指向倒排索引的指针
+ * @return 词元的出现次数之和
+ */
+long long
+inverted_index_tokens_count(const inverted_index *ii)
+{
+    long long count = 0;
+    const inverted_index_value *p;
+
+    for (p = inverted_index_next(ii, NULL); p; p = inverted_index_next(ii, p))
+    {
+        count += p->positions_count;
+    }
+    return count;
+}
+
+/**
+ * 释放倒排索引。字节池中的倒排列表被一次性地释放
+ * @param[in] ii 指向倒排索引的指针
+ */
+void
+free_inverted_index(inverted_index *ii)
+{
+    free(ii->slots);
+    free_byte_pool(ii->pool);
+    free(ii);
 }
@@ -3,20 +3,94 @@
 
 #include "wiser.h"
 
+/* 在Elias-Fano编码的区块中，不解码整个区块而在高位数组中查找文档编号的状态 */
+typedef struct
+{
+    const unsigned char *low;     /* 低位数组 */
+    const unsigned char *high;    /* 高位数组 */
+    const unsigned char *samples; /* 高位数组中0的位置的采样（int的数组） */
+    int samples_count;            /* 采样数 */
+    int base_document_id;         /* 基准文档编号 */
+    int last_document_id;         /* 区块中最后的文档编号 */
+    int docs_count;               /* 区块中的文档数 */
+    int l;                        /* 低位的比特数 */
+    int high_bits;                /* 高位数组的比特数 */
+    int offset;                   /* 区块在块中的起始位置 */
+    int end;                      /* 区块在块中的结尾 */
+    int index;                    /* 当前元素在区块中的下标 */
+    int position;                 /* 当前元素在高位数组中对应的比特的位置 */
+} elias_fano_cursor;
+
+/* 按块读取存储在数据库中的倒排列表的游标 */
+typedef struct
+{
+    const wiser_env *env;        /* 存储着应用程序运行环境的结构体 */
+    int token_id;                /* 词元编号 */
+    int chunk_first_document_id; /* 当前块中最初的文档编号 */
+    int chunk_last_document_id;  /* 当前块中最后的文档编号 */
+    void *handle;                /* 流式读取块时使用的块的句柄 */
+    postings_list *chunk;        /* 当前块中的倒排列表。Elias-Fano时为解码后的当前区块 */
+    postings_list *current;      /* 当前的元素。为NULL时表示已到达末尾 */
+    /* 当前块中文档的密度不低于bitmap_threshold时，按位图查找文档编号 */
+    uint64_t *bitmap;            /* 当前块中文档编号的位图 */
+    int *bitmap_ranks;           /* 位图中各个字（64比特）之前的元素数 */
+    postings_list **elements;    /* 当前块中的元素的数组 */
+    int bitmap_base;             /* 位图中第0个比特对应的文档编号 */
+    int bitmap_words;            /* 位图的字数。为0时按链表查找 */
+    /* 压缩方法为Elias-Fano时，在高位数组中查找文档编号，只在需要时解码区块 */
+    char *data;                  /* 当前块的数据。不按Elias-Fano查找时为NULL */
+    int data_size;               /* 当前块的字节数 */
+    elias_fano_cursor ef;        /* 当前区块中的查找状态 */
+    postings_list element;       /* 尚未解码当前区块时，current指向的元素 */
+} postings_cursor;
+
 int fetch_postings(const wiser_env *env, const int token_id,
                    postings_list **postings, int *postings_len);
 
-void merge_inverted_index(inverted_index_hash *base,
-                          inverted_index_hash *to_be_added);
+int open_postings_cursor(const wiser_env *env, int token_id,
+                         postings_cursor *cursor);
+
+int postings_cursor_next(postings_cursor *cursor);
+
+int postings_cursor_seek(postings_cursor *cursor, int document_id);
+
+int postings_cursor_load_positions(postings_cursor *cursor);
+
+void close_postings_cursor(postings_cursor *cursor);
+
+int get_buffered_postings(const inverted_index *ii,
+                          const inverted_index_value *p,
+                          postings_list **postings, int *postings_len);
+
+inverted_index_value *get_inverted_index_value(inverted_index *ii,
+                                               int token_id, int *created);
 
-void update_postings(const wiser_env *env, inverted_index_hash *p);
+inverted_index_value *inverted_index_next(const inverted_index *ii,
+                                          const inverted_index_value *p);
+
+int update_postings(const wiser_env *env, int segment,
+                    const inverted_index *ii, const inverted_index_value *p);
+
+int update_inverted_index(const wiser_env *env, const inverted_index *ii);
+
+void compact_segments(const wiser_env *env);
+
+int optimize_index(const wiser_env *env, compress_method source_compress,
+                   const int *document_ids_map,
+                   long long *source_size, long long *optimized_size);
 
 void dump_postings_list(const postings_list *postings);
 
 void free_postings_list(postings_list *pl);
 
-void dump_inverted_index(wiser_env *env, inverted_index_hash *ii);
+void dump_inverted_index(wiser_env *env, const inverted_index *ii);
+
+inverted_index *alloc_inverted_index(void);
+
+size_t inverted_index_size(const inverted_index *ii);
+
+long long inverted_index_tokens_count(const inverted_index *ii);
 
-void free_inverted_index(inverted_index_hash *ii);
+void free_inverted_index(inverted_index *ii);
 
 #endif /* __POSTINGS_H__ */
@@ -0,0 +1,292 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "reorder.h"
+#include "postings.h"
+#include "database.h"
+
+/*
+ * 用递归图二分（Recursive Graph Bisection）对文档编号重新排序
+ * 将文档和词元看作二分图，把文档的序列递归地分成两半，并在两半之间交换文档，
+ * 使包含相同词元的文档尽量集中在同一半中。
+ * 目标函数是用对数近似的、两半中各个倒排列表的文档编号之差的编码长度之和，
+ * 因此重新编号后，倒排列表中的文档编号之差变小，编码后的倒排列表也随之变小
+ */
+
+/* 文档数不超过该值的序列不再二分 */
+#define REORDER_LEAF_SIZE 16
+/* 每次二分时，在两半之间交换文档的最大轮数 */
+#define REORDER_ITERATIONS 20
+
+/* 文档移动到另一半时目标函数的减少量 */
+typedef struct
+{
+    double gain;  /* 减少量。为正时移动文档能使倒排列表变小 */
+    int document; /* 文档的下标（文档编号-1） */
+} reorder_gain;
+
+/* 文档-词元的正排索引，以及二分时使用的工作区 */
+typedef struct
+{
+    int documents_count;  /* 文档数 */
+    int terms_count;      /* 词元数。只包含对排序有影响的词元 */
+    int *offsets;         /* 各个文档的词元在terms中的起始位置。元素数为文档数+1 */
+    int *terms;           /* 各个文档中出现的词元的下标 */
+    int *left_degrees;    /* 各个词元在左半部分中出现的文档数 */
+    int *right_degrees;   /* 各个词元在右半部分中出现的文档数 */
+    double *log2_table;   /* log2_table[i]为log2(i) */
+    reorder_gain *gains;  /* 各个文档的收益 */
+} reorder_context;
+
+/**
+ * 从数据库中读取所有倒排列表，构建以文档为键的正排索引
+ * 只出现在1个文档中、或出现在所有文档中的词元对排序没有影响，因此将其排除
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in,out] ctx 排序的上下文。其中已设定了文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+load_forward_index(const wiser_env *env, reorder_context *ctx)
+{
+    int rc = -1, token_id, max_token_id, i;
+    int *pairs = NULL, pairs_count = 0, pairs_capacity = 0;
+
+    max_token_id = db_get_max_token_id(env);
+    for (token_id = 1; token_id <= max_token_id; token_id++)
+    {
+        int postings_len;
+        postings_list *postings, *p;
+
+        if (fetch_postings(env, token_id, &postings, &postings_len))
+        {
+            print_error("cannot fetch postings list. (token_id: %d)",
+                        token_id);
+            goto exit;
+        }
+        if (postings_len < 2 || postings_len >= ctx->documents_count)
+        {
+            free_postings_list(postings);
+            continue;
+        }
+        if (pairs_count + postings_len * 2 > pairs_capacity)
+        {
+            int *new_pairs;
+            pairs_capacity = (pairs_count + postings_len * 2) * 2;
+            if (!(new_pairs = realloc(pairs, sizeof(int) * pairs_capacity)))
+            {
+                print_error("cannot allocate memory for reordering.");
+                free_postings_list(postings);
+                goto exit;
+            }
+            pairs = new_pairs;
+        }
+        for (p = postings; p; p = p->next)
+        {
+            if (p->document_id < 1 || p->document_id > ctx->documents_count)
+            {
+                print_error("document id out of range. (document_id: %d)",
+                            p->document_id);
+                free_postings_list(postings);
+                goto exit;
+            }
+            pairs[pairs_count++] = p->document_id - 1;
+            pairs[pairs_count++] = ctx->terms_count;
+        }
+        ctx->terms_count++;
+        free_postings_list(postings);
+    }
+
+    /* 按文档对(文档, 词元)的对进行计数排序 */
+    if (!(ctx->offsets = calloc(ctx->documents_count + 1, sizeof(int))) ||
+        !(ctx->terms = malloc(sizeof(int) * (pairs_count / 2 + 1))))
+    {
+        print_error("cannot allocate memory for reordering.");
+        goto exit;
+    }
+    for (i = 0; i < pairs_count; i += 2) { ctx->offsets[pairs[i] + 1]++; }
+    for (i = 0; i < ctx->documents_count; i++)
+    {
+        ctx->offsets[i + 1] += ctx->offsets[i];
+    }
+    for (i = 0; i < pairs_count; i += 2)
+    {
+        ctx->terms[ctx->offsets[pairs[i]]++] = pairs[i + 1];
+    }
+    for (i = ctx->documents_count; i > 0; i--)
+    {
+        ctx->offsets[i] = ctx->offsets[i - 1];
+    }
+    ctx->offsets[0] = 0;
+    rc = 0;
+exit:
+    free(pairs);
+    return rc;
+}
+
+/**
+ * 计算1个词元在1个部分中的文档编号之差的近似编码长度
+ * @param[in] ctx 排序的上下文
+ * @param[in] degree 该部分中包含该词元的文档数
+ * @param[in] n 该部分中的文档数
+ * @return 近似的编码长度（比特）
+ */
+static inline double
+term_cost(const reorder_context *ctx, int degree, int n)
+{
+    return degree * (ctx->log2_table[n] - ctx->log2_table[degree + 1]);
+}
+
+/**
+ * 比较两个收益。用于将收益按降序排列，收益相同时按文档的下标排列
+ * @param[in] a 收益
+ * @param[in] b 收益
+ * @return 比较的结果
+ */
+static int
+compare_gains(const void *a, const void *b)
+{
+    const reorder_gain *ga = (const reorder_gain *) a;
+    const reorder_gain *gb = (const reorder_gain *) b;
+    if (ga->gain > gb->gain) { return -1; }
+    if (ga->gain < gb->gain) { return 1; }
+    return ga->document - gb->document;
+}
+
+/**
+ * 将文档的序列分成两半，反复交换两半中的文档使目标函数减小，再对两半递归地进行同样的处理
+ * @param[in,out] ctx 排序的上下文
+ * @param[in,out] order 文档的序列（文档的下标的数组）
+ * @param[in] n 序列中的文档数
+ */
+static void
+bisect_documents(reorder_context *ctx, int *order, int n)
+{
+    int i, iteration, left_n = n / 2, right_n = n - n / 2;
+
+    if (n <= REORDER_LEAF_SIZE) { return; }
+    for (iteration = 0; iteration < REORDER_ITERATIONS; iteration++)
+    {
+        int swaps = 0;
+
+        /* 统计各个词元在两半中出现的文档数 */
+        for (i = 0; i < n; i++)
+        {
+            int j;
+            for (j = ctx->offsets[order[i]]; j < ctx->offsets[order[i] + 1]; j++)
+            {
+                ctx->left_degrees[ctx->terms[j]] = 0;
+                ctx->right_degrees[ctx->terms[j]] = 0;
+            }
+        }
+        for (i = 0; i < n; i++)
+        {
+            int j, *degrees = i < left_n ? ctx->left_degrees
+                                         : ctx->right_degrees;
+            for (j = ctx->offsets[order[i]]; j < ctx->offsets[order[i] + 1]; j++)
+            {
+                degrees[ctx->terms[j]]++;
+            }
+        }
+
+        /* 计算各个文档移动到另一半时的收益 */
+        for (i = 0; i < n; i++)
+        {
+            int j;
+            double gain = 0;
+            for (j = ctx->offsets[order[i]]; j < ctx->offsets[order[i] + 1]; j++)
+            {
+                int l = ctx->left_degrees[ctx->terms[j]];
+                int r = ctx->right_degrees[ctx->terms[j]];
+                if (i < left_n)
+                {
+                    gain += term_cost(ctx, l, left_n) +
+                            term_cost(ctx, r, right_n) -
+                            term_cost(ctx, l - 1, left_n) -
+                            term_cost(ctx, r + 1, right_n);
+                }
+                else
+                {
+                    gain += term_cost(ctx, l, left_n) +
+                            term_cost(ctx, r, right_n) -
+                            term_cost(ctx, l + 1, left_n) -
+                            term_cost(ctx, r - 1, right_n);
+                }
+            }
+            ctx->gains[i].gain = gain;
+            ctx->gains[i].document = order[i];
+        }
+
+        /* 从收益最大的文档开始，成对地交换两半中的文档 */
+        qsort(ctx->gains, left_n, sizeof(reorder_gain), compare_gains);
+        qsort(ctx->gains + left_n, right_n, sizeof(reorder_gain),
+              compare_gains);
+        for (i = 0; i < left_n &&
+                    ctx->gains[i].gain + ctx->gains[left_n + i].gain > 0; i++)
+        {
+            int document = ctx->gains[i].document;
+            ctx->gains[i].document = ctx->gains[left_n + i].document;
+            ctx->gains[left_n + i].document = document;
+            swaps++;
+        }
+        for (i = 0; i < n; i++) { order[i] = ctx->gains[i].document; }
+        if (!swaps) { break; }
+    }
+    bisect_documents(ctx, order, left_n);
+    bisect_documents(ctx, order + left_n, right_n);
+}
+
+/**
+ * 用递归图二分计算文档的新的编号
+ * 新的编号是1到documents_count的排列，文档的编号必须是从1开始的连续的整数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] documents_count 文档数
+ * @param[out] document_ids_map 各个文档的新的编号。下标为原有的文档编号-1
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+reorder_documents(const wiser_env *env, int documents_count,
+                  int *document_ids_map)
+{
+    int i, rc = -1, *order = NULL;
+    reorder_context ctx;
+
+    memset(&ctx, 0, sizeof(reorder_context));
+    ctx.documents_count = documents_count;
+    if (load_forward_index(env, &ctx)) { goto exit; }
+    if (!(order = malloc(sizeof(int) * (documents_count + 1))) ||
+        !(ctx.left_degrees = malloc(sizeof(int) * (ctx.terms_count + 1))) ||
+        !(ctx.right_degrees = malloc(sizeof(int) * (ctx.terms_count + 1))) ||
+        !(ctx.log2_table = malloc(sizeof(double) * (documents_count + 2))) ||
+        !(ctx.gains = malloc(sizeof(reorder_gain) * (documents_count + 1))))
+    {
+        print_error("cannot allocate memory for reordering.");
+        goto exit;
+    }
+    ctx.log2_table[0] = 0;
+    for (i = 1; i < documents_count + 2; i++) { ctx.log2_table[i] = log2(i); }
+
+    /* 从原有的顺序开始二分 */
+    for (i = 0; i < documents_count; i++) { order[i] = i; }
+    bisect_documents(&ctx, order, documents_count);
+    for (i = 0; i < documents_count; i++)
+    {
+        document_ids_map[order[i]] = i + 1;
+    }
+    print_error("documents reordered. (documents: %d, tokens: %d)",
+                documents_count, ctx.terms_count);
+    rc = 0;
+exit:
+    free(order);
+    free(ctx.offsets);
+    free(ctx.terms);
+    free(ctx.left_degrees);
+    free(ctx.right_degrees);
+    free(ctx.log2_table);
+    free(ctx.gains);
+    return rc;
+}
@@ -0,0 +1,9 @@
+#ifndef __REORDER_H__
+#define __REORDER_H__
+
+#include "wiser.h"
+
+int reorder_documents(const wiser_env *env, int documents_count,
+                      int *document_ids_map);
+
+#endif /* __REORDER_H__ */
@@ -6,15 +6,16 @@
 #include "database.h"
 #include "postings.h"
 
-/* 将类型inverted_index_hash/value和postings_list也用于检索 */
-typedef inverted_index_hash query_token_hash;
+/* 将类型inverted_index/inverted_index_value和postings_list也用于检索 */
+typedef inverted_index query_token_index;
 typedef inverted_index_value query_token_value;
 typedef postings_list token_positions_list;
 
 typedef struct
 {
-    token_positions_list *documents; /* 文档编号的序列 */
-    token_positions_list *current;   /* 当前的文档编号 */
+    const query_token_value *token;  /* 从查询中提取出的词元信息 */
+    postings_cursor documents;       /* 文档编号的序列的游标 */
+    token_positions_list *query;     /* 词元在查询中的位置 */
 } doc_search_cursor;
 
 typedef struct
@@ -31,57 +32,198 @@ typedef struct
     UT_hash_handle hh;         /* 用于将该结构体转化为哈希表 */
 } search_results;
 
+/* 按得分排序后的1条检索结果 */
+typedef struct
+{
+    int document_id;           /* 检索出的文档编号 */
+    double score;              /* 检索得分 */
+} ranked_document;
+
+/* 检索结果的累加器。在多次检索之间重复使用
+   通常使用以文档编号为下标的得分数组，文档数很多且查询的选择性很高时改用哈希表 */
+typedef struct _search_accumulator
+{
+    int dense;                 /* 是否使用得分数组 */
+    double *scores;            /* 以文档编号为下标的得分数组 */
+    uint64_t *touched_bits;    /* 表示得分数组中的元素是否已被写入的位图 */
+    int size;                  /* 得分数组的元素数。64的倍数 */
+    int *touched;              /* 已写入得分的文档编号的列表 */
+    int touched_count;         /* 已写入得分的文档数 */
+    int touched_capacity;      /* 文档编号的列表的容量 */
+    search_results *results;   /* 不使用得分数组时的检索结果 */
+} search_accumulator;
+
+/* 文档数不超过该值时，总是使用得分数组 */
+#define DENSE_ACCUMULATOR_MAX_DOCUMENTS (1 << 22)
+/* 文档数超过上述值时，若预计检索出的文档数不足文档总数的1/该值，则使用哈希表 */
+#define DENSE_ACCUMULATOR_MIN_SELECTIVITY 64
+
 /**
- * 比较出现过词元a和词元b的文档数
- * @param[in] a 词元a的数据
- * @param[in] b 词元b的数据
+ * 比较出现过词元a和词元b的文档数。文档数相同时，按照词元编号比较
+ * @param[in] a 词元a的游标
+ * @param[in] b 词元b的游标
  * @return 文档数的大小关系
  */
 static int
-query_token_value_docs_count_desc_sort(query_token_value *a,
-                                       query_token_value *b)
+doc_search_cursor_docs_count_asc_sort(const void *a, const void *b)
 {
-    return b->docs_count - a->docs_count;
+    const query_token_value *ta = ((const doc_search_cursor *) a)->token,
+            *tb = ((const doc_search_cursor *) b)->token;
+    if (ta->docs_count != tb->docs_count)
+    {
+        return (ta->docs_count > tb->docs_count) -
+               (ta->docs_count < tb->docs_count);
+    }
+    return (ta->token_id > tb->token_id) - (ta->token_id < tb->token_id);
 }
 
 /**
- * 根据得分比较两条检索结果
+ * 根据得分比较两条检索结果。得分相同时，文档编号小的排在前面
  * @param[in] a 检索结果a的数据
  * @param[in] b 检索结果b的数据
  * @return 得分的大小关系
  */
 static int
-search_results_score_desc_sort(search_results *a, search_results *b)
+ranked_document_score_desc_sort(const void *a, const void *b)
 {
-    return (b->score > a->score) ? 1 : (b->score < a->score) ? -1 : 0;
+    const ranked_document *ra = (const ranked_document *) a,
+            *rb = (const ranked_document *) b;
+    if (rb->score != ra->score)
+    {
+        return (rb->score > ra->score) ? 1 : -1;
+    }
+    return (ra->document_id > rb->document_id)
+           - (ra->document_id < rb->document_id);
+}
+
+/**
+ * 获取检索结果的累加器。第一次调用时为其分配存储空间
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @return 检索结果的累加器
+ */
+static search_accumulator *
+get_search_accumulator(wiser_env *env)
+{
+    if (!env->search_accumulator &&
+        !(env->search_accumulator = calloc(1, sizeof(search_accumulator))))
+    {
+        print_error("cannot allocate memory for search results.");
+    }
+    return env->search_accumulator;
+}
+
+/**
+ * 清空检索结果的累加器，准备开始新的检索
+ * 只清除上次检索时写入过的元素，得分数组本身会被保留
+ * @param[in,out] acc 检索结果的累加器
+ * @param[in] dense 是否使用得分数组
+ */
+static void
+reset_search_accumulator(search_accumulator *acc, int dense)
+{
+    int i;
+    search_results *r, *tmp;
+
+    for (i = 0; i < acc->touched_count; i++)
+    {
+        acc->touched_bits[acc->touched[i] >> 6] = 0;
+    }
+    acc->touched_count = 0;
+    HASH_ITER(hh, acc->results, r, tmp)
+    {
+        HASH_DEL(acc->results, r);
+        free(r);
+    }
+    acc->dense = dense;
+}
+
+/**
+ * 扩大得分数组，使其可以存储指定的文档编号
+ * @param[in,out] acc 检索结果的累加器
+ * @param[in] document_id 文档编号
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+grow_search_accumulator(search_accumulator *acc, int document_id)
+{
+    int new_size;
+    double *new_scores;
+    uint64_t *new_bits;
+
+    for (new_size = acc->size ? acc->size : 1024; new_size <= document_id;
+         new_size *= 2) {}
+    if (!(new_scores = realloc(acc->scores, sizeof(double) * new_size)))
+    {
+        return -1;
+    }
+    acc->scores = new_scores;
+    if (!(new_bits = realloc(acc->touched_bits,
+                             sizeof(uint64_t) * (new_size >> 6))))
+    {
+        return -1;
+    }
+    memset(new_bits + (acc->size >> 6), 0,
+           sizeof(uint64_t) * ((new_size - acc->size) >> 6));
+    acc->touched_bits = new_bits;
+    acc->size = new_size;
+    return 0;
 }
 
 /**
  * 将文档添加到检索结果中
- * @param[in] results 指向检索结果的指针
+ * @param[in,out] acc 检索结果的累加器
  * @param[in] document_id 要添加的文档的编号
  * @param[in] score 得分
  */
 static void
-add_search_result(search_results **results, const int document_id,
+add_search_result(search_accumulator *acc, const int document_id,
                   const double score)
 {
     search_results *r;
-    if (*results)
-    {
-        HASH_FIND_INT(*results, &document_id, r);
-    }
-    else
+
+    if (acc->dense)
     {
-        r = NULL;
+        uint64_t bit = (uint64_t) 1 << (document_id & 63);
+        if (document_id >= acc->size &&
+            grow_search_accumulator(acc, document_id))
+        {
+            print_error("cannot allocate memory for search results.");
+            return;
+        }
+        if (acc->touched_bits[document_id >> 6] & bit)
+        {
+            acc->scores[document_id] += score;
+            return;
+        }
+        if (acc->touched_count == acc->touched_capacity)
+        {
+            int new_capacity, *new_touched;
+            new_capacity = acc->touched_capacity ? acc->touched_capacity * 2
+                                                 : 256;
+            if (!(new_touched = realloc(acc->touched,
+                                        sizeof(int) * new_capacity)))
+            {
+                print_error("cannot allocate memory for search results.");
+                return;
+            }
+            acc->touched = new_touched;
+            acc->touched_capacity = new_capacity;
+        }
+        acc->touched_bits[document_id >> 6] |= bit;
+        acc->touched[acc->touched_count++] = document_id;
+        acc->scores[document_id] = score;
+        return;
     }
+
+    HASH_FIND_INT(acc->results, &document_id, r);
     if (!r)
     {
         if ((r = malloc(sizeof(search_results))))
         {
             r->document_id = document_id;
             r->score = 0;
-            HASH_ADD_INT(*results, document_id, r);
+            HASH_ADD_INT(acc->results, document_id, r);
         }
     }
     if (r)
@@ -90,41 +232,102 @@ add_search_result(search_results **results, const int document_id,
     }
 }
 
+/**
+ * 从累加器中取出检索结果，并按得分的降序排列
+ * @param[in,out] acc 检索结果的累加器。取出后将被清空
+ * @param[out] results_count 检索结果的条数
+ * @return 检索结果的数组。由调用方释放
+ */
+static ranked_document *
+rank_search_results(search_accumulator *acc, int *results_count)
+{
+    int i, n;
+    ranked_document *ranked;
+
+    n = acc->dense ? acc->touched_count : (int) HASH_COUNT(acc->results);
+    *results_count = 0;
+    if (!n) { return NULL; }
+    if (!(ranked = malloc(sizeof(ranked_document) * n)))
+    {
+        print_error("cannot allocate memory for search results.");
+        reset_search_accumulator(acc, acc->dense);
+        return NULL;
+    }
+    if (acc->dense)
+    {
+        for (i = 0; i < n; i++)
+        {
+            ranked[i].document_id = acc->touched[i];
+            ranked[i].score = acc->scores[acc->touched[i]];
+        }
+    }
+    else
+    {
+        search_results *r;
+        for (i = 0, r = acc->results; r; i++, r = r->hh.next)
+        {
+            ranked[i].document_id = r->document_id;
+            ranked[i].score = r->score;
+        }
+    }
+    reset_search_accumulator(acc, acc->dense);
+    qsort(ranked, n, sizeof(ranked_document),
+          ranked_document_score_desc_sort);
+    *results_count = n;
+    return ranked;
+}
+
+/**
+ * 释放检索结果的累加器
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+void
+free_search_accumulator(wiser_env *env)
+{
+    search_accumulator *acc = env->search_accumulator;
+    if (acc)
+    {
+        reset_search_accumulator(acc, acc->dense);
+        free(acc->scores);
+        free(acc->touched_bits);
+        free(acc->touched);
+        free(acc);
+        env->search_accumulator = NULL;
+    }
+}
+
 /**
  * 进行短语检索
- * @param[in] query_tokens 从查询中提取出的词元信息
  * @param[in] doc_cursors 用于检索文档的游标的集合
+ * @param[in] n_query_tokens 查询中的词元数
  * @return 检索出的短语数
  */
 static int
-search_phrase(const query_token_hash *query_tokens,
-              doc_search_cursor *doc_cursors)
+search_phrase(doc_search_cursor *doc_cursors, const int n_query_tokens)
 {
-    int n_positions = 0;
-    const query_token_value *qt;
+    int i, n_positions = 0;
     phrase_search_cursor *cursors;
 
     /* 获取查询中词元的总数 */
-    for (qt = query_tokens; qt; qt = qt->hh.next)
+    for (i = 0; i < n_query_tokens; i++)
     {
-        n_positions += qt->positions_count;
+        n_positions += doc_cursors[i].token->positions_count;
     }
 
     if ((cursors = (phrase_search_cursor *) malloc(sizeof(
                                                            phrase_search_cursor) * n_positions)))
     {
-        int i, phrase_count = 0;
+        int phrase_count = 0;
         phrase_search_cursor *cur;
         /* 初始化游标 */
-        for (i = 0, cur = cursors, qt = query_tokens; qt;
-             i++, qt = qt->hh.next)
+        for (i = 0, cur = cursors; i < n_query_tokens; i++)
         {
             int *pos = NULL;
-            while ((pos = (int *) utarray_next(qt->postings_list->positions,
+            while ((pos = (int *) utarray_next(doc_cursors[i].query->positions,
                                                pos)))
             {
                 cur->base = *pos;
-                cur->positions = doc_cursors[i].current->positions;
+                cur->positions = doc_cursors[i].documents.current->positions;
                 cur->current = (int *) utarray_front(cur->positions);
                 cur++;
             }
@@ -177,28 +380,22 @@ search_phrase(const query_token_hash *query_tokens,
 
 /**
  * 用TF-IDF计算得分
- * @param[in] query_tokens 查询
  * @param[in] doc_cursors 用于文档检索的游标的集合
  * @param[in] n_query_tokens 查询中的词元数
  * @param[in] indexed_count 建立过索引的文档总数
  * @return 得分
  */
 static double
-calc_tf_idf(
-        const query_token_hash *query_tokens,
-        doc_search_cursor *doc_cursors, const int n_query_tokens,
-        const int indexed_count)
+calc_tf_idf(doc_search_cursor *doc_cursors, const int n_query_tokens,
+            const int indexed_count)
 {
     int i;
-    const query_token_value *qt;
     doc_search_cursor *dcur;
     double score = 0;
-    for (qt = query_tokens, dcur = doc_cursors, i = 0;
-         i < n_query_tokens;
-         qt = qt->hh.next, dcur++, i++)
+    for (dcur = doc_cursors, i = 0; i < n_query_tokens; dcur++, i++)
     {
-        double idf = log2((double) indexed_count / qt->docs_count);
-        score += (double) dcur->current->positions_count * idf;
+        double idf = log2((double) indexed_count / dcur->token->docs_count);
+        score += (double) dcur->documents.current->positions_count * idf;
     }
     return score;
 }
@@ -216,162 +413,177 @@ free_token_positions_list(token_positions_list *list)
 /**
  * 检索文档
  * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in,out] results 检索结果
+ * @param[in,out] acc 检索结果的累加器
  * @param[in] tokens 从查询中提取出的词元信息
  */
 void
-search_docs(wiser_env *env, search_results **results,
-            query_token_hash *tokens)
+search_docs(wiser_env *env, search_accumulator *acc,
+            query_token_index *tokens)
 {
     int n_tokens;
     doc_search_cursor *cursors;
 
     if (!tokens) { return; }
 
-    /* 按照文档频率的升序对tokens排序 */
-    HASH_SORT(tokens, query_token_value_docs_count_desc_sort);
-
     /* 初始化 */
-    n_tokens = HASH_COUNT(tokens);
+    n_tokens = tokens->entries_count;
     if (n_tokens &&
         (cursors = (doc_search_cursor *) calloc(
                 sizeof(doc_search_cursor), n_tokens)))
     {
         int i;
         doc_search_cursor *cur;
-        query_token_value *token;
-        for (i = 0, token = tokens; token; i++, token = token->hh.next)
+        const query_token_value *token;
+        for (i = 0, token = inverted_index_next(tokens, NULL); token;
+             i++, token = inverted_index_next(tokens, token))
+        {
+            cursors[i].token = token;
+        }
+        /* 按照文档频率的升序对tokens排序，由文档最少的词元驱动求交集 */
+        qsort(cursors, n_tokens, sizeof(doc_search_cursor),
+              doc_search_cursor_docs_count_asc_sort);
+        /* 检索出的文档数不会超过出现过各词元的文档数中的最小值，即首个词元的文档数 */
+        reset_search_accumulator(
+                acc,
+                acc->size > env->indexed_count ||
+                env->indexed_count <= DENSE_ACCUMULATOR_MAX_DOCUMENTS ||
+                (double) cursors[0].token->docs_count
+                * DENSE_ACCUMULATOR_MIN_SELECTIVITY >= env->indexed_count);
+        for (i = 0; i < n_tokens; i++)
         {
+            token = cursors[i].token;
+            if (get_buffered_postings(tokens, token, &cursors[i].query, NULL))
+            {
+                goto exit;
+            }
             if (!token->token_id)
             {
                 /* 当前的token在构建索引的过程中从未出现过 */
                 goto exit;
             }
-            if (fetch_postings(env, token->token_id,
-                               &cursors[i].documents, NULL))
+            if (open_postings_cursor(env, token->token_id,
+                                     &cursors[i].documents))
             {
                 print_error("decode postings error!: %d\n", token->token_id);
                 goto exit;
             }
-            if (!cursors[i].documents)
+            if (!cursors[i].documents.current)
             {
                 /* 虽然当前的token存在，但是由于更新或删除导致其倒排列表为空 */
                 goto exit;
             }
-            cursors[i].current = cursors[i].documents;
         }
-        while (cursors[0].current)
+        while (cursors[0].documents.current)
         {
             int doc_id, next_doc_id = 0;
             /* 将拥有文档最少的词元称作A */
-            doc_id = cursors[0].current->document_id;
+            doc_id = cursors[0].documents.current->document_id;
             /* 对于除词元A以外的词元，不断获取其下一个document_id，直到当前的document_id不小于词元A的document_id为止 */
             for (cur = cursors + 1, i = 1; i < n_tokens; cur++, i++)
             {
-                while (cur->current && cur->current->document_id < doc_id)
-                {
-                    cur->current = cur->current->next;
-                }
-                if (!cur->current) { goto exit; }
+                if (postings_cursor_seek(&cur->documents, doc_id)) { goto exit; }
+                if (!cur->documents.current) { goto exit; }
                 /* 对于除词元A以外的词元，如果其document_id不等于词元A的document_id，*/
                 /* 那么就将这个document_id设定为next_doc_id */
-                if (cur->current->document_id != doc_id)
+                if (cur->documents.current->document_id != doc_id)
                 {
-                    next_doc_id = cur->current->document_id;
+                    next_doc_id = cur->documents.current->document_id;
                     break;
                 }
             }
             if (next_doc_id > 0)
             {
                 /* 不断获取A的下一个document_id，直到其当前的document_id不小于next_doc_id为止 */
-                while (cursors[0].current
-                       && cursors[0].current->document_id < next_doc_id)
+                if (postings_cursor_seek(&cursors[0].documents, next_doc_id))
                 {
-                    cursors[0].current = cursors[0].current->next;
+                    goto exit;
                 }
             }
             else
             {
                 int phrase_count = -1;
+                /* 只有所有词元都出现在该文档中时，才需要其位置信息 */
+                for (i = 0; i < n_tokens; i++)
+                {
+                    if (postings_cursor_load_positions(&cursors[i].documents))
+                    {
+                        goto exit;
+                    }
+                }
                 if (env->enable_phrase_search)
                 {
-                    phrase_count = search_phrase(tokens, cursors);
+                    phrase_count = search_phrase(cursors, n_tokens);
                 }
                 if (phrase_count)
                 {
-                    double score = calc_tf_idf(tokens, cursors, n_tokens,
+                    double score = calc_tf_idf(cursors, n_tokens,
                                                env->indexed_count);
-                    add_search_result(results, doc_id, score);
+                    add_search_result(acc, doc_id, score);
                 }
-                cursors[0].current = cursors[0].current->next;
+                if (postings_cursor_next(&cursors[0].documents)) { goto exit; }
             }
         }
         exit:
         for (i = 0; i < n_tokens; i++)
         {
-            if (cursors[i].documents)
+            close_postings_cursor(&cursors[i].documents);
+            if (cursors[i].query)
             {
-                free_token_positions_list(cursors[i].documents);
+                free_token_positions_list(cursors[i].query);
             }
         }
         free(cursors);
     }
     free_inverted_index(tokens);
-
-    HASH_SORT(*results, search_results_score_desc_sort);
 }
 
 /**
  * 从查询字符串中提取出词元的信息
  * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in] text 查询字符串
- * @param[in] text_len 查询字符串的长度
+ * @param[in] text 查询字符串（UTF-8）
+ * @param[in] text_size 查询字符串的字节数
  * @param[in] n N-gram中N的取值
- * @param[in,out] query_tokens 按词元编号存储位置信息序列的关联数组
- *                             若传入的是指向NULL的指针，则新建一个关联数组
+ * @param[in,out] query_tokens 按词元编号存储位置信息序列的倒排索引
+ *                             若传入的是指向NULL的指针，则新建一个倒排索引
  * @retval 0 成功
  * @retval -1 失败
  */
 int
 split_query_to_tokens(wiser_env *env,
-                      const UTF32Char *text,
-                      const unsigned int text_len,
-                      const int n, query_token_hash **query_tokens)
+                      const char *text,
+                      const unsigned int text_size,
+                      const int n, query_token_index **query_tokens)
 {
     return text_to_postings_lists(env,
                                   0, /* 将document_id设为0 */
-                                  text, text_len, n,
-                                  (inverted_index_hash **) query_tokens);
+                                  text, text_size, n, query_tokens);
 }
 
 /**
  * 打印检索结果
  * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in] results 检索结果
+ * @param[in] results 按得分排序后的检索结果
+ * @param[in] results_count 检索结果的条数
  */
 void
-print_search_results(wiser_env *env, search_results *results)
+print_search_results(wiser_env *env, const ranked_document *results,
+                     int results_count)
 {
-    int num_search_results;
+    int i;
 
     if (!results) { return; }
-    num_search_results = HASH_COUNT(results);
 
-    while (results)
+    for (i = 0; i < results_count; i++)
     {
         int title_len;
         const char *title;
-        search_results *r;
 
-        r = results;
-        HASH_DEL(results, r);
-        db_get_document_title(env, r->document_id, &title, &title_len);
+        db_get_document_title(env, results[i].document_id, &title, &title_len);
         printf("document_id: %d title: %.*s score: %lf\n",
-               r->document_id, title_len, title, r->score);
-        free(r);
+               results[i].document_id, title_len, title, results[i].score);
     }
 
-    printf("Total %u documents are found!\n", num_search_results);
+    printf("Total %u documents are found!\n", results_count);
 }
 
 /**
@@ -382,27 +594,30 @@ print_search_results(wiser_env *env, search_results *results)
 void
 search(wiser_env *env, const char *query)
 {
-    int query32_len;
-    UTF32Char *query32;
+    int query_len;
+    unsigned int query_size = strlen(query);
 
-    if (!utf8toutf32(query, strlen(query), &query32, &query32_len))
+    /* 只计算查询的长度（字符数），不进行转换 */
+    if (!utf8toutf32(query, query_size, NULL, &query_len))
     {
-        search_results *results = NULL;
+        int results_count = 0;
+        ranked_document *results = NULL;
+        search_accumulator *acc;
 
-        if (query32_len < env->token_len)
+        if (query_len < env->token_len)
         {
             print_error("too short query.");
         }
-        else
+        else if ((acc = get_search_accumulator(env)))
         {
-            query_token_hash *query_tokens = NULL;
+            query_token_index *query_tokens = NULL;
             split_query_to_tokens(
-                    env, query32, query32_len, env->token_len, &query_tokens);
-            search_docs(env, &results, query_tokens);
+                    env, query, query_size, env->token_len, &query_tokens);
+            search_docs(env, acc, query_tokens);
+            results = rank_search_results(acc, &results_count);
         }
 
-        print_search_results(env, results);
-
-        free(query32);
+        print_search_results(env, results, results_count);
+        free(results);
     }
 }
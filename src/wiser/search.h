@@ -5,4 +5,6 @@
 
 void search(wiser_env *env, const char *query);
 
+void free_search_accumulator(wiser_env *env);
+
 #endif /* __SEARCH_H__ */
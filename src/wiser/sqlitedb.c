@@ -0,0 +1,1229 @@
+#include <string.h>
+#include <sqlite3.h>
+
+#include "util.h"
+#include "database.h"
+
+/* 使用sqlite3的存储后端的实例 */
+typedef struct
+{
+    sqlite3 *db; /* sqlite3的实例 */
+    /* sqlite3的准备语句 */
+    sqlite3_stmt *get_document_id_st;
+    sqlite3_stmt *get_document_title_st;
+    sqlite3_stmt *insert_document_st;
+    sqlite3_stmt *update_document_st;
+    sqlite3_stmt *get_token_id_st;
+    sqlite3_stmt *get_token_st;
+    sqlite3_stmt *get_tokens_st;
+    sqlite3_stmt *get_max_token_id_st;
+    sqlite3_stmt *store_token_st;
+    sqlite3_stmt *update_token_docs_count_st;
+    sqlite3_stmt *get_postings_st;
+    sqlite3_stmt *get_postings_chunk_st;
+    sqlite3_stmt *insert_postings_st;
+    sqlite3_stmt *get_segment_postings_st;
+    sqlite3_stmt *insert_segment_st;
+    sqlite3_stmt *get_segments_st;
+    sqlite3_stmt *delete_segments_st;
+    sqlite3_stmt *delete_segment_postings_st;
+    sqlite3_stmt *get_settings_st;
+    sqlite3_stmt *replace_settings_st;
+    sqlite3_stmt *get_document_count_st;
+    sqlite3_stmt *begin_st;
+    sqlite3_stmt *commit_st;
+    sqlite3_stmt *rollback_st;
+} sqlite_db;
+
+/* 数据库的表结构的版本。表结构发生了不兼容的变更时增加该值 */
+#define SQLITEDB_SCHEMA_VERSION "2"
+
+/* 创建数据库时执行的SQL语句 */
+static const char *const sqlitedb_schema[] = {
+        "CREATE TABLE settings ("
+                "  key   TEXT PRIMARY KEY,"
+                "  value TEXT"
+                ");",
+        "CREATE TABLE documents ("
+                "  id      INTEGER PRIMARY KEY," /* auto increment */
+                "  title   TEXT NOT NULL,"
+                "  body    TEXT NOT NULL"
+                ");",
+        "CREATE TABLE tokens ("
+                "  id         INTEGER PRIMARY KEY,"
+                "  token      TEXT NOT NULL,"
+                "  docs_count INT NOT NULL"
+                ");",
+        /* 每次清空缓冲区时都会生成1个段（Segment）。level表示该段经过了几次合并 */
+        "CREATE TABLE segments ("
+                "  id    INTEGER PRIMARY KEY,"
+                "  level INT NOT NULL"
+                ");",
+        /* 每个段中每个词元的倒排列表。倒排列表按文档编号被分割成多个块（Chunk）存储 */
+        "CREATE TABLE postings ("
+                "  token_id          INT NOT NULL,"
+                "  first_document_id INT NOT NULL,"
+                "  last_document_id  INT NOT NULL,"
+                "  segment           INT NOT NULL,"
+                "  docs_count        INT NOT NULL,"
+                "  postings          BLOB NOT NULL,"
+                "  PRIMARY KEY (token_id, first_document_id, segment)"
+                ");",
+        "CREATE INDEX postings_segment_index ON postings(segment);",
+        "CREATE UNIQUE INDEX token_index ON tokens(token);",
+        "CREATE UNIQUE INDEX title_index ON documents(title);",
+        "INSERT INTO settings (key, value)"
+                " VALUES ('schema_version', '" SQLITEDB_SCHEMA_VERSION "');",
+        NULL
+};
+
+/**
+ * 在空的数据库中创建表，并记录表结构的版本
+ * @param[in] db sqlite3的实例
+ * @return sqlite3的错误代码
+ * @retval 0 成功
+ */
+static int
+create_schema(sqlite3 *db)
+{
+    int rc;
+    char *errmsg = NULL;
+    const char *const *sql;
+
+    if ((rc = sqlite3_exec(db, "BEGIN;", NULL, NULL, &errmsg)))
+    {
+        print_error("cannot create database. (%s)", errmsg);
+        sqlite3_free(errmsg);
+        return rc;
+    }
+    for (sql = sqlitedb_schema; *sql; sql++)
+    {
+        if ((rc = sqlite3_exec(db, *sql, NULL, NULL, &errmsg)))
+        {
+            print_error("cannot create database. (%s)", errmsg);
+            sqlite3_free(errmsg);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return rc;
+        }
+    }
+    if ((rc = sqlite3_exec(db, "COMMIT;", NULL, NULL, &errmsg)))
+    {
+        print_error("cannot create database. (%s)", errmsg);
+        sqlite3_free(errmsg);
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    return rc;
+}
+
+/**
+ * 为新的数据库创建表，或者检查已有的数据库的表结构的版本
+ * 旧版本的数据库中倒排列表的存储方式不同，无法读取，因此不打开它
+ * @param[in] db sqlite3的实例
+ * @return sqlite3的错误代码
+ * @retval 0 成功
+ */
+static int
+check_schema(sqlite3 *db)
+{
+    int rc, tables_count = 0;
+    sqlite3_stmt *st = NULL;
+    const char *version = NULL;
+
+    if ((rc = sqlite3_prepare(db, "SELECT COUNT(*) FROM sqlite_master;",
+                              -1, &st, NULL)))
+    {
+        print_error("cannot open database. (%s)", sqlite3_errmsg(db));
+        return rc;
+    }
+    if (sqlite3_step(st) == SQLITE_ROW)
+    {
+        tables_count = sqlite3_column_int(st, 0);
+    }
+    sqlite3_finalize(st);
+    if (!tables_count) { return create_schema(db); }
+
+    /* 不存在settings表或其中没有记录版本时，视为旧版本的数据库 */
+    if (!sqlite3_prepare(db, "SELECT value FROM settings"
+                                     " WHERE key = 'schema_version';",
+                         -1, &st, NULL) &&
+        sqlite3_step(st) == SQLITE_ROW)
+    {
+        version = (const char *) sqlite3_column_text(st, 0);
+    }
+    if (!version || strcmp(version, SQLITEDB_SCHEMA_VERSION))
+    {
+        print_error("unsupported database schema version(%s), expected %s. "
+                            "rebuild the index with this version of wiser.",
+                    version ? version : "1", SQLITEDB_SCHEMA_VERSION);
+        rc = SQLITE_ERROR;
+    }
+    sqlite3_finalize(st);
+    return rc;
+}
+
+/**
+ * 创建准备语句。之前的语句失败时什么也不做
+ * @param[in] s 使用sqlite3的存储后端的实例
+ * @param[in] sql SQL语句
+ * @param[out] st 创建的准备语句
+ * @param[in,out] rc sqlite3的错误代码
+ */
+static void
+prepare_statement(sqlite_db *s, const char *sql, sqlite3_stmt **st, int *rc)
+{
+    if (*rc) { return; }
+    if ((*rc = sqlite3_prepare(s->db, sql, -1, st, NULL)))
+    {
+        print_error("cannot prepare statement. (%s)", sqlite3_errmsg(s->db));
+    }
+}
+
+/**
+ * 关闭数据库
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static void
+sqlitedb_fin(wiser_env *env)
+{
+    sqlite_db *s = env->db;
+    sqlite3_finalize(s->get_document_id_st);
+    sqlite3_finalize(s->get_document_title_st);
+    sqlite3_finalize(s->insert_document_st);
+    sqlite3_finalize(s->update_document_st);
+    sqlite3_finalize(s->get_token_id_st);
+    sqlite3_finalize(s->get_token_st);
+    sqlite3_finalize(s->get_tokens_st);
+    sqlite3_finalize(s->get_max_token_id_st);
+    sqlite3_finalize(s->store_token_st);
+    sqlite3_finalize(s->update_token_docs_count_st);
+    sqlite3_finalize(s->get_postings_st);
+    sqlite3_finalize(s->get_postings_chunk_st);
+    sqlite3_finalize(s->insert_postings_st);
+    sqlite3_finalize(s->get_segment_postings_st);
+    sqlite3_finalize(s->insert_segment_st);
+    sqlite3_finalize(s->get_segments_st);
+    sqlite3_finalize(s->delete_segments_st);
+    sqlite3_finalize(s->delete_segment_postings_st);
+    sqlite3_finalize(s->get_settings_st);
+    sqlite3_finalize(s->replace_settings_st);
+    sqlite3_finalize(s->get_document_count_st);
+    sqlite3_finalize(s->begin_st);
+    sqlite3_finalize(s->commit_st);
+    sqlite3_finalize(s->rollback_st);
+    sqlite3_close(s->db);
+    free(s);
+    env->db = NULL;
+}
+
+/**
+ * 初始化数据库
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] db_path 待初始化的数据库文件的名字
+ * @return sqlite3的错误代码
+ * @retval 0 成功
+ */
+static int
+sqlitedb_init(wiser_env *env, const char *db_path)
+{
+    int rc;
+    sqlite_db *s;
+
+    if (!(s = calloc(1, sizeof(sqlite_db))))
+    {
+        print_error("cannot allocate memory for database.");
+        return SQLITE_NOMEM;
+    }
+    if ((rc = sqlite3_open(db_path, &s->db)))
+    {
+        print_error("cannot open databases.");
+        sqlite3_close(s->db);
+        free(s);
+        return rc;
+    }
+    env->db = s;
+
+    rc = check_schema(s->db);
+    prepare_statement(s,
+                      "SELECT id FROM documents WHERE title = ?;",
+                      &s->get_document_id_st, &rc);
+    prepare_statement(s,
+                      "SELECT title FROM documents WHERE id = ?;",
+                      &s->get_document_title_st, &rc);
+    prepare_statement(s,
+                      "INSERT INTO documents (title, body) VALUES (?, ?);",
+                      &s->insert_document_st, &rc);
+    prepare_statement(s,
+                      "UPDATE documents set body = ? WHERE id = ?;",
+                      &s->update_document_st, &rc);
+    prepare_statement(s,
+                      "SELECT id, docs_count FROM tokens WHERE token = ?;",
+                      &s->get_token_id_st, &rc);
+    prepare_statement(s,
+                      "SELECT token FROM tokens WHERE id = ?;",
+                      &s->get_token_st, &rc);
+    prepare_statement(s,
+                      "SELECT id, token, docs_count FROM tokens ORDER BY token;",
+                      &s->get_tokens_st, &rc);
+    prepare_statement(s,
+                      "SELECT MAX(id) FROM tokens;",
+                      &s->get_max_token_id_st, &rc);
+    prepare_statement(s,
+                      "INSERT OR IGNORE INTO tokens (token, docs_count)"
+                              " VALUES (?, 0);",
+                      &s->store_token_st, &rc);
+    prepare_statement(s,
+                      "UPDATE tokens SET docs_count = docs_count + ? WHERE id = ?;",
+                      &s->update_token_docs_count_st, &rc);
+    prepare_statement(s,
+                      "SELECT first_document_id, last_document_id,"
+                              " docs_count, postings FROM postings"
+                              " WHERE token_id = ? ORDER BY first_document_id;",
+                      &s->get_postings_st, &rc);
+    prepare_statement(s,
+                      "SELECT first_document_id, last_document_id,"
+                              " docs_count, rowid FROM postings"
+                              " WHERE token_id = ?1 AND first_document_id > ?2"
+                              " AND first_document_id >= IFNULL("
+                              "  (SELECT MAX(first_document_id) FROM postings"
+                              "   WHERE token_id = ?1 AND first_document_id <= ?3),"
+                              "  0)"
+                              " AND last_document_id >= ?3"
+                              " ORDER BY first_document_id LIMIT 1;",
+                      &s->get_postings_chunk_st, &rc);
+    prepare_statement(s,
+                      "INSERT INTO postings (token_id, first_document_id,"
+                              " last_document_id, segment, docs_count, postings)"
+                              " VALUES (?, ?, ?, ?, ?, ?);",
+                      &s->insert_postings_st, &rc);
+    prepare_statement(s,
+                      "SELECT token_id, first_document_id, last_document_id,"
+                              " docs_count, postings FROM postings"
+                              " WHERE segment BETWEEN ? AND ?"
+                              " ORDER BY token_id, first_document_id;",
+                      &s->get_segment_postings_st, &rc);
+    prepare_statement(s,
+                      "INSERT INTO segments (level) VALUES (?);",
+                      &s->insert_segment_st, &rc);
+    prepare_statement(s,
+                      "SELECT COUNT(*), MIN(id), MAX(id) FROM segments"
+                              " WHERE level = ?;",
+                      &s->get_segments_st, &rc);
+    prepare_statement(s,
+                      "DELETE FROM segments WHERE id BETWEEN ? AND ?;",
+                      &s->delete_segments_st, &rc);
+    prepare_statement(s,
+                      "DELETE FROM postings WHERE segment BETWEEN ? AND ?;",
+                      &s->delete_segment_postings_st, &rc);
+    prepare_statement(s,
+                      "SELECT value FROM settings WHERE key = ?;",
+                      &s->get_settings_st, &rc);
+    prepare_statement(s,
+                      "INSERT OR REPLACE INTO settings (key, value) VALUES (?, ?);",
+                      &s->replace_settings_st, &rc);
+    prepare_statement(s,
+                      "SELECT COUNT(*) FROM documents;",
+                      &s->get_document_count_st, &rc);
+    prepare_statement(s,
+                      "BEGIN;",
+                      &s->begin_st, &rc);
+    prepare_statement(s,
+                      "COMMIT;",
+                      &s->commit_st, &rc);
+    prepare_statement(s,
+                      "ROLLBACK;",
+                      &s->rollback_st, &rc);
+    if (rc) { sqlitedb_fin(env); }
+    return rc;
+}
+
+/**
+ * 根据指定的文档标题获取文档编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] title 文档标题
+ * @param[in] title_size 文档标题的字节数
+ * @return 文档编号
+ */
+static int
+sqlitedb_get_document_id(const wiser_env *env,
+                         const char *title, unsigned int title_size)
+{
+    sqlite_db *s = env->db;
+    int rc;
+    sqlite3_reset(s->get_document_id_st);
+    sqlite3_bind_text(s->get_document_id_st, 1,
+                      title, title_size, SQLITE_STATIC);
+    rc = sqlite3_step(s->get_document_id_st);
+    if (rc == SQLITE_ROW)
+    {
+        return sqlite3_column_int(s->get_document_id_st, 0);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/**
+ * 根据指定的文档编号获取文档标题
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] document_id 文档编号
+ * @param[out] title 文档标题
+ * @param[out] title_size 文档标题的字节数
+ */
+static int
+sqlitedb_get_document_title(const wiser_env *env, int document_id,
+                            const char **title, int *title_size)
+{
+    sqlite_db *s = env->db;
+    int rc;
+
+    sqlite3_reset(s->get_document_title_st);
+    sqlite3_bind_int(s->get_document_title_st, 1, document_id);
+
+    rc = sqlite3_step(s->get_document_title_st);
+    if (rc == SQLITE_ROW)
+    {
+        if (title)
+        {
+            *title = (const char *) sqlite3_column_text(s->get_document_title_st,
+                                                        0);
+        }
+        if (title_size)
+        {
+            *title_size = (int) sqlite3_column_bytes(s->get_document_title_st,
+                                                     0);
+        }
+    }
+    return 0;
+}
+
+/**
+ * 将文档添加到documents表中
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] title 文档标题
+ * @param[in] title_size 文档标题的字节数
+ * @param[in] body 文档正文
+ * @param[in] body_size 文档正文的字节数
+ */
+static int
+sqlitedb_add_document(const wiser_env *env,
+                      const char *title, unsigned int title_size,
+                      const char *body, unsigned int body_size)
+{
+    sqlite_db *s = env->db;
+    sqlite3_stmt *st;
+    int rc, document_id;
+
+    if ((document_id = sqlitedb_get_document_id(env, title, title_size)))
+    {
+        st = s->update_document_st;
+        sqlite3_reset(st);
+        sqlite3_bind_text(st, 1, body, body_size, SQLITE_STATIC);
+        sqlite3_bind_int(st, 2, document_id);
+    }
+    else
+    {
+        st = s->insert_document_st;
+        sqlite3_reset(st);
+        sqlite3_bind_text(st, 1, title, title_size, SQLITE_STATIC);
+        sqlite3_bind_text(st, 2, body, body_size, SQLITE_STATIC);
+    }
+    query:
+    rc = sqlite3_step(st);
+    switch (rc)
+    {
+        case SQLITE_BUSY:
+            goto query;
+        case SQLITE_ERROR:
+            print_error("ERROR: %s", sqlite3_errmsg(s->db));
+            break;
+        case SQLITE_MISUSE:
+            print_error("MISUSE: %s", sqlite3_errmsg(s->db));
+            break;
+    }
+    return rc;
+}
+
+/**
+ * 按照指定的映射改变所有文档的编号
+ * 为了避免新旧编号的冲突，先将所有编号变为负数，再逐个设定新的编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] document_ids_map 各个文档的新的编号。下标为原有的文档编号-1
+ * @param[in] documents_count 文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+sqlitedb_renumber_documents(const wiser_env *env,
+                            const int *document_ids_map, int documents_count)
+{
+    sqlite_db *s = env->db;
+    sqlite3_stmt *st = NULL;
+    char *errmsg = NULL;
+    int i, rc = -1;
+
+    if (sqlite3_exec(s->db, "UPDATE documents SET id = -id;",
+                     NULL, NULL, &errmsg) != SQLITE_OK)
+    {
+        print_error("cannot renumber documents. (%s)", errmsg);
+        sqlite3_free(errmsg);
+        return -1;
+    }
+    if (sqlite3_prepare(s->db, "UPDATE documents SET id = ? WHERE id = ?;",
+                        -1, &st, NULL) != SQLITE_OK)
+    {
+        print_error("cannot renumber documents. (%s)", sqlite3_errmsg(s->db));
+        return -1;
+    }
+    for (i = 0; i < documents_count; i++)
+    {
+        sqlite3_reset(st);
+        sqlite3_bind_int(st, 1, document_ids_map[i]);
+        sqlite3_bind_int(st, 2, -(i + 1));
+        if (sqlite3_step(st) != SQLITE_DONE)
+        {
+            print_error("cannot renumber documents. (%s)",
+                        sqlite3_errmsg(s->db));
+            goto exit;
+        }
+    }
+    rc = 0;
+exit:
+    sqlite3_finalize(st);
+    return rc;
+}
+
+/**
+ * 从tokens表中获取指定词元的编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] str 词元（UTF-8）
+ * @param[in] str_size 词元的字节数
+ * @param[in] insert 当找不到指定词元时，是否要将该词元添加到表中
+ * @param[out] docs_count 出现过指定词元的文档数
+ */
+static int
+sqlitedb_get_token_id(const wiser_env *env,
+                      const char *str, unsigned int str_size, int insert,
+                      int *docs_count)
+{
+    sqlite_db *s = env->db;
+    int rc;
+    if (insert)
+    {
+        sqlite3_reset(s->store_token_st);
+        sqlite3_bind_text(s->store_token_st, 1, str, str_size,
+                          SQLITE_STATIC);
+        rc = sqlite3_step(s->store_token_st);
+    }
+    sqlite3_reset(s->get_token_id_st);
+    sqlite3_bind_text(s->get_token_id_st, 1, str, str_size,
+                      SQLITE_STATIC);
+    rc = sqlite3_step(s->get_token_id_st);
+    if (rc == SQLITE_ROW)
+    {
+        if (docs_count)
+        {
+            *docs_count = sqlite3_column_int(s->get_token_id_st, 1);
+        }
+        return sqlite3_column_int(s->get_token_id_st, 0);
+    }
+    else
+    {
+        if (docs_count)
+        {
+            *docs_count = 0;
+        }
+        return 0;
+    }
+}
+
+/**
+ * 根据词元编号从tokens表获取词元
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[out] token 词元（UTF-8）
+ * @param[out] token_size 词元的字节数
+ */
+static int
+sqlitedb_get_token(const wiser_env *env,
+                   const int token_id,
+                   const char **const token, int *token_size)
+{
+    sqlite_db *s = env->db;
+    int rc;
+    sqlite3_reset(s->get_token_st);
+    sqlite3_bind_int(s->get_token_st, 1, token_id);
+    rc = sqlite3_step(s->get_token_st);
+    if (rc == SQLITE_ROW)
+    {
+        if (token)
+        {
+            *token = (const char *) sqlite3_column_text(s->get_token_st, 0);
+        }
+        if (token_size)
+        {
+            *token_size = (int) sqlite3_column_bytes(s->get_token_st, 0);
+        }
+    }
+    return 0;
+}
+
+/**
+ * 按词元（UTF-8）的字节顺序获取下一个词元
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] token 词元（UTF-8）。已没有词元时为NULL
+ * @param[out] token_size 词元的字节数
+ * @param[out] docs_count 出现过该词元的文档数
+ */
+static int
+sqlitedb_next_token(const wiser_env *env, int *token_id,
+                    const char **token, int *token_size, int *docs_count)
+{
+    sqlite_db *s = env->db;
+    int rc = sqlite3_step(s->get_tokens_st);
+    if (rc == SQLITE_ROW)
+    {
+        *token_id = sqlite3_column_int(s->get_tokens_st, 0);
+        *token = (const char *) sqlite3_column_text(s->get_tokens_st, 1);
+        *token_size = sqlite3_column_bytes(s->get_tokens_st, 1);
+        *docs_count = sqlite3_column_int(s->get_tokens_st, 2);
+        return 0;
+    }
+    *token_id = *token_size = *docs_count = 0;
+    *token = NULL;
+    return rc == SQLITE_DONE ? 0 : rc;
+}
+
+/**
+ * 按词元（UTF-8）的字节顺序获取第一个词元
+ * 其余的词元通过db_next_token获取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] token 词元（UTF-8）。已没有词元时为NULL
+ * @param[out] token_size 词元的字节数
+ * @param[out] docs_count 出现过该词元的文档数
+ */
+static int
+sqlitedb_get_tokens(const wiser_env *env, int *token_id,
+                    const char **token, int *token_size, int *docs_count)
+{
+    sqlite_db *s = env->db;
+    sqlite3_reset(s->get_tokens_st);
+    return sqlitedb_next_token(env, token_id, token, token_size, docs_count);
+}
+
+/**
+ * 获取词元编号的最大值
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @return 词元编号的最大值。没有词元时为0
+ */
+static int
+sqlitedb_get_max_token_id(const wiser_env *env)
+{
+    sqlite_db *s = env->db;
+    int max_token_id = 0;
+
+    sqlite3_reset(s->get_max_token_id_st);
+    if (sqlite3_step(s->get_max_token_id_st) == SQLITE_ROW)
+    {
+        max_token_id = sqlite3_column_int(s->get_max_token_id_st, 0);
+    }
+    sqlite3_reset(s->get_max_token_id_st);
+    return max_token_id;
+}
+
+/**
+ * 执行不返回结果的准备语句
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] st 已绑定了参数的准备语句
+ * @return sqlite3的错误代码
+ */
+static int
+db_exec_st(const wiser_env *env, sqlite3_stmt *st)
+{
+    sqlite_db *s = env->db;
+    int rc;
+    query:
+    rc = sqlite3_step(st);
+
+    switch (rc)
+    {
+        case SQLITE_BUSY:
+            goto query;
+        case SQLITE_ERROR:
+            print_error("ERROR: %s", sqlite3_errmsg(s->db));
+            break;
+        case SQLITE_MISUSE:
+            print_error("MISUSE: %s", sqlite3_errmsg(s->db));
+            break;
+    }
+    return rc;
+}
+
+/**
+ * 增加出现过指定词元的文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] docs_count 新增的文档数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+sqlitedb_add_token_docs_count(const wiser_env *env, int token_id,
+                              int docs_count)
+{
+    sqlite_db *s = env->db;
+    sqlite3_reset(s->update_token_docs_count_st);
+    sqlite3_bind_int(s->update_token_docs_count_st, 1, docs_count);
+    sqlite3_bind_int(s->update_token_docs_count_st, 2, token_id);
+    return db_exec_st(env, s->update_token_docs_count_st) == SQLITE_DONE
+           ? 0 : -1;
+}
+
+/**
+ * 读取倒排列表的查询结果中的下一行
+ * @param[in] st 查询倒排列表的准备语句
+ * @param[in] column 结果中块的最初的文档编号所在的列
+ *                   其后依次是最后的文档编号、文档数和倒排列表
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。没有下一行时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ * @retval 0 成功
+ */
+static int
+db_step_postings(sqlite3_stmt *st, int column,
+                 int *first_document_id, int *last_document_id,
+                 int *docs_count, void **postings, int *postings_size)
+{
+    int rc = sqlite3_step(st);
+    if (rc == SQLITE_ROW)
+    {
+        if (first_document_id)
+        {
+            *first_document_id = sqlite3_column_int(st, column);
+        }
+        if (last_document_id)
+        {
+            *last_document_id = sqlite3_column_int(st, column + 1);
+        }
+        if (docs_count)
+        {
+            *docs_count = sqlite3_column_int(st, column + 2);
+        }
+        if (postings)
+        {
+            *postings = (void *) sqlite3_column_blob(st, column + 3);
+        }
+        if (postings_size)
+        {
+            *postings_size = (int) sqlite3_column_bytes(st, column + 3);
+        }
+        rc = 0;
+    }
+    else
+    {
+        if (first_document_id) { *first_document_id = 0; }
+        if (last_document_id) { *last_document_id = 0; }
+        if (docs_count) { *docs_count = 0; }
+        if (postings) { *postings = NULL; }
+        if (postings_size) { *postings_size = 0; }
+        if (rc == SQLITE_DONE) { rc = 0; } /* no record found */
+    }
+    return rc;
+}
+
+/**
+ * 根据词元编号从数据库中获取倒排列表的第一个块
+ * 其余的块按文档编号的顺序通过db_next_postings获取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。不存在时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+sqlitedb_get_postings(const wiser_env *env, int token_id,
+                      int *first_document_id, int *last_document_id,
+                      int *docs_count, void **postings, int *postings_size)
+{
+    sqlite_db *s = env->db;
+    sqlite3_reset(s->get_postings_st);
+    sqlite3_bind_int(s->get_postings_st, 1, token_id);
+    return db_step_postings(s->get_postings_st, 0,
+                            first_document_id, last_document_id,
+                            docs_count, postings, postings_size);
+}
+
+/**
+ * 从数据库中获取倒排列表的下一个块
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。已没有下一个块时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+sqlitedb_next_postings(const wiser_env *env,
+                       int *first_document_id, int *last_document_id,
+                       int *docs_count, void **postings, int *postings_size)
+{
+    sqlite_db *s = env->db;
+    return db_step_postings(s->get_postings_st, 0,
+                            first_document_id, last_document_id,
+                            docs_count, postings, postings_size);
+}
+
+/**
+ * 打开倒排列表中包含指定文档编号或位于其后的第一个块，以便流式读取
+ * 文档编号在该块之前的块不会被读取。块中的数据通过db_read_postings_chunk读取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] prev_first_document_id 上一个块中最初的文档编号。只获取在其之后的块
+ * @param[in] document_id 文档编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 块中的文档数
+ * @param[in,out] chunk 块的BLOB句柄。非NULL时重新打开该句柄。不存在块时不改变
+ * @param[out] postings_size 块的字节数。不存在块时为0
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+sqlitedb_open_postings_chunk(const wiser_env *env, int token_id,
+                             int prev_first_document_id, int document_id,
+                             int *first_document_id, int *last_document_id,
+                             int *docs_count, void **chunk,
+                             int *postings_size)
+{
+    sqlite_db *s = env->db;
+    sqlite3_blob **blob = (sqlite3_blob **) chunk;
+    int rc;
+    sqlite3_int64 rowid;
+    sqlite3_stmt *st = s->get_postings_chunk_st;
+
+    *first_document_id = *last_document_id = *docs_count = 0;
+    *postings_size = 0;
+    sqlite3_reset(st);
+    sqlite3_bind_int(st, 1, token_id);
+    sqlite3_bind_int(st, 2, prev_first_document_id);
+    sqlite3_bind_int(st, 3, document_id);
+    rc = sqlite3_step(st);
+    if (rc != SQLITE_ROW)
+    {
+        sqlite3_reset(st);
+        return rc == SQLITE_DONE ? 0 : -1;
+    }
+    *first_document_id = sqlite3_column_int(st, 0);
+    *last_document_id = sqlite3_column_int(st, 1);
+    *docs_count = sqlite3_column_int(st, 2);
+    rowid = sqlite3_column_int64(st, 3);
+    sqlite3_reset(st);
+
+    /* 已有句柄时，重新打开它比新建句柄的开销更小 */
+    rc = *blob ? sqlite3_blob_reopen(*blob, rowid)
+               : sqlite3_blob_open(s->db, "main", "postings", "postings",
+                                   rowid, 0, blob);
+    if (rc)
+    {
+        print_error("cannot open postings chunk: %s", sqlite3_errmsg(s->db));
+        if (*blob) { sqlite3_blob_close(*blob); }
+        *blob = NULL;
+        return -1;
+    }
+    *postings_size = sqlite3_blob_bytes(*blob);
+    return 0;
+}
+
+/**
+ * 从打开的块中读取数据
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] chunk 块的BLOB句柄
+ * @param[out] buf 读取出的数据
+ * @param[in] size 读取的字节数
+ * @param[in] offset 读取的起始位置
+ * @retval 0 成功
+ */
+static int
+sqlitedb_read_postings_chunk(const wiser_env *env, void *chunk,
+                             void *buf, int size, int offset)
+{
+    (void) env;
+    return sqlite3_blob_read((sqlite3_blob *) chunk, buf, size, offset);
+}
+
+/**
+ * 关闭块的BLOB句柄
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] chunk 块的BLOB句柄。可以为NULL
+ */
+static void
+sqlitedb_close_postings_chunk(const wiser_env *env, void *chunk)
+{
+    (void) env;
+    if (chunk) { sqlite3_blob_close((sqlite3_blob *) chunk); }
+}
+
+/**
+ * 将1个段中的倒排列表的1个块存储到数据库中
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] first_document_id 块中最初的文档编号
+ * @param[in] last_document_id 块中最后的文档编号
+ * @param[in] segment 段的编号
+ * @param[in] docs_count 块中的文档数
+ * @param[in] postings 待存储的块
+ * @param[in] postings_size 块的字节数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+sqlitedb_insert_postings(const wiser_env *env, int token_id,
+                         int first_document_id, int last_document_id,
+                         int segment, int docs_count,
+                         const void *postings, int postings_size)
+{
+    sqlite_db *s = env->db;
+    sqlite3_reset(s->insert_postings_st);
+    sqlite3_bind_int(s->insert_postings_st, 1, token_id);
+    sqlite3_bind_int(s->insert_postings_st, 2, first_document_id);
+    sqlite3_bind_int(s->insert_postings_st, 3, last_document_id);
+    sqlite3_bind_int(s->insert_postings_st, 4, segment);
+    sqlite3_bind_int(s->insert_postings_st, 5, docs_count);
+    sqlite3_bind_blob(s->insert_postings_st, 6, postings,
+                      (unsigned int) postings_size, SQLITE_STATIC);
+    return db_exec_st(env, s->insert_postings_st) == SQLITE_DONE ? 0 : -1;
+}
+
+/**
+ * 获取编号在指定范围内的段中的下一个倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[out] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。已没有下一个倒排列表时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+sqlitedb_next_segment_postings(const wiser_env *env, int *token_id,
+                               int *first_document_id,
+                               int *last_document_id, int *docs_count,
+                               void **postings, int *postings_size)
+{
+    sqlite_db *s = env->db;
+    int rc = db_step_postings(s->get_segment_postings_st, 1,
+                              first_document_id, last_document_id,
+                              docs_count, postings, postings_size);
+    if (token_id)
+    {
+        *token_id = (!rc && *postings)
+                    ? sqlite3_column_int(s->get_segment_postings_st, 0) : 0;
+    }
+    return rc;
+}
+
+/**
+ * 按词元编号和文档编号的顺序获取编号在指定范围内的段中的第一个块
+ * 其余的倒排列表通过db_next_segment_postings获取
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] min_segment 段的编号的最小值
+ * @param[in] max_segment 段的编号的最大值
+ * @param[out] token_id 词元编号
+ * @param[out] first_document_id 块中最初的文档编号
+ * @param[out] last_document_id 块中最后的文档编号
+ * @param[out] docs_count 倒排列表中的文档数
+ * @param[out] postings 获取到的倒排列表。不存在时为NULL
+ * @param[out] postings_size 获取到的倒排列表的字节数
+ */
+static int
+sqlitedb_get_segment_postings(const wiser_env *env,
+                              int min_segment, int max_segment, int *token_id,
+                              int *first_document_id, int *last_document_id,
+                              int *docs_count, void **postings,
+                              int *postings_size)
+{
+    sqlite_db *s = env->db;
+    sqlite3_reset(s->get_segment_postings_st);
+    sqlite3_bind_int(s->get_segment_postings_st, 1, min_segment);
+    sqlite3_bind_int(s->get_segment_postings_st, 2, max_segment);
+    return sqlitedb_next_segment_postings(env, token_id, first_document_id,
+                                          last_document_id, docs_count,
+                                          postings, postings_size);
+}
+
+/**
+ * 添加新的段
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] level 段的级别。清空缓冲区时生成的段为0，合并后的段为被合并的段的级别加1
+ * @return 新的段的编号
+ * @retval -1 失败
+ */
+static int
+sqlitedb_add_segment(const wiser_env *env, int level)
+{
+    sqlite_db *s = env->db;
+    sqlite3_reset(s->insert_segment_st);
+    sqlite3_bind_int(s->insert_segment_st, 1, level);
+    if (db_exec_st(env, s->insert_segment_st) != SQLITE_DONE)
+    {
+        return -1;
+    }
+    return (int) sqlite3_last_insert_rowid(s->db);
+}
+
+/**
+ * 获取指定级别的段的数量和编号的范围
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] level 段的级别
+ * @param[out] min_segment 段的编号的最小值
+ * @param[out] max_segment 段的编号的最大值
+ * @return 段的数量
+ */
+static int
+sqlitedb_get_segments(const wiser_env *env, int level,
+                      int *min_segment, int *max_segment)
+{
+    sqlite_db *s = env->db;
+    int count = 0;
+
+    sqlite3_reset(s->get_segments_st);
+    sqlite3_bind_int(s->get_segments_st, 1, level);
+    *min_segment = *max_segment = 0;
+    if (sqlite3_step(s->get_segments_st) == SQLITE_ROW)
+    {
+        count = sqlite3_column_int(s->get_segments_st, 0);
+        *min_segment = sqlite3_column_int(s->get_segments_st, 1);
+        *max_segment = sqlite3_column_int(s->get_segments_st, 2);
+    }
+    sqlite3_reset(s->get_segments_st);
+    return count;
+}
+
+/**
+ * 删除编号在指定范围内的段及其中的所有倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] min_segment 段的编号的最小值
+ * @param[in] max_segment 段的编号的最大值
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+sqlitedb_delete_segments(const wiser_env *env,
+                         int min_segment, int max_segment)
+{
+    sqlite_db *s = env->db;
+
+    sqlite3_reset(s->delete_segment_postings_st);
+    sqlite3_bind_int(s->delete_segment_postings_st, 1, min_segment);
+    sqlite3_bind_int(s->delete_segment_postings_st, 2, max_segment);
+    if (db_exec_st(env, s->delete_segment_postings_st) != SQLITE_DONE)
+    {
+        return -1;
+    }
+    sqlite3_reset(s->delete_segments_st);
+    sqlite3_bind_int(s->delete_segments_st, 1, min_segment);
+    sqlite3_bind_int(s->delete_segments_st, 2, max_segment);
+    return db_exec_st(env, s->delete_segments_st) == SQLITE_DONE ? 0 : -1;
+}
+
+/**
+ * 从数据库中获取配置信息
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] key 配置项的名称
+ * @param[in] key_size 配置项名称的字节数
+ * @param[out] value 配置项的取值
+ * @param[out] value_size 配置项取值的字节数
+ * @retval 0 成功。配置项不存在时不改变value和value_size
+ * @retval -1 失败
+ */
+static int
+sqlitedb_get_settings(const wiser_env *env, const char *key, int key_size,
+                      const char **value, int *value_size)
+{
+    sqlite_db *s = env->db;
+    int rc;
+
+    sqlite3_reset(s->get_settings_st);
+    sqlite3_bind_text(s->get_settings_st, 1,
+                      key, key_size, SQLITE_STATIC);
+    rc = sqlite3_step(s->get_settings_st);
+    if (rc == SQLITE_ROW)
+    {
+        if (value)
+        {
+            *value = (const char *) sqlite3_column_text(s->get_settings_st, 0);
+        }
+        if (value_size)
+        {
+            *value_size = (int) sqlite3_column_bytes(s->get_settings_st, 0);
+        }
+    }
+    else if (rc != SQLITE_DONE)
+    {
+        print_error("ERROR: %s", sqlite3_errmsg(s->db));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 更新存储在数据库中的配置信息
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] key 配置项的名称
+ * @param[in] key_size 配置项名称的字节数
+ * @param[in] value 配置项的取值
+ * @param[in] value_size 配置项取值的字节数
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+sqlitedb_replace_settings(const wiser_env *env, const char *key,
+                          int key_size,
+                          const char *value, int value_size)
+{
+    sqlite_db *s = env->db;
+    int rc;
+    sqlite3_reset(s->replace_settings_st);
+    sqlite3_bind_text(s->replace_settings_st, 1,
+                      key, key_size, SQLITE_STATIC);
+    sqlite3_bind_text(s->replace_settings_st, 2,
+                      value, value_size, SQLITE_STATIC);
+    query:
+    rc = sqlite3_step(s->replace_settings_st);
+
+    switch (rc)
+    {
+        case SQLITE_BUSY:
+            goto query;
+        case SQLITE_ERROR:
+            print_error("ERROR: %s", sqlite3_errmsg(s->db));
+            break;
+        case SQLITE_MISUSE:
+            print_error("MISUSE: %s", sqlite3_errmsg(s->db));
+            break;
+    }
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+/**
+ * 获取已添加到数据库中的文档数
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+sqlitedb_get_document_count(const wiser_env *env)
+{
+    sqlite_db *s = env->db;
+    int rc;
+
+    sqlite3_reset(s->get_document_count_st);
+    rc = sqlite3_step(s->get_document_count_st);
+    if (rc == SQLITE_ROW)
+    {
+        return sqlite3_column_int(s->get_document_count_st, 0);
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+/**
+ * 开启事务
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+sqlitedb_begin(const wiser_env *env)
+{
+    sqlite_db *s = env->db;
+    return sqlite3_step(s->begin_st);
+}
+
+/**
+ * 提交事务
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+sqlitedb_commit(const wiser_env *env)
+{
+    sqlite_db *s = env->db;
+    return sqlite3_step(s->commit_st);
+}
+
+/**
+ * 回滚事务
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+static int
+sqlitedb_rollback(const wiser_env *env)
+{
+    sqlite_db *s = env->db;
+    return sqlite3_step(s->rollback_st);
+}
+
+/**
+ * 重建数据库文件，回收未使用的空间。不能在事务中调用
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+sqlitedb_vacuum(const wiser_env *env)
+{
+    sqlite_db *s = env->db;
+    sqlite3_stmt *st = NULL;
+    char *errmsg = NULL;
+
+    /* 存在执行中的语句时无法执行VACUUM，因此先重置所有的语句 */
+    while ((st = sqlite3_next_stmt(s->db, st)))
+    {
+        sqlite3_reset(st);
+    }
+    if (sqlite3_exec(s->db, "VACUUM;", NULL, NULL, &errmsg) != SQLITE_OK)
+    {
+        print_error("cannot vacuum database. (%s)", errmsg);
+        sqlite3_free(errmsg);
+        return -1;
+    }
+    return 0;
+}
+
+/* 使用sqlite3的存储后端的操作表 */
+const db_backend sqlite_backend = {
+        "sqlite",
+        sqlitedb_init,
+        sqlitedb_fin,
+        sqlitedb_get_document_id,
+        sqlitedb_get_document_title,
+        sqlitedb_add_document,
+        sqlitedb_get_document_count,
+        sqlitedb_renumber_documents,
+        sqlitedb_get_token_id,
+        sqlitedb_get_token,
+        sqlitedb_get_tokens,
+        sqlitedb_next_token,
+        sqlitedb_get_max_token_id,
+        sqlitedb_add_token_docs_count,
+        sqlitedb_get_postings,
+        sqlitedb_next_postings,
+        sqlitedb_open_postings_chunk,
+        sqlitedb_read_postings_chunk,
+        sqlitedb_close_postings_chunk,
+        sqlitedb_insert_postings,
+        sqlitedb_get_segment_postings,
+        sqlitedb_next_segment_postings,
+        sqlitedb_add_segment,
+        sqlitedb_get_segments,
+        sqlitedb_delete_segments,
+        sqlitedb_get_settings,
+        sqlitedb_replace_settings,
+        sqlitedb_begin,
+        sqlitedb_commit,
+        sqlitedb_rollback,
+        sqlitedb_vacuum
+};
@@ -0,0 +1,171 @@
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define STREAMVBYTE_SSSE3
+#endif
+
+#include "streamvbyte.h"
+
+/*
+ * Stream-VByte编码
+ * 每个整数用1～4个字节存储，其字节数减1的值（2比特）集中存储在开头的控制字节中，
+ * 每个控制字节对应4个整数。数据部分中的整数按小端序、不加分隔地连续存储。
+ * 解码时根据控制字节查表得到字节的重排方式，每次用1条shuffle指令还原出4个整数
+ */
+
+#ifdef STREAMVBYTE_SSSE3
+/* 各个控制字节对应的4个整数的字节数之和 */
+static uint8_t streamvbyte_lengths[256];
+/* 各个控制字节对应的shuffle掩码。0xFF表示将该字节清零 */
+static uint8_t streamvbyte_shuffles[256][16];
+static pthread_once_t streamvbyte_once = PTHREAD_ONCE_INIT;
+
+/**
+ * 生成控制字节对应的字节数和shuffle掩码的表
+ */
+static void
+init_streamvbyte_tables(void)
+{
+    int c;
+    for (c = 0; c < 256; c++)
+    {
+        int i, j, offset = 0;
+        for (i = 0; i < 4; i++)
+        {
+            int len = ((c >> (i * 2)) & 3) + 1;
+            for (j = 0; j < 4; j++)
+            {
+                streamvbyte_shuffles[c][i * 4 + j] =
+                        j < len ? (uint8_t) (offset + j) : 0xFF;
+            }
+            offset += len;
+        }
+        streamvbyte_lengths[c] = (uint8_t) offset;
+    }
+}
+#endif /* STREAMVBYTE_SSSE3 */
+
+/**
+ * 计算对n个整数进行编码后最多需要多少字节
+ * @param[in] n 整数的个数
+ * @return 字节数
+ */
+int
+streamvbyte_max_size(int n)
+{
+    return (n + 3) / 4 + n * 4;
+}
+
+/**
+ * 用Stream-VByte编码对整数的序列进行编码
+ * @param[in] in 待编码的整数的序列
+ * @param[in] n 整数的个数
+ * @param[out] out 编码后的数据。至少需要streamvbyte_max_size(n)个字节
+ * @return 编码后的字节数
+ */
+int
+streamvbyte_encode(const uint32_t *in, int n, unsigned char *out)
+{
+    int i;
+    unsigned char *control = out, *data = out + (n + 3) / 4;
+
+    memset(control, 0, (n + 3) / 4);
+    for (i = 0; i < n; i++)
+    {
+        uint32_t v = in[i];
+        int j, len;
+
+        len = v < (1U << 8) ? 1 : v < (1U << 16) ? 2 : v < (1U << 24) ? 3 : 4;
+        control[i / 4] |= (unsigned char) ((len - 1) << ((i % 4) * 2));
+        for (j = 0; j < len; j++)
+        {
+            *data++ = (unsigned char) (v >> (j * 8));
+        }
+    }
+    return (int) (data - out);
+}
+
+/**
+ * 逐个整数地对数据部分进行解码
+ * @param[in] control 控制字节
+ * @param[in] data 数据部分
+ * @param[in] start 第1个要解码的整数的序号
+ * @param[in] n 整数的个数
+ * @param[out] out 解码后的整数的序列
+ * @return 解码完毕后数据部分中的读取位置
+ */
+static const unsigned char *
+decode_streamvbyte_scalar(const unsigned char *control,
+                          const unsigned char *data,
+                          int start, int n, uint32_t *out)
+{
+    int i;
+    for (i = start; i < n; i++)
+    {
+        int j, len = ((control[i / 4] >> ((i % 4) * 2)) & 3) + 1;
+        uint32_t v = 0;
+        for (j = 0; j < len; j++)
+        {
+            v |= (uint32_t) *data++ << (j * 8);
+        }
+        out[i] = v;
+    }
+    return data;
+}
+
+#ifdef STREAMVBYTE_SSSE3
+/**
+ * 用SSSE3的shuffle指令，每次对4个整数进行解码
+ * @param[in] control 控制字节
+ * @param[in] data 数据部分。末尾之后必须有STREAMVBYTE_PADDING个字节可读
+ * @param[in] groups 要解码的控制字节的个数
+ * @param[out] out 解码后的整数的序列
+ * @return 解码完毕后数据部分中的读取位置
+ */
+__attribute__((target("ssse3")))
+static const unsigned char *
+decode_streamvbyte_ssse3(const unsigned char *control,
+                         const unsigned char *data,
+                         int groups, uint32_t *out)
+{
+    int i;
+    for (i = 0; i < groups; i++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) data);
+        __m128i shuffle = _mm_loadu_si128(
+                (const __m128i *) streamvbyte_shuffles[control[i]]);
+        _mm_storeu_si128((__m128i *) (out + i * 4),
+                         _mm_shuffle_epi8(v, shuffle));
+        data += streamvbyte_lengths[control[i]];
+    }
+    return data;
+}
+#endif /* STREAMVBYTE_SSSE3 */
+
+/**
+ * 对经过Stream-VByte编码的整数的序列进行解码
+ * CPU支持SSSE3时使用shuffle指令进行解码，否则逐个整数地进行解码
+ * @param[in] in 经过编码的数据。末尾之后必须有STREAMVBYTE_PADDING个字节可读
+ * @param[in] n 整数的个数
+ * @param[out] out 解码后的整数的序列。至少需要n个元素
+ * @return 读取的字节数
+ */
+int
+streamvbyte_decode(const unsigned char *in, int n, uint32_t *out)
+{
+    int start = 0;
+    const unsigned char *control = in, *data = in + (n + 3) / 4;
+
+#ifdef STREAMVBYTE_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        pthread_once(&streamvbyte_once, init_streamvbyte_tables);
+        data = decode_streamvbyte_ssse3(control, data, n / 4, out);
+        start = n / 4 * 4;
+    }
+#endif /* STREAMVBYTE_SSSE3 */
+    data = decode_streamvbyte_scalar(control, data, start, n, out);
+    return (int) (data - in);
+}
@@ -0,0 +1,15 @@
+#ifndef __STREAMVBYTE_H__
+#define __STREAMVBYTE_H__
+
+#include <stdint.h>
+
+/* 解码时，输入数据的末尾之后必须可读的字节数 */
+#define STREAMVBYTE_PADDING 16
+
+int streamvbyte_max_size(int n);
+
+int streamvbyte_encode(const uint32_t *in, int n, unsigned char *out);
+
+int streamvbyte_decode(const unsigned char *in, int n, uint32_t *out);
+
+#endif /* __STREAMVBYTE_H__ */
@@ -0,0 +1,38 @@
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+/* 当前测试用例的名称。检查失败时一并输出 */
+static char test_case[256];
+
+/* 失败的检查数 */
+static int test_failures = 0;
+
+/* 设置当前测试用例的名称 */
+#define TEST_CASE(...) snprintf(test_case, sizeof(test_case), __VA_ARGS__)
+
+/* 检查条件是否成立。不成立时输出其位置和当前测试用例的名称，并返回表达式的值 */
+#define TEST_CHECK(cond) \
+  ((cond) ? 1 : (fprintf(stderr, "%s:%d: [%s] check failed: %s\n", \
+                         __FILE__, __LINE__, test_case, #cond), \
+                 test_failures++, 0))
+
+/**
+ * 输出测试的结果
+ * @param[in] name 测试的名称
+ * @return 作为main函数的返回值。所有检查都成立时为0
+ */
+static int
+test_result(const char *name)
+{
+    if (test_failures)
+    {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif /* __TEST_H__ */
@@ -0,0 +1,460 @@
+/* 倒排列表的编码、解码和游标的测试
+   直接包含postings.c，以便测试其中的静态函数 */
+#include "../postings.c"
+#include "test.h"
+
+/* 测试的压缩方法 */
+static const compress_method test_methods[] = {
+        compress_none,
+        compress_golomb,
+        compress_adaptive,
+        compress_elias_fano,
+        compress_streamvbyte,
+        compress_rice,
+        compress_interpolative
+};
+#define TEST_METHODS_COUNT \
+  ((int) (sizeof(test_methods) / sizeof(test_methods[0])))
+
+/* 倒排列表中的文档数。包含只有0个和1个文档的情况，以及块的边界的前后 */
+static const int test_sizes[] = {
+        0, 1, 2,
+        POSTINGS_CHUNK_DOCUMENTS - 1,
+        POSTINGS_CHUNK_DOCUMENTS,
+        POSTINGS_CHUNK_DOCUMENTS + 1,
+        3 * POSTINGS_CHUNK_DOCUMENTS + 7
+};
+#define TEST_SIZES_COUNT ((int) (sizeof(test_sizes) / sizeof(test_sizes[0])))
+
+/* 文档编号之差的上限、位置信息的条数的上限，以及中间的元素额外增加的文档编号和位置之差。
+   分别对应密集、一般和稀疏的倒排列表，以及参数很小而商很大（一元码很长）的倒排列表 */
+static const int test_profiles[][3] = {
+        {1,    2,  0},
+        {8,    40, 0},
+        {5000, 5,  0},
+        {1,    3,  1000000}
+};
+#define TEST_PROFILES_COUNT \
+  ((int) (sizeof(test_profiles) / sizeof(test_profiles[0])))
+
+/* 存储到数据库中时，1个块中的各个区块的文档数。小于块的文档数时，块由多个区块拼接而成 */
+static const int test_block_sizes[] = {POSTINGS_CHUNK_DOCUMENTS, 100, 7};
+#define TEST_BLOCK_SIZES_COUNT \
+  ((int) (sizeof(test_block_sizes) / sizeof(test_block_sizes[0])))
+
+/**
+ * 生成伪随机数
+ * @param[in,out] seed 随机数的种子
+ * @return 0以上32767以下的随机数
+ */
+static int
+test_rand(unsigned int *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (int) ((*seed >> 16) & 0x7FFF);
+}
+
+/**
+ * 生成测试用的倒排列表
+ * @param[in] len 倒排列表中的元素数
+ * @param[in] gap_max 文档编号之差的上限
+ * @param[in] positions_max 每个文档中位置信息的条数的上限
+ * @param[in] outlier 中间的元素额外增加的文档编号之差和位置之差
+ * @param[in] store_positions 是否生成位置信息。为0时与构建索引时一样，只有出现次数
+ * @param[out] elements 倒排列表中的元素的数组。由调用方释放
+ * @return 生成的倒排列表
+ */
+static postings_list *
+make_postings(int len, int gap_max, int positions_max, int outlier,
+              int store_positions, postings_list ***elements)
+{
+    int i, document_id = 0;
+    unsigned int seed = (unsigned int) (len * 31 + gap_max);
+    postings_list *postings = NULL, *tail = NULL;
+
+    *elements = (postings_list **) malloc(
+            sizeof(postings_list *) * (len ? len : 1));
+    for (i = 0; i < len; i++)
+    {
+        int j, position = -1;
+        postings_list *pl = malloc(sizeof(postings_list));
+
+        document_id += 1 + test_rand(&seed) % gap_max +
+                       (i == len / 2 ? outlier : 0);
+        pl->document_id = document_id;
+        pl->positions_count = 1 + test_rand(&seed) % positions_max;
+        utarray_new(pl->positions, &ut_int_icd);
+        for (j = 0; store_positions && j < pl->positions_count; j++)
+        {
+            position += 1 + test_rand(&seed) % 100 +
+                        (i == len / 2 && j == 1 ? outlier : 0);
+            utarray_push_back(pl->positions, &position);
+        }
+        POSTINGS_APPEND(postings, tail, pl);
+        (*elements)[i] = pl;
+    }
+    return postings;
+}
+
+/**
+ * 比较倒排列表中的2个元素
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] expected 期望的元素
+ * @param[in] actual 实际的元素
+ * @return 一致时为1
+ */
+static int
+same_element(const wiser_env *env, const postings_list *expected,
+             const postings_list *actual)
+{
+    if (!TEST_CHECK(actual != NULL) ||
+        !TEST_CHECK(actual->document_id == expected->document_id) ||
+        !TEST_CHECK(actual->positions_count == expected->positions_count))
+    {
+        return 0;
+    }
+    if (env->store_positions)
+    {
+        int j;
+        if (!TEST_CHECK(utarray_len(actual->positions) ==
+                        utarray_len(expected->positions)))
+        {
+            return 0;
+        }
+        for (j = 0; j < (int) utarray_len(expected->positions); j++)
+        {
+            if (!TEST_CHECK(*(int *) utarray_eltptr(actual->positions, j) ==
+                            *(int *) utarray_eltptr(expected->positions, j)))
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * 比较2个倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] expected 期望的倒排列表
+ * @param[in] actual 实际的倒排列表
+ * @return 一致时为1
+ */
+static int
+same_postings(const wiser_env *env, const postings_list *expected,
+              const postings_list *actual)
+{
+    for (; expected; expected = expected->next, actual = actual->next)
+    {
+        if (!same_element(env, expected, actual)) { return 0; }
+    }
+    return TEST_CHECK(actual == NULL);
+}
+
+/**
+ * 将倒排列表编码成1个区块后再解码，检查是否还原出相同的倒排列表
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] postings 倒排列表
+ * @param[in] len 倒排列表中的元素数
+ */
+static void
+test_round_trip(const wiser_env *env, const postings_list *postings, int len)
+{
+    int decoded_len = -1;
+    postings_list *decoded = NULL;
+    buffer *b = alloc_buffer();
+
+    encode_postings(env, postings, len, b);
+    if (TEST_CHECK(!decode_postings(env, BUFFER_PTR(b), BUFFER_SIZE(b),
+                                    postings ? postings->document_id : 1,
+                                    &decoded, &decoded_len)))
+    {
+        TEST_CHECK(decoded_len == len);
+        same_postings(env, postings, decoded);
+    }
+    free_postings_list(decoded);
+    free_buffer(b);
+}
+
+/**
+ * 将倒排列表按块存储到数据库中。每个块由指定文档数的区块拼接而成
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] segment 段的编号
+ * @param[in] elements 倒排列表中的元素的数组
+ * @param[in] len 倒排列表中的元素数
+ * @param[in] block_size 每个区块中的文档数
+ */
+static void
+insert_postings(const wiser_env *env, int token_id, int segment,
+                postings_list **elements, int len, int block_size)
+{
+    int i, j;
+    buffer *b = alloc_buffer();
+
+    for (i = 0; i < len; i += POSTINGS_CHUNK_DOCUMENTS)
+    {
+        int chunk_len = len - i < POSTINGS_CHUNK_DOCUMENTS
+                        ? len - i : POSTINGS_CHUNK_DOCUMENTS;
+
+        BUFFER_CLEAR(b);
+        for (j = i; j < i + chunk_len; j += block_size)
+        {
+            int block_len = i + chunk_len - j < block_size
+                            ? i + chunk_len - j : block_size;
+            postings_list *last = elements[j + block_len - 1],
+                    *next = last->next;
+
+            /* 与追加到块中的区块一样，以前一个区块中最后的文档编号为基准 */
+            last->next = NULL;
+            encode_postings_block(env, env->compress,
+                                  j > i ? elements[j - 1]->document_id
+                                        : elements[j]->document_id - 1,
+                                  elements[j], block_len, b);
+            last->next = next;
+        }
+        TEST_CHECK(!db_insert_postings(env, token_id,
+                                       elements[i]->document_id,
+                                       elements[i + chunk_len - 1]->document_id,
+                                       segment, chunk_len, BUFFER_PTR(b),
+                                       (int) BUFFER_SIZE(b)));
+    }
+    free_buffer(b);
+}
+
+/**
+ * 通过游标依次读取倒排列表中的所有元素，检查是否与原来的倒排列表一致
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] elements 倒排列表中的元素的数组
+ * @param[in] len 倒排列表中的元素数
+ */
+static void
+test_cursor_next(const wiser_env *env, int token_id,
+                 postings_list **elements, int len)
+{
+    int i;
+    postings_cursor cursor;
+
+    if (!TEST_CHECK(!open_postings_cursor(env, token_id, &cursor))) { return; }
+    for (i = 0; i < len; i++)
+    {
+        if (!TEST_CHECK(!postings_cursor_load_positions(&cursor)) ||
+            !same_element(env, elements[i], cursor.current) ||
+            !TEST_CHECK(!postings_cursor_next(&cursor)))
+        {
+            break;
+        }
+    }
+    TEST_CHECK(i < len || cursor.current == NULL);
+    close_postings_cursor(&cursor);
+}
+
+/**
+ * 通过游标按指定的间隔查找文档编号，检查是否移动到文档编号不小于其的第一个元素上
+ * 查找的文档编号交替地取存在的文档编号和比其小1的文档编号
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] token_id 词元编号
+ * @param[in] elements 倒排列表中的元素的数组
+ * @param[in] len 倒排列表中的元素数
+ * @param[in] stride 查找的元素的间隔
+ */
+static void
+test_cursor_seek(const wiser_env *env, int token_id,
+                 postings_list **elements, int len, int stride)
+{
+    int i;
+    postings_cursor cursor;
+
+    if (!TEST_CHECK(!open_postings_cursor(env, token_id, &cursor))) { return; }
+    for (i = 0; i < len; i += stride)
+    {
+        int target = elements[i]->document_id - (i % 2), expected = i;
+
+        /* 前一个元素的文档编号可能等于target */
+        if (i > 0 && elements[i - 1]->document_id >= target)
+        {
+            expected = i - 1;
+        }
+        if (!TEST_CHECK(!postings_cursor_seek(&cursor, target)) ||
+            !TEST_CHECK(cursor.current != NULL) ||
+            !TEST_CHECK(cursor.current->document_id ==
+                        elements[expected]->document_id))
+        {
+            break;
+        }
+        /* 每隔几次查找读取位置信息 */
+        if (i % 3 == 0 &&
+            (!TEST_CHECK(!postings_cursor_load_positions(&cursor)) ||
+             !same_element(env, elements[expected], cursor.current)))
+        {
+            break;
+        }
+    }
+    if (len && i >= len)
+    {
+        TEST_CHECK(!postings_cursor_seek(&cursor,
+                                         elements[len - 1]->document_id + 1));
+        TEST_CHECK(cursor.current == NULL);
+    }
+    close_postings_cursor(&cursor);
+}
+
+/**
+ * 将倒排列表存储到数据库中，检查读取出的倒排列表和通过游标读取的元素
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] postings 倒排列表
+ * @param[in] elements 倒排列表中的元素的数组
+ * @param[in] len 倒排列表中的元素数
+ * @param[in] block_size 每个区块中的文档数
+ */
+static void
+test_database(wiser_env *env, const postings_list *postings,
+              postings_list **elements, int len, int block_size)
+{
+    int token_id, fetched_len = -1;
+    postings_list *fetched = NULL;
+
+    if (!TEST_CHECK(!init_database(env, "memory", NULL))) { return; }
+    token_id = db_get_token_id(env, "test", 4, 1, NULL);
+    insert_postings(env, token_id, 0, elements, len, block_size);
+
+    if (TEST_CHECK(!fetch_postings(env, token_id, &fetched, &fetched_len)))
+    {
+        TEST_CHECK(fetched_len == len);
+        same_postings(env, postings, fetched);
+    }
+    free_postings_list(fetched);
+
+    test_cursor_next(env, token_id, elements, len);
+    test_cursor_seek(env, token_id, elements, len, 1);
+    test_cursor_seek(env, token_id, elements, len, 3);
+    test_cursor_seek(env, token_id, elements, len, 100);
+    test_cursor_seek(env, token_id, elements, len, 700);
+    fin_database(env);
+}
+
+/**
+ * 对整数的序列进行Stream-VByte编码后再解码，检查是否还原出相同的序列
+ * 整数的个数覆盖控制字节和SIMD解码的各个边界，各个整数依次占1至4个字节
+ */
+static void
+test_streamvbyte(void)
+{
+    static const uint32_t values[] = {
+            0, 0xFF, 0x100, 0xFFFF, 0x10000, 0xFFFFFF, 0x1000000, 0xFFFFFFFF
+    };
+    int n, i;
+
+    for (n = 0; n <= 70; n++)
+    {
+        int size;
+        uint32_t *in = malloc(sizeof(uint32_t) * (n + 1)),
+                *out = malloc(sizeof(uint32_t) * (n + 1));
+        unsigned char *e = calloc(streamvbyte_max_size(n) +
+                                  STREAMVBYTE_PADDING, 1);
+
+        TEST_CASE("streamvbyte n:%d", n);
+        for (i = 0; i < n; i++)
+        {
+            in[i] = values[(i * 5 + n) % 8];
+        }
+        size = streamvbyte_encode(in, n, e);
+        TEST_CHECK(size <= streamvbyte_max_size(n));
+        TEST_CHECK(streamvbyte_decode(e, n, out) == size);
+        TEST_CHECK(!n || !memcmp(in, out, sizeof(uint32_t) * n));
+        free(in);
+        free(out);
+        free(e);
+    }
+}
+
+/**
+ * 将用Golomb编码存储的倒排列表通过optimize_index按当前的压缩方法重新编码，
+ * 检查读取出的倒排列表和通过游标读取的元素
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] postings 倒排列表
+ * @param[in] elements 倒排列表中的元素的数组
+ * @param[in] len 倒排列表中的元素数
+ */
+static void
+test_optimize(wiser_env *env, const postings_list *postings,
+              postings_list **elements, int len)
+{
+    int token_id, fetched_len = -1;
+    long long source_size, optimized_size;
+    postings_list *fetched = NULL;
+    wiser_env source_env;
+
+    if (!TEST_CHECK(!init_database(env, "memory", NULL))) { return; }
+    token_id = db_get_token_id(env, "test", 4, 1, NULL);
+    source_env = *env;
+    source_env.compress = compress_golomb;
+    insert_postings(&source_env, token_id, db_add_segment(env, 0),
+                    elements, len, 100);
+    TEST_CHECK(!optimize_index(env, compress_golomb, NULL,
+                               &source_size, &optimized_size));
+
+    if (TEST_CHECK(!fetch_postings(env, token_id, &fetched, &fetched_len)))
+    {
+        TEST_CHECK(fetched_len == len);
+        same_postings(env, postings, fetched);
+    }
+    free_postings_list(fetched);
+
+    test_cursor_seek(env, token_id, elements, len, 3);
+    fin_database(env);
+}
+
+int
+main(void)
+{
+    int m, s, p, i, b;
+
+    test_streamvbyte();
+
+    for (m = 0; m < TEST_METHODS_COUNT; m++)
+    {
+        for (s = 1; s >= 0; s--)
+        {
+            for (p = 0; p < TEST_PROFILES_COUNT; p++)
+            {
+                for (i = 0; i < TEST_SIZES_COUNT; i++)
+                {
+                    wiser_env env;
+                    postings_list *postings, **elements;
+
+                    memset(&env, 0, sizeof(wiser_env));
+                    env.compress = test_methods[m];
+                    env.store_positions = s;
+                    env.bitmap_threshold = DEFAULT_BITMAP_THRESHOLD;
+                    postings = make_postings(test_sizes[i],
+                                             test_profiles[p][0],
+                                             test_profiles[p][1],
+                                             test_profiles[p][2], s,
+                                             &elements);
+
+                    TEST_CASE("compress:%d positions:%d profile:%d docs:%d",
+                              test_methods[m], s, p, test_sizes[i]);
+                    test_round_trip(&env, postings, test_sizes[i]);
+                    for (b = 0; b < TEST_BLOCK_SIZES_COUNT; b++)
+                    {
+                        TEST_CASE("compress:%d positions:%d profile:%d "
+                                  "docs:%d block:%d", test_methods[m], s, p,
+                                  test_sizes[i], test_block_sizes[b]);
+                        test_database(&env, postings, elements,
+                                      test_sizes[i], test_block_sizes[b]);
+                    }
+                    TEST_CASE("compress:%d positions:%d profile:%d docs:%d "
+                              "optimized", test_methods[m], s, p,
+                              test_sizes[i]);
+                    test_optimize(&env, postings, elements, test_sizes[i]);
+
+                    free_postings_list(postings);
+                    free(elements);
+                }
+            }
+        }
+    }
+    return test_result("postings");
+}
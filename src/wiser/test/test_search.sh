@@ -0,0 +1,104 @@
+#!/bin/sh
+# 不存储位置信息的索引（-N）的检索测试
+# 用法: test_search.sh wiser的路径
+#
+# 不存储位置信息时不进行短语检索，因此检索结果（包括根据出现次数计算出的分数）
+# 应与在存储了位置信息的索引中使用-s检索的结果一致
+
+WISER=$1
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+FAILURES=0
+
+cat > "$DIR/test.xml" <<'EOF'
+<mediawiki>
+<page><title>one</title><id>1</id><revision><text>apple banana cherry apple</text></revision></page>
+<page><title>two</title><id>2</id><revision><text>banana apple</text></revision></page>
+<page><title>three</title><id>3</id><revision><text>cherry</text></revision></page>
+<page><title>four</title><id>4</id><revision><text>apple pie with banana banana</text></revision></page>
+<page><title>five</title><id>5</id><revision><text>日本語の文章。東京と京都</text></revision></page>
+</mediawiki>
+EOF
+
+# 检索并只输出检索结果
+search() {
+    "$WISER" "$@" 2>/dev/null | grep -v '^\[time\]'
+}
+
+# 按文档编号的顺序输出检索到的文档的编号和标题
+documents() {
+    search "$@" | grep '^document_id' | cut -d' ' -f1-4 | sort
+}
+
+# 检查检索结果是否一致
+check() {
+    if [ "$2" != "$3" ]; then
+        echo "$1: expected:"
+        echo "$2"
+        echo "$1: actual:"
+        echo "$3"
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+for compress in none golomb adaptive eliasfano streamvbyte rice interpolative; do
+    "$WISER" -c $compress -x "$DIR/test.xml" "$DIR/$compress.db" \
+        > /dev/null 2>&1 || { echo "$compress: build failed"; exit 1; }
+    "$WISER" -c $compress -N -x "$DIR/test.xml" "$DIR/$compress-N.db" \
+        > /dev/null 2>&1 || { echo "$compress -N: build failed"; exit 1; }
+    for query in "apple" "apple banana" "banana" "cherry" "apple pie" "東京"; do
+        check "$compress -N \"$query\"" \
+              "$(search -s -q "$query" "$DIR/$compress.db")" \
+              "$(search -q "$query" "$DIR/$compress-N.db")"
+    done
+done
+
+# 短语"apple banana"只出现在one中，但-N时包含两个词元的文档都会被找到
+check "phrase" "document_id: 1 title: one" \
+      "$(documents -q "apple banana" "$DIR/none.db")"
+check "-N document match" "document_id: 1 title: one
+document_id: 2 title: two
+document_id: 4 title: four" \
+      "$(documents -q "apple banana" "$DIR/golomb-N.db")"
+
+# 是否存储位置信息记录在settings中，重新编码时不指定-N也只编码出现次数
+"$WISER" -O -c interpolative "$DIR/golomb-N.db" > /dev/null 2>&1
+check "optimize" "$(search -s -q "apple banana" "$DIR/golomb.db")" \
+      "$(search -q "apple banana" "$DIR/golomb-N.db")"
+
+# 只读的索引文件和内存中的数据库
+"$WISER" -e "$DIR/golomb-N.idx" "$DIR/golomb-N.db" > /dev/null 2>&1
+check "index file" "$(search -q "apple banana" "$DIR/golomb-N.db")" \
+      "$(search -i "$DIR/golomb-N.idx" -q "apple banana" "$DIR/golomb-N.db")"
+check "memory backend" "$(search -q "apple banana" "$DIR/golomb-N.db")" \
+      "$(search -B memory -N -x "$DIR/test.xml" -q "apple banana" memory)"
+
+# 不合法的UTF-8字节序列被替换为U+FFFD，其他词条照常建立索引。
+# 跨越读取缓冲区边界的合法的多字节字符不被替换
+{
+    echo '<mediawiki>'
+    echo '<page><title>good</title><id>1</id><revision><text>apple banana</text></revision></page>'
+    printf '<page><title>bad</title><id>2</id><revision><text>apple \377\376 banana \343\201</text></revision></page>\n'
+    printf '<page><title>long</title><id>3</id><revision><text>'
+    i=0
+    while [ $i -lt 2000 ]; do printf '東京と京都'; i=$((i + 1)); done
+    echo '</text></revision></page>'
+    echo '<page><title>after</title><id>4</id><revision><text>cherry apple</text></revision></page>'
+    echo '</mediawiki>'
+} > "$DIR/malformed.xml"
+"$WISER" -x "$DIR/malformed.xml" "$DIR/malformed.db" > "$DIR/malformed.log" 2>&1 \
+    || { echo "malformed: build failed"; FAILURES=$((FAILURES + 1)); }
+check "malformed" "document_id: 1 title: good
+document_id: 2 title: bad
+document_id: 4 title: after" \
+      "$(documents -q "apple" "$DIR/malformed.db")"
+check "malformed count" "invalid UTF-8 sequences replaced with U+FFFD. (title: bad, count: 3)" \
+      "$(grep 'invalid UTF-8' "$DIR/malformed.log" | grep title)"
+check "multibyte across buffers" "document_id: 3 title: long" \
+      "$(documents -q "東京" "$DIR/malformed.db")"
+
+if [ $FAILURES -ne 0 ]; then
+    echo "search: $FAILURES check(s) failed"
+    exit 1
+fi
+echo "search: ok"
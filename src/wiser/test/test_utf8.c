@@ -0,0 +1,232 @@
+/* UTF-8的解码和不合法的字节序列的替换的测试 */
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util.h"
+#include "test.h"
+
+/* 不合法的字节序列被替换后的字符 */
+#define R UTF8_REPLACEMENT_CHAR
+
+/* 测试用例。字节序列和期望的UTF-32的字符串（以0结尾） */
+typedef struct
+{
+    const char *name;
+    const char *utf8;
+    UTF32Char utf32[8];
+} utf8_case;
+
+static const utf8_case utf8_cases[] = {
+        /* 合法的字符 */
+        {"ascii",              "ab",                 {'a', 'b'}},
+        {"2 bytes",            "\xC3\xA9",           {0xE9}},
+        {"3 bytes",            "\xE3\x81\x82",       {0x3042}},
+        {"4 bytes",            "\xF0\x9F\x98\x80",   {0x1F600}},
+        {"U+0080",             "\xC2\x80",           {0x80}},
+        {"U+0800",             "\xE0\xA0\x80",       {0x800}},
+        {"U+D7FF",             "\xED\x9F\xBF",       {0xD7FF}},
+        {"U+E000",             "\xEE\x80\x80",       {0xE000}},
+        {"U+FFFF",             "\xEF\xBF\xBF",       {0xFFFF}},
+        {"U+10000",            "\xF0\x90\x80\x80",   {0x10000}},
+        {"U+10FFFF",           "\xF4\x8F\xBF\xBF",   {0x10FFFF}},
+        /* 截断的序列。首字节及其后合法的续字节被替换为1个字符 */
+        {"truncated 2 bytes",  "\xC3",               {R}},
+        {"truncated 3 bytes",  "\xE3\x81",           {R}},
+        {"truncated 4 bytes",  "\xF0\x9F\x98",       {R}},
+        {"truncated in text",  "a\xE3\x81" "b",      {'a', R, 'b'}},
+        {"truncated twice",    "\xF0\x9F\xE3\x81",   {R, R}},
+        {"lone continuation",  "\x80" "a\xBF",       {R, 'a', R}},
+        /* 过长的编码。首字节不合法或第2个字节超出范围时，逐个字节替换 */
+        {"overlong C0",        "\xC0\x80",           {R, R}},
+        {"overlong C1",        "\xC1\xBF",           {R, R}},
+        {"overlong E0",        "\xE0\x80\x80",       {R, R, R}},
+        {"overlong E0 9F",     "\xE0\x9F\xBF",       {R, R, R}},
+        {"overlong F0",        "\xF0\x80\x80\x80",   {R, R, R, R}},
+        {"overlong F0 8F",     "\xF0\x8F\xBF\xBF",   {R, R, R, R}},
+        /* 代理区的字符 */
+        {"surrogate D800",     "\xED\xA0\x80",       {R, R, R}},
+        {"surrogate DFFF",     "\xED\xBF\xBF",       {R, R, R}},
+        {"surrogate pair",     "\xED\xA0\xBD\xED\xB8\x80",
+                                                     {R, R, R, R, R, R}},
+        /* 超出U+10FFFF的字符 */
+        {"U+110000",           "\xF4\x90\x80\x80",   {R, R, R, R}},
+        {"F5",                 "\xF5\x80\x80\x80",   {R, R, R, R}},
+        {"FF",                 "\xFF" "a",           {R, 'a'}}
+};
+#define UTF8_CASES_COUNT ((int) (sizeof(utf8_cases) / sizeof(utf8_cases[0])))
+
+/**
+ * 计算以0结尾的UTF-32的字符串的长度
+ * @param[in] ustr UTF-32的字符串
+ * @return 字符串的长度
+ */
+static int
+utf32_len(const UTF32Char *ustr)
+{
+    int len = 0;
+    while (ustr[len]) { len++; }
+    return len;
+}
+
+/**
+ * 检查utf8toutf32和utf8_next_char是否将字节序列解码成期望的字符串
+ * @param[in] str 字节序列
+ * @param[in] str_size 字节序列的字节数
+ * @param[in] expected 期望的字符串
+ * @param[in] expected_len 期望的字符串的长度
+ */
+static void
+check_decode(const char *str, int str_size,
+             const UTF32Char *expected, int expected_len)
+{
+    int i, n, len = -1, bytes = 0, valid = -1;
+    const char *s = str, *end = str + str_size;
+    UTF32Char *ustr = NULL, u;
+
+    TEST_CHECK(!utf8toutf32(str, str_size, NULL, &len));
+    TEST_CHECK(len == expected_len);
+    if (TEST_CHECK(!utf8toutf32(str, str_size, &ustr, &len)) &&
+        TEST_CHECK(len == expected_len))
+    {
+        TEST_CHECK(!len ||
+                   !memcmp(ustr, expected, sizeof(UTF32Char) * len));
+    }
+    free(ustr);
+
+    /* 逐个字符读取时，不合法的字节序列的返回值为负数 */
+    for (i = 0; (n = utf8_next_char(&s, end, &u)); i++)
+    {
+        if (!TEST_CHECK(i < expected_len) || !TEST_CHECK(u == expected[i]) ||
+            !TEST_CHECK((n < 0) == (u == R)))
+        {
+            break;
+        }
+        if (n < 0 && valid < 0) { valid = bytes; }
+        bytes += n < 0 ? -n : n;
+    }
+    TEST_CHECK(i == expected_len);
+    TEST_CHECK(bytes == str_size && s == end);
+
+    /* 合法的部分是第1个不合法的字节序列之前的部分 */
+    TEST_CHECK(utf8_valid_span(str, end) ==
+               (size_t) (valid < 0 ? str_size : valid));
+}
+
+/**
+ * 在由同一个字符重复构成的字符串的各个位置插入测试用例的字节序列，检查解码的结果
+ * 插入的位置覆盖每次处理16个字节的ASCII快速路径和SSSE3的检查的边界
+ * @param[in] c 测试用例
+ * @param[in] pad 重复的字符（UTF-8）
+ * @param[in] pad_char 重复的字符（UTF-32）
+ * @param[in] count 重复的次数
+ */
+static void
+check_in_text(const utf8_case *c, const char *pad, UTF32Char pad_char,
+              int count)
+{
+    int offset, i, size = (int) strlen(c->utf8), len = utf32_len(c->utf32),
+            pad_size = (int) strlen(pad);
+    char str[256];
+    UTF32Char expected[128];
+
+    for (offset = 0; offset <= count; offset++)
+    {
+        int n = 0, str_size = 0;
+
+        TEST_CASE("%s at %d in %s", c->name, offset, pad);
+        for (i = 0; i < offset; i++)
+        {
+            memcpy(str + str_size, pad, pad_size);
+            str_size += pad_size;
+            expected[n++] = pad_char;
+        }
+        memcpy(str + str_size, c->utf8, size);
+        str_size += size;
+        for (i = 0; i < len; i++) { expected[n++] = c->utf32[i]; }
+        for (i = offset; i < count; i++)
+        {
+            memcpy(str + str_size, pad, pad_size);
+            str_size += pad_size;
+            expected[n++] = pad_char;
+        }
+        check_decode(str, str_size, expected, n);
+    }
+}
+
+/**
+ * 对随机生成的字节序列，检查utf8_valid_span的结果是否与逐个字符地检查的结果一致
+ * 字节序列由合法的字符构成，并随机地修改、截断其中的字节
+ */
+static void
+check_random(void)
+{
+    static const char *const chars[] = {
+            "a", "\xC3\xA9", "\xE3\x81\x82", "\xF0\x9F\x98\x80",
+            "\xED\x9F\xBF", "\xF4\x8F\xBF\xBF"
+    };
+    int i;
+    unsigned int seed = 1;
+
+    for (i = 0; i < 20000; i++)
+    {
+        int size = 0, valid = -1, bytes = 0, n;
+        char str[128];
+        const char *s = str;
+        UTF32Char u;
+
+        TEST_CASE("random %d", i);
+        while (size < 100)
+        {
+            const char *c;
+            seed = seed * 1103515245 + 12345;
+            c = chars[(seed >> 16) % 6];
+            memcpy(str + size, c, strlen(c));
+            size += (int) strlen(c);
+        }
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 4)
+        {
+            /* 将1个字节替换为随机的值 */
+            seed = seed * 1103515245 + 12345;
+            str[(seed >> 16) % size] = (char) (seed >> 8);
+        }
+        seed = seed * 1103515245 + 12345;
+        size -= (int) ((seed >> 16) % 4);
+
+        while ((n = utf8_next_char(&s, str + size, &u)))
+        {
+            if (n < 0) { valid = bytes; break; }
+            bytes += n;
+        }
+        if (!TEST_CHECK(utf8_valid_span(str, str + size) ==
+                        (size_t) (valid < 0 ? size : valid)))
+        {
+            break;
+        }
+    }
+}
+
+int
+main(void)
+{
+    int i;
+    UTF32Char u;
+    const char *s = "";
+
+    TEST_CASE("empty");
+    check_decode(s, 0, NULL, 0);
+    TEST_CHECK(utf8_next_char(&s, s, &u) == 0);
+
+    for (i = 0; i < UTF8_CASES_COUNT; i++)
+    {
+        const utf8_case *c = &utf8_cases[i];
+
+        TEST_CASE("%s", c->name);
+        check_decode(c->utf8, (int) strlen(c->utf8), c->utf32,
+                     utf32_len(c->utf32));
+        check_in_text(c, "a", 'a', 40);
+        check_in_text(c, "\xE3\x81\x82", 0x3042, 16);
+    }
+    check_random();
+    return test_result("utf8");
+}
@@ -2,6 +2,7 @@
 #include "token.h"
 #include "postings.h"
 #include "database.h"
+#include "indexfile.h"
 
 #include <stdio.h>
 
@@ -72,81 +73,273 @@ wiser_is_ignored_char(const UTF32Char ustr)
 }
 
 /**
- * 将输入的字符串分割为N-gram
- * @param[in] ustr 输入的字符串（UTF-8）
- * @param[in] ustr_end 输入的字符串中最后一个字符的位置
- * @param[in] n N-gram中N的取值。建议将其设为大于1的值
- * @param[out] start 词元的起始位置
- * @return 分割出来的词元的长度
+ * 对新添加到倒排索引中的inverted_index_value进行初始化
+ * @param[in] ii 倒排索引
+ * @param[in,out] ii_entry 新添加的索引项。其中已设定了词元编号
+ * @param[in] docs_count 包含该词元的文档数
+ * @param[in] store_positions 是否存储位置信息。为0时不为位置信息分配存储空间
+ * @retval 0 成功
+ * @retval -1 失败
  */
 static int
-ngram_next(const UTF32Char *ustr, const UTF32Char *ustr_end,
-           unsigned int n, const UTF32Char **start)
+init_new_inverted_index(inverted_index *ii, inverted_index_value *ii_entry,
+                        int docs_count, int store_positions)
 {
-    int i;
-    const UTF32Char *p;
+    ii_entry->positions_count = 0;
+    ii_entry->docs_count = docs_count;
+    ii_entry->last_document_id = 0;
+    ii_entry->last_position = 0;
+    ii_entry->doc_positions_count = 0;
+    memset(&ii_entry->positions, 0, sizeof(byte_slice));
+    if (init_byte_slice(ii->pool, &ii_entry->documents) ||
+        (store_positions && init_byte_slice(ii->pool, &ii_entry->positions)))
+    {
+        print_error("cannot allocate memory for a postings list.");
+        /* 将倒排列表设为空，使索引项仍可被安全地读取 */
+        memset(&ii_entry->documents, 0, sizeof(byte_slice));
+        memset(&ii_entry->positions, 0, sizeof(byte_slice));
+        return -1;
+    }
+    return 0;
+}
+
+/* 能够打包成整数的N-gram中N的最大值。每个字符占21比特 */
+#define TOKEN_PACK_MAX_N 3
+#define TOKEN_PACK_CHAR_BITS 21
+/* 词元缓存的初始槽数（以2为底的对数） */
+#define TOKEN_CACHE_INITIAL_SLOTS_BITS 10
 
-    /* 读取时跳过文本开头的空格等字符 */
-    for (; ustr < ustr_end && wiser_is_ignored_char(*ustr); ustr++)
+/**
+ * 将由不超过TOKEN_PACK_MAX_N个字符构成的N-gram打包成1个64比特的整数
+ * 每个字符的编码加1后占据21比特，因此长度不同的N-gram也不会冲突，且结果不为0
+ * @param[in] t N-gram（UTF-32）
+ * @param[in] t_len N-gram中的字符数
+ * @return 打包后的整数。有超出Unicode范围的字符时为0
+ */
+static inline uint64_t
+pack_ngram(const UTF32Char *t, int t_len)
+{
+    int i;
+    uint64_t key = 0;
+    for (i = 0; i < t_len; i++)
     {
+        if (t[i] > 0x10FFFF) { return 0; }
+        key = (key << TOKEN_PACK_CHAR_BITS) | (t[i] + 1);
     }
+    return key;
+}
 
-    /* 不断取出最多包含n个字符的词元，直到遇到不属于索引对象的字符或到达了字符串的尾部 */
-    for (i = 0, p = ustr; i < n && p < ustr_end
-                          && !wiser_is_ignored_char(*p); i++, p++)
+/**
+ * 为词元缓存分配指定数量的空槽
+ * @param[in,out] cache 词元缓存
+ * @param[in] bits 槽数（以2为底的对数）
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+alloc_token_cache_slots(token_cache *cache, unsigned int bits)
+{
+    uint64_t *keys;
+    int *token_ids;
+
+    if (!(keys = calloc(1U << bits, sizeof(uint64_t))))
+    {
+        return -1;
+    }
+    if (!(token_ids = malloc(sizeof(int) << bits)))
     {
+        free(keys);
+        return -1;
     }
+    cache->keys = keys;
+    cache->token_ids = token_ids;
+    cache->slots_count = 1U << bits;
+    cache->slots_shift = 64 - bits;
+    return 0;
+}
 
-    *start = ustr;
-    return p - ustr;
+/**
+ * 计算键所对应的槽的编号（Fibonacci散列）
+ * @param[in] cache 词元缓存
+ * @param[in] key 打包后的N-gram
+ * @return 槽的编号
+ */
+static inline unsigned int
+token_cache_slot(const token_cache *cache, uint64_t key)
+{
+    return (unsigned int) ((key * 11400714819323198485ULL) >>
+                           cache->slots_shift);
 }
 
 /**
- * 为inverted_index_value分配存储空间并对其进行初始化
+ * 从词元缓存中查找打包后的N-gram
+ * @param[in] cache 词元缓存
+ * @param[in] key 打包后的N-gram
+ * @return 词元编号。找不到时为0
+ */
+static int
+token_cache_get(const token_cache *cache, uint64_t key)
+{
+    unsigned int i;
+    for (i = token_cache_slot(cache, key); cache->keys[i];
+         i = (i + 1) & (cache->slots_count - 1))
+    {
+        if (cache->keys[i] == key) { return cache->token_ids[i]; }
+    }
+    return 0;
+}
+
+/**
+ * 将打包后的N-gram及其词元编号添加到词元缓存中。缓存中还不存在该键
+ * @param[in,out] cache 词元缓存
+ * @param[in] key 打包后的N-gram
  * @param[in] token_id 词元编号
- * @param[in] docs_count 包含该词元的文档数
- * @return 生成的inverted_index_value
+ * @retval 0 成功
+ * @retval -1 失败
  */
-static inverted_index_value *
-create_new_inverted_index(int token_id, int docs_count)
+static int
+token_cache_put(token_cache *cache, uint64_t key, int token_id)
 {
-    inverted_index_value *ii_entry;
+    unsigned int i;
 
-    ii_entry = malloc(sizeof(inverted_index_value));
-    if (!ii_entry)
+    /* 为了缩短探测的距离，使负载率不超过1/2 */
+    if ((cache->entries_count + 1) * 2 > cache->slots_count)
     {
-        print_error("cannot allocate memory for an inverted index.");
-        return NULL;
+        unsigned int old_slots_count = cache->slots_count;
+        uint64_t *old_keys = cache->keys;
+        int *old_token_ids = cache->token_ids;
+
+        if (alloc_token_cache_slots(cache, 65 - cache->slots_shift))
+        {
+            print_error("cannot allocate memory for a token cache.");
+            return -1;
+        }
+        for (i = 0; i < old_slots_count; i++)
+        {
+            unsigned int j;
+            if (!old_keys[i]) { continue; }
+            for (j = token_cache_slot(cache, old_keys[i]); cache->keys[j];
+                 j = (j + 1) & (cache->slots_count - 1)) {}
+            cache->keys[j] = old_keys[i];
+            cache->token_ids[j] = old_token_ids[i];
+        }
+        free(old_keys);
+        free(old_token_ids);
     }
-    ii_entry->positions_count = 0;
-    ii_entry->postings_list = NULL;
-    ii_entry->token_id = token_id;
-    ii_entry->docs_count = docs_count;
+    for (i = token_cache_slot(cache, key); cache->keys[i];
+         i = (i + 1) & (cache->slots_count - 1)) {}
+    cache->keys[i] = key;
+    cache->token_ids[i] = token_id;
+    cache->entries_count++;
+    return 0;
+}
 
-    return ii_entry;
+/**
+ * 分配一个空的词元缓存
+ * @return 指向分配好的词元缓存的指针。失败时为NULL
+ */
+static token_cache *
+alloc_token_cache(void)
+{
+    token_cache *cache;
+    if ((cache = malloc(sizeof(token_cache))))
+    {
+        cache->entries_count = 0;
+        if (alloc_token_cache_slots(cache, TOKEN_CACHE_INITIAL_SLOTS_BITS))
+        {
+            free(cache);
+            cache = NULL;
+        }
+    }
+    if (!cache)
+    {
+        print_error("cannot allocate memory for a token cache.");
+    }
+    return cache;
 }
 
 /**
- * 为倒排列表分配存储空间并对其进行并初始化
+ * 释放词元缓存
+ * 缓存中的词元编号在回滚事务后可能失效，因此构建索引结束后应将其释放
+ * @param[in] env 存储着应用程序运行环境的结构体
+ */
+void
+free_token_cache(wiser_env *env)
+{
+    if (env->token_cache)
+    {
+        free(env->token_cache->keys);
+        free(env->token_cache->token_ids);
+        free(env->token_cache);
+        env->token_cache = NULL;
+    }
+}
+
+/**
+ * 将词元编号已知的词元的出现添加到倒排列表中
+ * 文档编号之差和位置信息之差被添加到倒排索引的字节池中。
+ * 最后添加的文档中的出现次数暂存在索引项中，直到添加下一个文档时才写入字节池。
+ * 不存储位置信息的索引只记录出现次数，但查询中的词元总是记录位置信息
+ * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] document_id 文档编号
- * @return 生成的倒排列表
+ * @param[in] token_id 词元编号
+ * @param[in] token_docs_count 包含该词元的文档数。只在检索时使用
+ * @param[in] position 词元出现的位置
+ * @param[in,out] ii 倒排索引
+ * @retval 0 成功
+ * @retval -1 失败
  */
-static postings_list *
-create_new_postings_list(int document_id)
+static int
+token_id_to_postings_list(const wiser_env *env, const int document_id,
+                          const int token_id, const int token_docs_count,
+                          const int position, inverted_index *ii)
 {
-    postings_list *pl;
+    inverted_index_value *ii_entry;
+    int created;
+    int store_positions = !document_id || env->store_positions;
 
-    pl = malloc(sizeof(postings_list));
-    if (!pl)
+    if (!(ii_entry = get_inverted_index_value(ii, token_id, &created)))
     {
-        print_error("cannot allocate memory for a postings list.");
-        return NULL;
+        return -1;
     }
-    pl->document_id = document_id;
-    pl->positions_count = 1;
-    utarray_new(pl->positions, &ut_int_icd);
-
-    return pl;
+    if (created &&
+        init_new_inverted_index(ii, ii_entry,
+                                document_id ? 0 : token_docs_count,
+                                store_positions))
+    {
+        return -1;
+    }
+    if (!ii_entry->positions_count ||
+        ii_entry->last_document_id != document_id)
+    {
+        /* 该词元第一次出现在这个文档中 */
+        if (ii_entry->positions_count &&
+            append_byte_slice_vbyte(ii->pool, &ii_entry->documents,
+                                    ii_entry->doc_positions_count))
+        {
+            return -1;
+        }
+        if (append_byte_slice_vbyte(ii->pool, &ii_entry->documents,
+                                    document_id - ii_entry->last_document_id))
+        {
+            return -1;
+        }
+        if (document_id) { ii_entry->docs_count++; }
+        ii_entry->last_document_id = document_id;
+        ii_entry->last_position = 0;
+        ii_entry->doc_positions_count = 0;
+    }
+    /* 存储位置信息 */
+    if (store_positions &&
+        append_byte_slice_vbyte(ii->pool, &ii_entry->positions,
+                                position - ii_entry->last_position))
+    {
+        return -1;
+    }
+    ii_entry->last_position = position;
+    ii_entry->doc_positions_count++;
+    ii_entry->positions_count++;
+    return 0;
 }
 
 /**
@@ -156,7 +349,7 @@ create_new_postings_list(int document_id)
  * @param[in] token 词元（UTF-8）
  * @param[in] token_size 词元的长度（以字节为单位）
  * @param[in] position 词元出现的位置
- * @param[in,out] postings 倒排列表的数组
+ * @param[in,out] ii 倒排索引
  * @retval 0 成功
  * @retval -1 失败
  */
@@ -165,92 +358,171 @@ token_to_postings_list(wiser_env *env,
                        const int document_id, const char *token,
                        const unsigned int token_size,
                        const int position,
-                       inverted_index_hash **postings)
+                       inverted_index *ii)
 {
-    postings_list *pl;
-    inverted_index_value *ii_entry;
     int token_id, token_docs_count;
 
-    token_id = db_get_token_id(
-            env, token, token_size, document_id, &token_docs_count);
-    if (*postings)
+    if (!document_id && env->index_file)
     {
-        HASH_FIND_INT(*postings, &token_id, ii_entry);
+        /* 检索时使用只读索引文件中的词典 */
+        token_id = index_file_get_token_id(env->index_file, token, token_size,
+                                           &token_docs_count);
     }
     else
     {
-        ii_entry = NULL;
+        token_id = db_get_token_id(
+                env, token, token_size, document_id, &token_docs_count);
     }
-    if (ii_entry)
+    return token_id_to_postings_list(env, document_id, token_id,
+                                     token_docs_count, position, ii);
+}
+
+/**
+ * 构建索引时，获取打包后的N-gram的词元编号
+ * 先查找词元缓存，只有缓存中不存在时才转换成UTF-8并在数据库中查找或添加
+ * 数据库中的词典仍以UTF-8字符串为键，打包后的整数只用作内存中的词元缓存的键。
+ * 检索时直接用查询字符串中的UTF-8词元查找词典，导出的索引文件也按字符串对词典排序，
+ * 而且改变tokens表的键需要迁移已有的数据库。每个词元在1次构建中只有第一次出现时
+ * 才查找数据库，因此字符串键的开销只与不同词元的数量成正比，与文档的长度无关
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] key 打包后的N-gram
+ * @param[in] t N-gram（UTF-32）
+ * @param[in] t_len N-gram中的字符数
+ * @return 词元编号。失败时为0
+ */
+static int
+get_packed_token_id(wiser_env *env, uint64_t key,
+                    const UTF32Char *t, int t_len)
+{
+    int token_id, t_8_size;
+    char t_8[TOKEN_PACK_MAX_N * MAX_UTF8_SIZE];
+
+    if ((token_id = token_cache_get(env->token_cache, key)))
     {
-        pl = ii_entry->postings_list;
-        pl->positions_count++;
+        return token_id;
     }
-    else
+    utf32toutf8(t, t_len, t_8, &t_8_size);
+    if ((token_id = db_get_token_id(env, t_8, t_8_size, 1, NULL)))
     {
-        ii_entry = create_new_inverted_index(token_id,
-                                             document_id ? 1 : token_docs_count);
-        if (!ii_entry) { return -1; }
-        HASH_ADD_INT(*postings, token_id, ii_entry);
+        token_cache_put(env->token_cache, key, token_id);
+    }
+    return token_id;
+}
 
-        pl = create_new_postings_list(document_id);
-        if (!pl) { return -1; }
-        LL_APPEND(ii_entry->postings_list, pl);
+/**
+ * 为1个N-gram创建倒排列表
+ * 构建索引时，N不超过TOKEN_PACK_MAX_N的N-gram被打包成整数，通过词元缓存获取词元编号，
+ * 只有第一次出现的N-gram才需要转换成UTF-8
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] document_id 文档编号。为0时表示把要查询的关键词作为处理对象
+ * @param[in] t N-gram（UTF-32）
+ * @param[in] t_len N-gram中的字符数
+ * @param[in] position N-gram出现的位置
+ * @param[in,out] ii 倒排索引
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+ngram_to_postings_list(wiser_env *env, const int document_id,
+                       const UTF32Char *t, int t_len, int position,
+                       inverted_index *ii)
+{
+    uint64_t key;
+    int t_8_size;
+    char t_8[t_len * MAX_UTF8_SIZE];
+
+    if (document_id && env->token_cache && t_len <= TOKEN_PACK_MAX_N &&
+        (key = pack_ngram(t, t_len)))
+    {
+        return token_id_to_postings_list(
+                env, document_id, get_packed_token_id(env, key, t, t_len),
+                0, position, ii);
     }
-    /* 存储位置信息 */
-    utarray_push_back(pl->positions, &position);
-    ii_entry->positions_count++;
-    return 0;
+    utf32toutf8(t, t_len, t_8, &t_8_size);
+    return token_to_postings_list(env, document_id, t_8, t_8_size,
+                                  position, ii);
 }
 
 /**
  * 为构成文档内容的字符串建立倒排列表的集合
+ * 一边对UTF-8进行解码一边生成N-gram，只在窗口中保留最近的不超过n个字符，
+ * 因此不需要把整个字符串转换成UTF-32。不合法的字节序列被当作U+FFFD处理
+ * （从Wikipedia的副本加载的文档在解析XML之前已被替换，参看wikiload.c）。
+ * 每个属于索引对象的字符都是1个词元的开头，词元由它及其后连续的最多n个属于索引对象的字符构成
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] document_id 文档编号。为0时表示把要查询的关键词作为处理对象
- * @param[in] text 输入的字符串
- * @param[in] text_len 输入的字符串的长度
+ * @param[in] text 输入的字符串（UTF-8）
+ * @param[in] text_size 输入的字符串的字节数
  * @param[in] n N-gram中N的取值
- * @param[in,out] postings 倒排列表的数组（也可视作是指向小倒排索引的指针）。若传入的指针指向了NULL，
- *                         则表示要新建一个倒排列表的数组（小倒排索引）。若传入的指针指向了之前就已经存在的倒排列表的数组，
- *                         则表示要添加元素
+ * @param[in,out] postings 倒排索引。若传入的指针指向了NULL，则表示要新建一个倒排索引。
+ *                         若传入的指针指向了之前就已经存在的倒排索引，则表示要添加元素
  * @retval 0 成功
  * @retval -1 失败
  */
 int
 text_to_postings_lists(wiser_env *env,
-                       const int document_id, const UTF32Char *text,
-                       const unsigned int text_len,
-                       const int n, inverted_index_hash **postings)
+                       const int document_id, const char *text,
+                       const unsigned int text_size,
+                       const int n, inverted_index **postings)
 {
     /* FIXME: now same document update is broken. */
-    int t_len, position = 0;
-    const UTF32Char *t = text, *text_end = text + text_len;
-
-    inverted_index_hash *buffer_postings = NULL;
+    int i, retval, window_len = 0, position = 0;
+    const char *p = text, *text_end = text + text_size, *ascii_end = text;
+    UTF32Char window[n];
 
-    for (; (t_len = ngram_next(t, text_end, n, &t)); t++, position++)
+    if (!*postings && !(*postings = alloc_inverted_index()))
     {
-        /* 检索时，忽略掉由t中长度不足N-gram的最后几个字符构成的词元 */
-        if (t_len >= n || document_id)
-        {
-            int retval, t_8_size;
-            char t_8[n * MAX_UTF8_SIZE];
-
-            utf32toutf8(t, t_len, t_8, &t_8_size);
-
-            retval = token_to_postings_list(env, document_id, t_8, t_8_size,
-                                            position, &buffer_postings);
-            if (retval) { return retval; }
-        }
+        return -1;
     }
-
-    if (*postings)
+    if (document_id && n <= TOKEN_PACK_MAX_N && !env->token_cache &&
+        !(env->token_cache = alloc_token_cache()))
     {
-        merge_inverted_index(*postings, buffer_postings);
+        return -1;
     }
-    else
+
+    for (;;)
     {
-        *postings = buffer_postings;
+        UTF32Char c;
+        int end = 0;
+
+        /* 连续的ASCII字符不经过解码直接处理 */
+        if (p >= ascii_end) { ascii_end = p + utf8_ascii_span(p, text_end); }
+        if (p < ascii_end)
+        {
+            c = (unsigned char) *p++;
+        }
+        else if (!utf8_next_char(&p, text_end, &c))
+        {
+            end = 1;
+        }
+
+        if (!end && !wiser_is_ignored_char(c))
+        {
+            window[window_len++] = c;
+            if (window_len < n) { continue; }
+            /* 窗口中有n个字符时，输出以其中最早的字符开头的词元 */
+            if ((retval = ngram_to_postings_list(env, document_id, window, n,
+                                                 position++, *postings)))
+            {
+                return retval;
+            }
+            memmove(window, window + 1, sizeof(UTF32Char) * --window_len);
+            continue;
+        }
+        /* 遇到不属于索引对象的字符或到达结尾时，输出以窗口中剩余的字符开头的词元。
+           检索时，忽略掉这些长度不足N-gram的词元 */
+        for (i = 0; i < window_len; i++, position++)
+        {
+            if (document_id &&
+                (retval = ngram_to_postings_list(env, document_id,
+                                                 window + i, window_len - i,
+                                                 position, *postings)))
+            {
+                return retval;
+            }
+        }
+        window_len = 0;
+        if (end) { break; }
     }
 
     return 0;
@@ -4,16 +4,18 @@
 #include "wiser.h"
 
 int text_to_postings_lists(wiser_env *env,
-                           const int document_id, const UTF32Char *text,
-                           const unsigned int text_len,
-                           const int n, inverted_index_hash **postings);
+                           const int document_id, const char *text,
+                           const unsigned int text_size,
+                           const int n, inverted_index **postings);
 
 void dump_token(wiser_env *env, int token_id);
 
+void free_token_cache(wiser_env *env);
+
 int token_to_postings_list(wiser_env *env,
                            const int document_id, const char *token,
                            const unsigned int token_size,
                            const int position,
-                           inverted_index_hash **postings);
+                           inverted_index *ii);
 
 #endif /* __TOKEN_H__ */
@@ -5,6 +5,16 @@
 #include <memory.h>
 #include <sys/time.h>
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define UTIL_SSE2
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define UTIL_SSSE3
+#endif
+
 #include "util.h"
 
 #define BUFFER_INIT_MIN 32 /* 分配缓冲区时的初始字节数 */
@@ -95,7 +105,7 @@ append_buffer(buffer *buf, const void *data, unsigned int data_size)
         buf->curr++;
         buf->bit = 0;
     }
-    if (buf->curr + data_size > buf->tail)
+    while (buf->curr + data_size > buf->tail)
     {
         if (enlarge_buffer(buf)) { return 0; }
     }
@@ -139,6 +149,241 @@ free_buffer(buffer *buf)
     free(buf);
 }
 
+#define BYTE_POOL_BLOCK_SHIFT 16 /* 字节池中1个块的字节数（以2为底的对数） */
+#define BYTE_POOL_BLOCK_SIZE (1 << BYTE_POOL_BLOCK_SHIFT)
+#define BYTE_POOL_BLOCK_MASK (BYTE_POOL_BLOCK_SIZE - 1)
+#define BYTE_POOL_MAX_BLOCKS ((int) (BYTE_POOL_MAX_SIZE >> BYTE_POOL_BLOCK_SHIFT))
+/* 将字节池中的偏移量转换为指针 */
+#define BYTE_POOL_PTR(pool, offset) \
+  ((pool)->blocks[(offset) >> BYTE_POOL_BLOCK_SHIFT] \
+   + ((offset) & BYTE_POOL_BLOCK_MASK))
+
+/* 各等级的slice的字节数（包括末尾的指向下一个slice的4个字节） */
+static const uint32_t byte_slice_sizes[] = {8, 16, 32, 64, 128, 256, 512, 1024};
+#define BYTE_SLICE_MAX_LEVEL \
+  (sizeof(byte_slice_sizes) / sizeof(byte_slice_sizes[0]) - 1)
+#define BYTE_SLICE_NEXT_LEVEL(level) \
+  ((level) < BYTE_SLICE_MAX_LEVEL ? (level) + 1 : BYTE_SLICE_MAX_LEVEL)
+
+/**
+ * 分配一个字节池
+ * @return 指向分配好的字节池的指针
+ */
+byte_pool *
+alloc_byte_pool(void)
+{
+    return calloc(1, sizeof(byte_pool));
+}
+
+/**
+ * 释放字节池及从中切分出的所有存储空间
+ * @param[in] pool 指向要释放的字节池的指针
+ */
+void
+free_byte_pool(byte_pool *pool)
+{
+    int i;
+    for (i = 0; i < pool->blocks_count; i++)
+    {
+        free(pool->blocks[i]);
+    }
+    free(pool->blocks);
+    free(pool);
+}
+
+/**
+ * 获取字节池占用的字节数
+ * @param[in] pool 指向字节池的指针
+ * @return 所有块及块的数组所占用的字节数之和
+ */
+size_t
+byte_pool_size(const byte_pool *pool)
+{
+    return (size_t) pool->blocks_count * BYTE_POOL_BLOCK_SIZE
+           + pool->blocks_capacity * sizeof(char *);
+}
+
+/**
+ * 从字节池中切分出指定字节数的存储空间。切分出的存储空间不会跨越块的边界
+ * @param[in] pool 指向字节池的指针
+ * @param[in] size 要切分出的字节数。不得大于块的字节数
+ * @param[out] offset 切分出的存储空间在字节池中的偏移量
+ * @retval 0 成功
+ * @retval 1 失败
+ */
+static int
+byte_pool_alloc(byte_pool *pool, uint32_t size, uint32_t *offset)
+{
+    if (!pool->blocks_count ||
+        (pool->upto & BYTE_POOL_BLOCK_MASK) + size > BYTE_POOL_BLOCK_SIZE ||
+        !(pool->upto & BYTE_POOL_BLOCK_MASK))
+    {
+        char *block;
+        /* 当前的块中没有足够的空间，分配新的块 */
+        if (pool->blocks_count >= BYTE_POOL_MAX_BLOCKS)
+        {
+            print_error("byte pool is full.");
+            return 1;
+        }
+        if (pool->blocks_count == pool->blocks_capacity)
+        {
+            int new_capacity;
+            char **new_blocks;
+            new_capacity = pool->blocks_capacity ? pool->blocks_capacity * 2 : 8;
+            if (!(new_blocks = realloc(pool->blocks,
+                                       sizeof(char *) * new_capacity)))
+            {
+                return 1;
+            }
+            pool->blocks = new_blocks;
+            pool->blocks_capacity = new_capacity;
+        }
+        if (!(block = malloc(BYTE_POOL_BLOCK_SIZE))) { return 1; }
+        pool->blocks[pool->blocks_count] = block;
+        pool->upto = (uint32_t) pool->blocks_count << BYTE_POOL_BLOCK_SHIFT;
+        pool->blocks_count++;
+    }
+    *offset = pool->upto;
+    pool->upto += size;
+    return 0;
+}
+
+/**
+ * 初始化字节池中的可变长数据，为其分配首个slice
+ * @param[in] pool 指向字节池的指针
+ * @param[out] slice 待初始化的可变长数据
+ * @retval 0 成功
+ * @retval 1 失败
+ */
+int
+init_byte_slice(byte_pool *pool, byte_slice *slice)
+{
+    if (byte_pool_alloc(pool, byte_slice_sizes[0], &slice->start))
+    {
+        return 1;
+    }
+    slice->upto = slice->start;
+    slice->end = slice->start + byte_slice_sizes[0] - sizeof(uint32_t);
+    slice->level = 0;
+    return 0;
+}
+
+/**
+ * 将1个字节的数据添加到字节池中的可变长数据中。当前的slice已满时，分配下一个slice
+ * @param[in] pool 指向字节池的指针
+ * @param[in,out] slice 要向里面添加数据的可变长数据
+ * @param[in] c 待添加的数据
+ * @retval 0 成功
+ * @retval 1 失败
+ */
+static inline int
+append_byte_slice_byte(byte_pool *pool, byte_slice *slice, unsigned char c)
+{
+    if (slice->upto == slice->end)
+    {
+        uint32_t next, level = BYTE_SLICE_NEXT_LEVEL(slice->level);
+        if (byte_pool_alloc(pool, byte_slice_sizes[level], &next))
+        {
+            return 1;
+        }
+        /* 在当前slice的末尾记录下一个slice的位置 */
+        memcpy(BYTE_POOL_PTR(pool, slice->end), &next, sizeof(uint32_t));
+        slice->upto = next;
+        slice->end = next + byte_slice_sizes[level] - sizeof(uint32_t);
+        slice->level = level;
+    }
+    *BYTE_POOL_PTR(pool, slice->upto) = c;
+    slice->upto++;
+    return 0;
+}
+
+/**
+ * 用可变字节码（variable byte code）将数值添加到字节池中的可变长数据中
+ * @param[in] pool 指向字节池的指针
+ * @param[in,out] slice 要向里面添加数据的可变长数据
+ * @param[in] n 待添加的数值
+ * @retval 0 成功
+ * @retval 1 失败
+ */
+int
+append_byte_slice_vbyte(byte_pool *pool, byte_slice *slice, unsigned int n)
+{
+    /* 每个字节存储7个比特，最高位为1表示还有后续的字节 */
+    while (n >= 0x80)
+    {
+        if (append_byte_slice_byte(pool, slice, (n & 0x7f) | 0x80))
+        {
+            return 1;
+        }
+        n >>= 7;
+    }
+    return append_byte_slice_byte(pool, slice, n);
+}
+
+/**
+ * 初始化用于读取字节池中的可变长数据的游标
+ * @param[out] reader 待初始化的游标
+ * @param[in] pool 数据所在的字节池
+ * @param[in] slice 要读取的可变长数据
+ */
+void
+init_byte_slice_reader(byte_slice_reader *reader,
+                       const byte_pool *pool, const byte_slice *slice)
+{
+    reader->pool = pool;
+    reader->upto = slice->start;
+    reader->end = slice->start + byte_slice_sizes[0] - sizeof(uint32_t);
+    reader->limit = slice->upto;
+    reader->level = 0;
+}
+
+/**
+ * 从字节池中的可变长数据中读取1个字节
+ * @param[in,out] reader 游标
+ * @return 读取出的字节。已到达数据的结尾时返回-1
+ */
+static inline int
+read_byte_slice_byte(byte_slice_reader *reader)
+{
+    unsigned char c;
+    if (reader->upto == reader->limit) { return -1; }
+    if (reader->upto == reader->end)
+    {
+        uint32_t next;
+        memcpy(&next, BYTE_POOL_PTR(reader->pool, reader->end),
+               sizeof(uint32_t));
+        reader->level = BYTE_SLICE_NEXT_LEVEL(reader->level);
+        reader->upto = next;
+        reader->end = next + byte_slice_sizes[reader->level]
+                      - sizeof(uint32_t);
+        if (reader->upto == reader->limit) { return -1; }
+    }
+    c = (unsigned char) *BYTE_POOL_PTR(reader->pool, reader->upto);
+    reader->upto++;
+    return c;
+}
+
+/**
+ * 从字节池中的可变长数据中读取1个用可变字节码编码的数值
+ * @param[in,out] reader 游标
+ * @param[out] n 读取出的数值
+ * @retval 0 成功
+ * @retval 1 已到达数据的结尾
+ */
+int
+read_byte_slice_vbyte(byte_slice_reader *reader, unsigned int *n)
+{
+    int c, shift = 0;
+    *n = 0;
+    while ((c = read_byte_slice_byte(reader)) >= 0)
+    {
+        *n |= (unsigned int) (c & 0x7f) << shift;
+        if (!(c & 0x80)) { return 0; }
+        shift += 7;
+    }
+    return 1;
+}
+
 /**
  * 计算将字符串的编码由UTF-32转换为UTF-8时所需的字节数
  * @param[in] ustr 输入的字符串（UTF-32）
@@ -252,21 +497,318 @@ utf32toutf8(const UTF32Char *ustr, int ustr_len, char *str,
 }
 
 /**
- * 首字节在0x80～0xFF中的UTF-8字符所需的字节数。0表示错误
- **/
-const static unsigned char utf8_skip_table[] = {
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 80-8F */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 90-9F */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* A0-AF */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* B0-BF */
-        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, /* C0-CF */
-        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, /* D0-DF */
-        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, /* E0-EF */
-        4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 0, 0, /* F0-FF */
-};
+ * 对1个UTF-8字符进行解码，并检查其是否合法
+ * 只接受RFC 3629中规定的最短形式，不接受代理区的字符和超出U+10FFFF的字符。
+ * 不合法的字节序列按“最大有效子序列”替换为1个U+FFFD：
+ * 首字节不合法时只跳过1个字节，否则跳过首字节及其后合法的续字节。
+ * 也是utf8_valid_span在不支持SSSE3时使用的、逐个字符地进行检查的实现
+ * @param[in] s 字符的首字节
+ * @param[in] end 字符串的结尾。s必须小于end
+ * @param[out] uchar 解码后的字符（UTF-32）。不合法时为UTF8_REPLACEMENT_CHAR
+ * @return 读取的字节数。字节序列不合法时为读取的字节数的相反数
+ */
+static inline int
+utf8_decode(const unsigned char *s, const unsigned char *end,
+            UTF32Char *uchar)
+{
+    int i, n;
+    unsigned char lo = 0x80, hi = 0xBF;
+    UTF32Char u;
+
+    if (s[0] < 0x80)
+    {
+        *uchar = s[0];
+        return 1;
+    }
+    /* 由首字节确定字节数，以及第2个字节的合法范围 */
+    if (s[0] < 0xC2)
+    {
+        /* 续字节或过长的2字节序列的首字节 */
+        *uchar = UTF8_REPLACEMENT_CHAR;
+        return -1;
+    }
+    else if (s[0] < 0xE0)
+    {
+        n = 2;
+        u = s[0] & 0x1F;
+    }
+    else if (s[0] < 0xF0)
+    {
+        n = 3;
+        u = s[0] & 0x0F;
+        if (s[0] == 0xE0) { lo = 0xA0; }      /* 过长的编码 */
+        else if (s[0] == 0xED) { hi = 0x9F; } /* 代理区的字符 */
+    }
+    else if (s[0] < 0xF5)
+    {
+        n = 4;
+        u = s[0] & 0x07;
+        if (s[0] == 0xF0) { lo = 0x90; }      /* 过长的编码 */
+        else if (s[0] == 0xF4) { hi = 0x8F; } /* 超出U+10FFFF */
+    }
+    else
+    {
+        *uchar = UTF8_REPLACEMENT_CHAR;
+        return -1;
+    }
+    for (i = 1; i < n; i++)
+    {
+        if (s + i >= end || s[i] < lo || s[i] > hi)
+        {
+            *uchar = UTF8_REPLACEMENT_CHAR;
+            return -i;
+        }
+        u = (u << 6) | (s[i] & 0x3F);
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    *uchar = u;
+    return n;
+}
+
+/**
+ * 计算字符串开头连续的ASCII字符的字节数
+ * 支持SSE2时每次检查16个字节
+ * @param[in] str 输入的字符串（UTF-8）
+ * @param[in] str_end 字符串的结尾
+ * @return 开头连续的ASCII字符的字节数
+ */
+size_t
+utf8_ascii_span(const char *str, const char *str_end)
+{
+    const unsigned char *s = (const unsigned char *) str;
+    const unsigned char *end = (const unsigned char *) str_end;
+
+#ifdef UTIL_SSE2
+    for (; end - s >= 16; s += 16)
+    {
+        /* 各个字节的最高位构成的掩码。不为0时其中有非ASCII的字节 */
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) s));
+        if (mask)
+        {
+            return s - (const unsigned char *) str + __builtin_ctz(mask);
+        }
+    }
+#endif /* UTIL_SSE2 */
+    for (; s < end && *s < 0x80; s++) {}
+    return s - (const unsigned char *) str;
+}
+
+#ifdef UTIL_SSSE3
+/*
+ * 用SSSE3按查表的方式检查UTF-8（Keiser, Lemire: Validating UTF-8 In Less Than
+ * One Instruction Per Byte）。以连续的2个字节为单位，用第1个字节的高4位和低4位、
+ * 第2个字节的高4位分别查表，3个结果的按位与中的各个比特表示以下的错误
+ */
+#define UTF8_TOO_SHORT      0x01 /* 首字节之后不是续字节 */
+#define UTF8_TOO_LONG       0x02 /* ASCII字符之后是续字节 */
+#define UTF8_OVERLONG_3     0x04 /* E0 80..9F */
+#define UTF8_TOO_LARGE      0x08 /* F4 90..BF和F5..FF */
+#define UTF8_SURROGATE      0x10 /* ED A0..BF */
+#define UTF8_OVERLONG_2     0x20 /* C0..C1 */
+#define UTF8_TOO_LARGE_1000 0x40 /* F5..FF 80..8F */
+#define UTF8_OVERLONG_4     0x40 /* F0 80..8F */
+#define UTF8_TWO_CONTS      0x80 /* 续字节之后是续字节 */
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+/**
+ * 对16个字节中的各个字节的高4位或低4位查表
+ * @param[in] table 16个元素的表
+ * @param[in] nibbles 各个字节为0～15的值
+ * @return 查表的结果
+ */
+__attribute__((target("ssse3")))
+static inline __m128i
+utf8_lookup(__m128i table, __m128i nibbles)
+{
+    return _mm_shuffle_epi8(table, nibbles);
+}
+
+/**
+ * 用SSSE3每次检查16个字节，找出开头的合法的UTF-8字节序列
+ * 遇到包含错误的区块时停止，之后的字节由调用方逐个字符地进行检查
+ * @param[in] str 输入的字符串（UTF-8）
+ * @param[in] end 字符串的结尾
+ * @return 检查过的部分的结尾。其前面都是完整且合法的字符
+ */
+__attribute__((target("ssse3")))
+static const unsigned char *
+utf8_valid_span_ssse3(const unsigned char *str, const unsigned char *end)
+{
+    int i;
+    const unsigned char *s = str;
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+    const __m128i byte_1_high = _mm_setr_epi8(
+            /* 0_______：ASCII字符 */
+            UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+            UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+            /* 10______：续字节 */
+            (char) UTF8_TWO_CONTS, (char) UTF8_TWO_CONTS,
+            (char) UTF8_TWO_CONTS, (char) UTF8_TWO_CONTS,
+            /* 110_____：2字节字符的首字节 */
+            UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+            UTF8_TOO_SHORT,
+            /* 1110____：3字节字符的首字节 */
+            UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+            /* 1111____：4字节字符的首字节 */
+            UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 |
+            UTF8_OVERLONG_4);
+    const __m128i byte_1_low = _mm_setr_epi8(
+            (char) (UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 |
+                    UTF8_OVERLONG_4),
+            (char) (UTF8_CARRY | UTF8_OVERLONG_2),
+            (char) UTF8_CARRY,
+            (char) UTF8_CARRY,
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 |
+                    UTF8_SURROGATE),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+            (char) (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000));
+    const __m128i byte_2_high = _mm_setr_epi8(
+            /* ________ 0_______ */
+            UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+            UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+            /* ________ 1000____ */
+            (char) (UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+                    UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4),
+            /* ________ 1001____ */
+            (char) (UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+                    UTF8_OVERLONG_3 | UTF8_TOO_LARGE),
+            /* ________ 101_____ */
+            (char) (UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+                    UTF8_SURROGATE | UTF8_TOO_LARGE),
+            (char) (UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+                    UTF8_SURROGATE | UTF8_TOO_LARGE),
+            /* ________ 11______ */
+            UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+    /* 结尾的1～3个字节是还未结束的字符的一部分时，减去该值后不为0 */
+    const __m128i incomplete_max = _mm_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            (char) (0xF0 - 1), (char) (0xE0 - 1), (char) (0xC0 - 1));
+    __m128i prev = _mm_setzero_si128(), incomplete = _mm_setzero_si128();
+
+    for (; end - s >= 16; s += 16)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i *) s), error;
+
+        if (!_mm_movemask_epi8(in))
+        {
+            /* 只有ASCII字符时，只需检查前一个区块结尾处的字符是否已结束 */
+            error = incomplete;
+        }
+        else
+        {
+            __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+            __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+            __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+            __m128i special = _mm_and_si128(
+                    _mm_and_si128(
+                            utf8_lookup(byte_1_high, _mm_and_si128(
+                                    _mm_srli_epi16(prev1, 4), nibble_mask)),
+                            utf8_lookup(byte_1_low,
+                                        _mm_and_si128(prev1, nibble_mask))),
+                    utf8_lookup(byte_2_high, _mm_and_si128(
+                            _mm_srli_epi16(in, 4), nibble_mask)));
+            /* 3字节和4字节的字符的第3、4个字节必须是续字节。
+               此时UTF8_TWO_CONTS不是错误，与其按位异或后抵消 */
+            __m128i must_be_cont = _mm_and_si128(
+                    _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                                 _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80))),
+                    _mm_set1_epi8((char) 0x80));
+            error = _mm_xor_si128(special, must_be_cont);
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) !=
+            0xFFFF)
+        {
+            break;
+        }
+        incomplete = _mm_subs_epu8(in, incomplete_max);
+        prev = in;
+    }
+    /* 最后检查过的区块结尾处的字符可能还未结束，退回到其首字节 */
+    for (i = 1; i <= 3 && s - i >= str; i++)
+    {
+        if (s[-i] >= 0xC0)
+        {
+            if (s[-i] >= (i == 1 ? 0xC0 : i == 2 ? 0xE0 : 0xF0)) { s -= i; }
+            break;
+        }
+        if (s[-i] < 0x80) { break; }
+    }
+    return s;
+}
+#endif /* UTIL_SSSE3 */
+
+/**
+ * 计算字符串开头的合法的UTF-8字节序列的字节数
+ * 结尾处被截断的字符不计算在内。
+ * CPU支持SSSE3时每次检查16个字节，否则逐个字符地进行检查
+ * @param[in] str 输入的字符串（UTF-8）
+ * @param[in] str_end 字符串的结尾
+ * @return 开头的合法的UTF-8字节序列的字节数
+ */
+size_t
+utf8_valid_span(const char *str, const char *str_end)
+{
+    const unsigned char *s = (const unsigned char *) str;
+    const unsigned char *end = (const unsigned char *) str_end;
+
+#ifdef UTIL_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        s = utf8_valid_span_ssse3(s, end);
+    }
+#endif /* UTIL_SSSE3 */
+    while (s < end)
+    {
+        UTF32Char u;
+        int n;
+
+        s += utf8_ascii_span((const char *) s, (const char *) end);
+        if (s >= end || (n = utf8_decode(s, end, &u)) < 0) { break; }
+        s += n;
+    }
+    return s - (const unsigned char *) str;
+}
+
+/**
+ * 计算合法的UTF-8字节序列中的字符数
+ * 字符数等于续字节以外的字节数。支持SSE2时每次计算16个字节
+ * @param[in] s 合法的UTF-8字节序列
+ * @param[in] size 字节数
+ * @return 字符数
+ */
+static int
+utf8_count_chars(const unsigned char *s, size_t size)
+{
+    int len = 0;
+    const unsigned char *end = s + size;
+
+#ifdef UTIL_SSE2
+    for (; end - s >= 16; s += 16)
+    {
+        /* 续字节（0x80～0xBF）作为有符号数小于-64 */
+        int conts = _mm_movemask_epi8(
+                _mm_cmplt_epi8(_mm_loadu_si128((const __m128i *) s),
+                               _mm_set1_epi8(-64)));
+        len += 16 - __builtin_popcount(conts);
+    }
+#endif /* UTIL_SSE2 */
+    for (; s < end; s++) { len += (*s & 0xC0) != 0x80; }
+    return len;
+}
 
 /**
  * 计算UTF-8字符串的长度
+ * 不合法的字节序列按替换成U+FFFD后的字符数计算
  * @param[in] str 输入的字符串（UTF-8）
  * @param[in] str_size 输入的字符串的字节数
  * @return UTF-8字符串的长度
@@ -275,76 +817,88 @@ static int
 utf8_len(const char *str, int str_size)
 {
     int len = 0;
-    const char *str_end;
-    for (str_end = str + str_size; str < str_end;)
+    const unsigned char *s = (const unsigned char *) str, *end = s + str_size;
+
+    while (s < end)
     {
-        if (*str >= 0)
-        {
-            str += 1;
-            len++;
-        }
-        else
-        {
-            unsigned char s = utf8_skip_table[*str + 0x80];
-            if (!s) { abort(); }
-            str += s;
-            len++;
-        }
+        int n;
+        UTF32Char u;
+        size_t valid = utf8_valid_span((const char *) s, (const char *) end);
+
+        len += utf8_count_chars(s, valid);
+        s += valid;
+        if (s >= end) { break; }
+        /* 不合法的字节序列替换为1个字符 */
+        n = utf8_decode(s, end, &u);
+        s += n < 0 ? -n : n;
+        len++;
     }
     return len;
 }
 
 /**
  * 将UTF-8的字符串转换为UTF-32的字符串
- * UTF-32的字符串存储在新分配的缓冲区中
+ * UTF-32的字符串存储在新分配的缓冲区中。不合法的字节序列被替换为U+FFFD。
+ * 连续的ASCII字符不经过解码
  * @param[in] str 输入的字符串（UTF-8）
- * @param[in] str_size 输入的字符串的字节数。-1表示输入的是以NULL结尾的字符串
- * @param[out] ustr 转换后的字符串（UTF-32）。由调用方释放
+ * @param[in] str_size 输入的字符串的字节数
+ * @param[out] ustr 转换后的字符串（UTF-32）。由调用方释放。
+ *                  为NULL时只计算转换后的字符串的长度
  * @param[out] ustr_len 转换后的字符串的长度。调用时可将该参数设为NULL
  * @retval 0 成功
+ * @retval -1 分配内存失败
  */
 int
 utf8toutf32(const char *str, int str_size, UTF32Char **ustr,
             int *ustr_len)
 {
     int ulen;
+    UTF32Char *u;
+    const unsigned char *s = (const unsigned char *) str, *end = s + str_size;
+
     ulen = utf8_len(str, str_size);
     if (ustr_len) { *ustr_len = ulen; }
     if (!ustr) { return 0; }
-    if ((*ustr = malloc(sizeof(UTF32Char) * ulen)))
+    if (!(*ustr = malloc(sizeof(UTF32Char) * (ulen ? ulen : 1))))
     {
-        UTF32Char *u;
-        const char *str_end;
-        for (u = *ustr, str_end = str + str_size; str < str_end;)
-        {
-            if (*str >= 0)
-            {
-                *u++ = *str;
-                str += 1;
-            }
-            else
-            {
-                unsigned char s = utf8_skip_table[*str + 0x80];
-                if (!s) { abort(); }
-                /* 从n字节的UTF-8字符的首字节取出后(7 - n)个比特 */
-                *u = *str & ((1 << (7 - s)) - 1);
-                /* 从n字节的UTF-8字符的剩余字节序列中每次取出6个比特 */
-                for (str++, s--; s--; str++)
-                {
-                    *u = *u << 6;
-                    *u |= *str & 0x3f;
-                }
-                u++;
-            }
-        }
+        print_error("cannot allocate memory on utf8toutf32.");
+        return -1;
     }
-    else
+    for (u = *ustr; s < end;)
     {
-        print_error("cannot allocate memory on utf8toutf32.");
+        int n;
+        const unsigned char *ascii_end =
+                s + utf8_ascii_span((const char *) s, (const char *) end);
+
+        for (; s < ascii_end; s++) { *u++ = *s; }
+        if (s >= end) { break; }
+        n = utf8_decode(s, end, u++);
+        s += n < 0 ? -n : n;
     }
     return 0;
 }
 
+/**
+ * 从UTF-8的字符串中读取1个字符
+ * 用于逐个字符地处理字符串，无需事先转换成UTF-32的字符串。
+ * 不合法的字节序列被替换为U+FFFD，返回值为负数
+ * @param[in,out] str 读取的位置。读取后指向下一个字符
+ * @param[in] str_end 字符串的结尾
+ * @param[out] uchar 读取到的字符（UTF-32）
+ * @return 读取的字节数。已到达结尾时为0，字节序列不合法时为读取的字节数的相反数
+ */
+int
+utf8_next_char(const char **str, const char *str_end, UTF32Char *uchar)
+{
+    int n;
+    const unsigned char *s = (const unsigned char *) *str;
+
+    if (*str >= str_end) { return 0; }
+    n = utf8_decode(s, (const unsigned char *) str_end, uchar);
+    *str += n < 0 ? -n : n;
+    return n;
+}
+
 /**
  * 将struct timeval转换成表示时刻的字符串
  * 缓冲区buffer的长度应为37个字节
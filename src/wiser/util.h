@@ -2,10 +2,12 @@
 #define __UTIL_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 typedef uint32_t
         UTF32Char; /* 经过UTF-32编码的Unicode字符串 */
 #define MAX_UTF8_SIZE 4 /* 用UTF-8表示1个Unicode字符最多需要多少个字节 */
+#define UTF8_REPLACEMENT_CHAR 0xFFFD /* 代替不合法的UTF-8字节序列的字符 */
 
 typedef struct
 {
@@ -16,8 +18,40 @@ typedef struct
 } buffer;
 
 #define BUFFER_PTR(b) ((b)->head) /* 返回指向缓冲区开头的指针 */
+#define BUFFER_CLEAR(b) ((b)->curr = (b)->head, (b)->bit = 0) /* 清空缓冲区 */
 #define BUFFER_SIZE(b) ((b)->curr - (b)->head) /* 返回缓冲区的大小 */
 
+/* 字节池的容量（字节数）。字节池中的偏移量为32位，因此最多为4GiB */
+#define BYTE_POOL_MAX_SIZE (1ULL << 32)
+
+/* 字节池。从定长的块中依次切分出存储空间，只能一次性地全部释放 */
+typedef struct
+{
+    char **blocks;        /* 块的数组 */
+    int blocks_count;     /* 已分配的块数 */
+    int blocks_capacity;  /* 块的数组的容量 */
+    uint32_t upto;        /* 下一次切分存储空间的位置（在整个字节池中的偏移量） */
+} byte_pool;
+
+/* 字节池中的可变长数据。由若干个长度逐渐增长的slice连接而成 */
+typedef struct
+{
+    uint32_t start;  /* 首个slice的位置 */
+    uint32_t upto;   /* 下一个字节的写入位置 */
+    uint32_t end;    /* 当前slice中可写入区域的结尾。其后存储着下一个slice的位置 */
+    uint32_t level;  /* 当前slice的等级，决定了slice的长度 */
+} byte_slice;
+
+/* 用于依次读取byte_slice中的数据的游标 */
+typedef struct
+{
+    const byte_pool *pool; /* 数据所在的字节池 */
+    uint32_t upto;         /* 下一个字节的读取位置 */
+    uint32_t end;          /* 当前slice中数据区域的结尾 */
+    uint32_t limit;        /* 数据的结尾 */
+    uint32_t level;        /* 当前slice的等级 */
+} byte_slice_reader;
+
 int print_error(const char *format, ...);
 
 buffer *alloc_buffer(void);
@@ -29,6 +63,22 @@ void free_buffer(buffer *buf);
 
 void append_buffer_bit(buffer *buf, int bit);
 
+byte_pool *alloc_byte_pool(void);
+
+void free_byte_pool(byte_pool *pool);
+
+size_t byte_pool_size(const byte_pool *pool);
+
+int init_byte_slice(byte_pool *pool, byte_slice *slice);
+
+int append_byte_slice_vbyte(byte_pool *pool, byte_slice *slice,
+                            unsigned int n);
+
+void init_byte_slice_reader(byte_slice_reader *reader,
+                            const byte_pool *pool, const byte_slice *slice);
+
+int read_byte_slice_vbyte(byte_slice_reader *reader, unsigned int *n);
+
 int uchar2utf8_size(const UTF32Char *ustr, int ustr_len);
 
 char *utf32toutf8(const UTF32Char *ustr, int ustr_len, char *str,
@@ -37,6 +87,12 @@ char *utf32toutf8(const UTF32Char *ustr, int ustr_len, char *str,
 int utf8toutf32(const char *str, int str_size, UTF32Char **ustr,
                 int *ustr_len);
 
+size_t utf8_ascii_span(const char *str, const char *str_end);
+
+size_t utf8_valid_span(const char *str, const char *str_end);
+
+int utf8_next_char(const char **str, const char *str_end, UTF32Char *uchar);
+
 void print_time_diff(void);
 
 #endif /* __UTIL_H__ */
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <errno.h>
+#include <string.h>
 
 #include <expat.h>
 #include <utstring.h>
@@ -18,6 +19,15 @@ typedef enum
     IN_PAGE_REVISION_TEXT /* 位于<page>标签中的<revision>标签中的<text>标签中 */
 } wikipedia_status;
 
+#define LOAD_BUFFER_SIZE 0x2000
+
+/* 每次读取的数据之前还有上次读取时结尾处被截断的字符，最多MAX_UTF8_SIZE - 1个字节 */
+#define LOAD_INPUT_SIZE (LOAD_BUFFER_SIZE + MAX_UTF8_SIZE - 1)
+
+/* 代替不合法的UTF-8字节序列的U+FFFD的UTF-8 */
+#define UTF8_REPLACEMENT "\xEF\xBF\xBD"
+#define UTF8_REPLACEMENT_SIZE (sizeof(UTF8_REPLACEMENT) - 1)
+
 /* 在Wikipedia的解析器中用到的变量 */
 typedef struct
 {
@@ -28,8 +38,39 @@ typedef struct
     int article_count;          /* 经过解析的词条总数 */
     int max_article_count;      /* 最多要解析多少个词条 */
     add_document_callback func; /* 将解析后的文档传递给该函数 */
+    int func_rc;                /* func返回的错误代码。失败后不再调用func */
+    XML_Parser parser;          /* expat的解析器 */
+    XML_Index buffer_index;     /* 正在解析的数据在整个输入中的起始位置 */
+    /* 正在解析的数据中替换为U+FFFD的位置 */
+    int invalid_offsets[LOAD_INPUT_SIZE];
+    int invalid_count;          /* 正在解析的数据中替换为U+FFFD的次数 */
+    int invalid_next;           /* invalid_offsets中尚未计入任何词条的第一个位置 */
+    int invalid_pending;        /* 之前的数据中替换了、但尚未计入任何词条的次数 */
 } wikipedia_parser;
 
+/**
+ * 统计当前词条中被替换为U+FFFD的不合法的UTF-8字节序列数
+ * 计入上一个词条之后、当前的结束标签之前的所有替换
+ * @param[in,out] p Wikipedia解析器的运行环境
+ * @return 不合法的UTF-8字节序列数
+ */
+static int
+count_invalid_utf8(wikipedia_parser *p)
+{
+    int count;
+    XML_Index offset = XML_GetCurrentByteIndex(p->parser) - p->buffer_index;
+
+    while (p->invalid_next < p->invalid_count &&
+           p->invalid_offsets[p->invalid_next] < offset)
+    {
+        p->invalid_next++;
+        p->invalid_pending++;
+    }
+    count = p->invalid_pending;
+    p->invalid_pending = 0;
+    return count;
+}
+
 /**
  * 遇到XML的起始标签时被调用的函数
  * @param[in] user_data Wikipedia解析器的运行环境
@@ -118,11 +159,21 @@ end(void *user_data, const XML_Char *el)
         case IN_PAGE_REVISION_TEXT:
             if (!strcmp(el, "text"))
             {
+                int invalid_count = count_invalid_utf8(p);
+
                 p->status = IN_PAGE_REVISION;
-                if (p->max_article_count < 0 ||
-                    p->article_count < p->max_article_count)
+                if (invalid_count)
+                {
+                    p->env->invalid_utf8_count += invalid_count;
+                    print_error("invalid UTF-8 sequences replaced with U+FFFD."
+                                " (title: %s, count: %d)",
+                                utstring_body(p->title), invalid_count);
+                }
+                if (!p->func_rc && (p->max_article_count < 0 ||
+                                    p->article_count < p->max_article_count))
                 {
-                    p->func(p->env, utstring_body(p->title), utstring_body(p->body));
+                    p->func_rc = p->func(p->env, utstring_body(p->title),
+                                         utstring_body(p->body));
                 }
                 utstring_free(p->title);
                 utstring_free(p->body);
@@ -158,7 +209,49 @@ element_data(void *user_data, const XML_Char *data, int data_size)
     }
 }
 
-#define LOAD_BUFFER_SIZE 0x2000
+/**
+ * 将读取到的数据中不合法的UTF-8字节序列替换为U+FFFD
+ * expat不接受不合法的UTF-8，1个损坏的词条会导致整个文件的解析失败，因此在解析之前进行替换，
+ * 并记录替换后的位置，以便统计各个词条中的替换次数。
+ * 结尾处被截断的字符不进行替换，留到与下次读取的数据一起处理
+ * @param[in,out] p Wikipedia解析器的运行环境
+ * @param[in] data 读取到的数据
+ * @param[in] data_size 数据的字节数
+ * @param[in] done 是否已读取到文件的结尾
+ * @param[out] out 替换后的数据。至少需要data_size * UTF8_REPLACEMENT_SIZE个字节
+ * @param[out] out_size 替换后的数据的字节数
+ * @return 处理过的字节数。其后的字节需要与下次读取的数据一起处理
+ */
+static int
+replace_invalid_utf8(wikipedia_parser *p, const char *data, int data_size,
+                     int done, char *out, int *out_size)
+{
+    char *o = out;
+    const char *s = data, *end = data + data_size;
+
+    p->invalid_count = 0;
+    p->invalid_next = 0;
+    while (s < end)
+    {
+        UTF32Char u;
+        const char *next;
+        size_t valid = utf8_valid_span(s, end);
+
+        memcpy(o, s, valid);
+        o += valid;
+        s += valid;
+        if (s >= end) { break; }
+        next = s;
+        utf8_next_char(&next, end, &u);
+        if (!done && next == end) { break; }
+        p->invalid_offsets[p->invalid_count++] = (int) (o - out);
+        memcpy(o, UTF8_REPLACEMENT, UTF8_REPLACEMENT_SIZE);
+        o += UTF8_REPLACEMENT_SIZE;
+        s = next;
+    }
+    *out_size = (int) (o - out);
+    return (int) (s - data);
+}
 
 /**
  * 加载Wikipedia的副本（XML文件），并将其内容传递给指定的函数
@@ -171,6 +264,7 @@ element_data(void *user_data, const XML_Char *data, int data_size)
  * @retval 2 打开文件失败
  * @retval 3 加载文件失败
  * @retval 4 解析XML文件失败
+ * @retval 5 func返回了错误
  */
 int
 load_wikipedia_dump(wiser_env *env,
@@ -179,7 +273,8 @@ load_wikipedia_dump(wiser_env *env,
     FILE *fp;
     int rc = 0;
     XML_Parser xp;
-    char buffer[LOAD_BUFFER_SIZE];
+    int buffer_len = 0;
+    char buffer[LOAD_INPUT_SIZE], parse_buffer[LOAD_INPUT_SIZE * UTF8_REPLACEMENT_SIZE];
     wikipedia_parser wp = {
             env,               /* 存储着应用程序运行环境的结构体 */
             IN_DOCUMENT,       /* 初始状态 */
@@ -187,7 +282,14 @@ load_wikipedia_dump(wiser_env *env,
             NULL,              /* 词条正文的临时存储区 */
             0,                 /* 初始化经过解析的词条总数 */
             max_article_count, /* 最多要解析多少个词条 */
-            func               /* 将解析后的文档传递给该函数 */
+            func,              /* 将解析后的文档传递给该函数 */
+            0,                 /* func尚未返回错误 */
+            NULL,              /* expat的解析器。创建后设置 */
+            0,                 /* 从输入的开头开始解析 */
+            {0},               /* 替换为U+FFFD的位置 */
+            0,                 /* 尚未替换为U+FFFD */
+            0,
+            0
     };
 
     if (!(xp = XML_ParserCreate("UTF-8")))
@@ -204,15 +306,17 @@ load_wikipedia_dump(wiser_env *env,
         goto exit;
     }
 
+    wp.parser = xp;
     XML_SetElementHandler(xp, start, end);
     XML_SetCharacterDataHandler(xp, element_data);
     XML_SetUserData(xp, (void *) &wp);
 
     while (1)
     {
-        int buffer_len, done;
+        int parse_len, used, done;
 
-        buffer_len = (int) fread(buffer, 1, LOAD_BUFFER_SIZE, fp);
+        /* 上次读取的数据中未处理的部分留在buffer的开头 */
+        buffer_len += (int) fread(buffer + buffer_len, 1, LOAD_BUFFER_SIZE, fp);
         if (ferror(fp))
         {
             print_error("wikipedia dump xml file read error.");
@@ -221,12 +325,26 @@ load_wikipedia_dump(wiser_env *env,
         }
         done = feof(fp);
 
-        if (XML_Parse(xp, buffer, buffer_len, done) == XML_STATUS_ERROR)
+        used = replace_invalid_utf8(&wp, buffer, buffer_len, done,
+                                    parse_buffer, &parse_len);
+        buffer_len -= used;
+        memmove(buffer, buffer + used, buffer_len);
+
+        if (XML_Parse(xp, parse_buffer, parse_len, done) == XML_STATUS_ERROR)
         {
             print_error("wikipedia dump xml file parse error.");
             rc = 4;
             goto exit;
         }
+        /* 还未到达词条的结束标签的替换计入之后的词条 */
+        wp.invalid_pending += wp.invalid_count - wp.invalid_next;
+        wp.buffer_index += parse_len;
+        if (wp.func_rc)
+        {
+            print_error("cannot add a document.");
+            rc = 5;
+            goto exit;
+        }
 
         if (done || (max_article_count >= 0 &&
                      max_article_count <= wp.article_count)) { break; }
@@ -1,93 +1,184 @@
 #include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <getopt.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
 #include "util.h"
 #include "token.h"
 #include "search.h"
 #include "postings.h"
 #include "database.h"
+#include "reorder.h"
 #include "wikiload.h"
+#include "indexfile.h"
 
 /**
  * 将文档添加到数据库中，建立倒排索引
  * @param[in] env 存储着应用程序运行环境的结构体
  * @param[in] title 文档标题，为NULL时将会清空缓冲区
  * @param[in] body 文档正文
+ * @retval 0 成功
+ * @retval -1 创建倒排列表、更新倒排索引或统计信息失败
  */
-static void
+static int
 add_document(wiser_env *env, const char *title, const char *body)
 {
     if (title && body)
     {
-        UTF32Char *body32;
-        int body32_len, document_id;
+        int document_id;
         unsigned int title_size, body_size;
 
         title_size = strlen(title);
         body_size = strlen(body);
 
         /* 将文档存储到数据库中并获取该文档对应的文档编号 */
-        db_add_document(env, title, title_size, body, body_size);
         document_id = db_get_document_id(env, title, title_size);
+        db_add_document(env, title, title_size, body, body_size);
+        if (!document_id)
+        {
+            /* 只有新的文档才会增加文档数 */
+            document_id = db_get_document_id(env, title, title_size);
+            env->indexed_count++;
+        }
 
-        /* 转换文档正文的字符编码 */
-        if (!utf8toutf32(body, body_size, &body32, &body32_len))
+        /* 一边对文档正文进行解码，一边为文档创建倒排列表。
+           失败时缓冲区中只有该文档的一部分，因此不清空缓冲区，直接返回错误 */
+        if (text_to_postings_lists(env, document_id, body, body_size,
+                                   env->token_len, &env->ii_buffer))
+        {
+            print_error("cannot create postings lists. (title: %s)", title);
+            return -1;
+        }
+        if (env->ii_buffer)
         {
-            /* 为文档创建倒排列表 */
-            text_to_postings_lists(env, document_id, body32, body32_len,
-                                   env->token_len, &env->ii_buffer);
             env->ii_buffer_count++;
-            free(body32);
+            env->ii_buffer_size = inverted_index_size(env->ii_buffer);
         }
-        env->indexed_count++;
         print_error("count:%d title: %s", env->indexed_count, title);
     }
 
-    /* 存储在缓冲区中的文档数量达到了指定的阈值时，更新存储器上的倒排索引 */
+    /* 缓冲区占用的内存或其中的文档数量达到了指定的阈值时，更新存储器上的倒排索引 */
     if (env->ii_buffer &&
-        (env->ii_buffer_count > env->ii_buffer_update_threshold || !title))
+        (env->ii_buffer_size >= env->ii_buffer_memory_limit ||
+         (env->ii_buffer_update_threshold >= 0 &&
+          env->ii_buffer_count > env->ii_buffer_update_threshold) ||
+         !title))
     {
-        inverted_index_hash *p;
-
         print_time_diff();
 
         /* 更新所有词元对应的倒排项 */
-        for (p = env->ii_buffer; p != NULL; p = p->hh.next)
+        /* 统计信息与倒排列表在同一个事务中更新 */
+        env->indexed_tokens_count += inverted_index_tokens_count(env->ii_buffer);
+        if (update_inverted_index(env, env->ii_buffer) ||
+            db_save_corpus_stats(env))
         {
-            update_postings(env, p);
+            free_inverted_index(env->ii_buffer);
+            env->ii_buffer = NULL;
+            return -1;
         }
         free_inverted_index(env->ii_buffer);
-        print_error("index flushed.");
+        print_error("index flushed. (documents: %d, buffer: %.2lf MiB)",
+                    env->ii_buffer_count,
+                    (double) env->ii_buffer_size / (1024 * 1024));
         env->ii_buffer = NULL;
         env->ii_buffer_count = 0;
+        env->ii_buffer_size = 0;
+
+        /* 段的数量增加到一定程度后，将它们合并 */
+        compact_segments(env);
 
         print_time_diff();
     }
+    return 0;
+}
+
+/**
+ * 将参数字符串解析为指定范围内的整数
+ * @param[in] str 参数字符串
+ * @param[in] min 允许的最小值
+ * @param[in] max 允许的最大值
+ * @param[out] value 解析得到的整数
+ * @retval 0 成功
+ * @retval -1 不是整数，或者超出了范围
+ */
+static int
+parse_int_option(const char *str, int min, int max, int *value)
+{
+    char *end;
+    long v;
+
+    errno = 0;
+    v = strtol(str, &end, 10);
+    if (errno || end == str || *end || v < min || v > max)
+    {
+        return -1;
+    }
+    *value = (int) v;
+    return 0;
+}
+
+/**
+ * 将参数字符串解析为大于0且不超过1的比例
+ * @param[in] str 参数字符串
+ * @param[out] value 解析得到的比例
+ * @retval 0 成功
+ * @retval -1 不是数值，或者超出了范围
+ */
+static int
+parse_ratio_option(const char *str, double *value)
+{
+    char *end;
+    double v;
+
+    errno = 0;
+    v = strtod(str, &end);
+    if (errno || end == str || *end || !(v > 0.0 && v <= 1.0))
+    {
+        return -1;
+    }
+    *value = v;
+    return 0;
 }
 
 /**
  * 设定应用程序的运行环境
  * @param[in] env 存储着应用程序运行环境的结构体
- * @param[in] ii_buffer_update_threshold 清空（Flush）倒排索引缓冲区的阈值
+ * @param[in] ii_buffer_update_threshold 清空（Flush）倒排索引缓冲区的阈值（文档数）
+ * @param[in] ii_buffer_memory_limit 清空（Flush）倒排索引缓冲区的阈值（字节数）
  * @param[in] enable_phrase_search 是否启用短语检索
+ * @param[in] flush_threads 更新倒排索引时用于编码的线程数
+ * @param[in] bitmap_threshold 用位图存储和查找块的文档密度的下限
+ * @param[in] backend 存储后端的名称。为NULL时使用默认的存储后端
  * @param[in] db_path 数据库的路径
  * @return 错误代码
  * @retval 0 成功
  */
 static int
 init_env(wiser_env *env,
-         int ii_buffer_update_threshold, int enable_phrase_search,
-         const char *db_path)
+         int ii_buffer_update_threshold, size_t ii_buffer_memory_limit,
+         int enable_phrase_search, int flush_threads, double bitmap_threshold,
+         const char *backend, const char *db_path)
 {
     int rc;
     memset(env, 0, sizeof(wiser_env));
-    rc = init_database(env, db_path);
+    rc = init_database(env, backend, db_path);
     if (!rc)
     {
         env->token_len = N_GRAM;
         env->ii_buffer_update_threshold = ii_buffer_update_threshold;
+        env->ii_buffer_memory_limit = ii_buffer_memory_limit;
         env->enable_phrase_search = enable_phrase_search;
+        env->flush_threads = flush_threads;
+        env->bitmap_threshold = bitmap_threshold;
+        if ((rc = db_load_corpus_stats(env)))
+        {
+            print_error("cannot load corpus statistics.");
+            fin_database(env);
+        }
     }
     return rc;
 }
@@ -99,6 +190,9 @@ init_env(wiser_env *env,
 static void
 fin_env(wiser_env *env)
 {
+    free_search_accumulator(env);
+    free_token_cache(env);
+    if (env->index_file) { close_index_file(env->index_file); }
     fin_database(env);
 }
 
@@ -117,7 +211,11 @@ parse_compress_method(wiser_env *env, const char *method,
 {
     if (method && method_size < 0) { method_size = strlen(method); }
     if (!method || !method_size
-        || MEMSTRCMP(method, method_size, "golomb"))
+        || MEMSTRCMP(method, method_size, "adaptive"))
+    {
+        env->compress = compress_adaptive;
+    }
+    else if (MEMSTRCMP(method, method_size, "golomb"))
     {
         env->compress = compress_golomb;
     }
@@ -125,11 +223,27 @@ parse_compress_method(wiser_env *env, const char *method,
     {
         env->compress = compress_none;
     }
+    else if (MEMSTRCMP(method, method_size, "eliasfano"))
+    {
+        env->compress = compress_elias_fano;
+    }
+    else if (MEMSTRCMP(method, method_size, "streamvbyte"))
+    {
+        env->compress = compress_streamvbyte;
+    }
+    else if (MEMSTRCMP(method, method_size, "rice"))
+    {
+        env->compress = compress_rice;
+    }
+    else if (MEMSTRCMP(method, method_size, "interpolative"))
+    {
+        env->compress = compress_interpolative;
+    }
     else
     {
-        print_error("invalid compress method(%.*s). use golomb instead.",
+        print_error("invalid compress method(%.*s). use adaptive instead.",
                     method_size, method);
-        env->compress = compress_golomb;
+        env->compress = compress_adaptive;
     }
     switch (env->compress)
     {
@@ -143,7 +257,195 @@ parse_compress_method(wiser_env *env, const char *method,
                                 "compress_method", sizeof("compress_method") - 1,
                                 "golomb", sizeof("golomb") - 1);
             break;
+        case compress_adaptive:
+            db_replace_settings(env,
+                                "compress_method", sizeof("compress_method") - 1,
+                                "adaptive", sizeof("adaptive") - 1);
+            break;
+        case compress_elias_fano:
+            db_replace_settings(env,
+                                "compress_method", sizeof("compress_method") - 1,
+                                "eliasfano", sizeof("eliasfano") - 1);
+            break;
+        case compress_streamvbyte:
+            db_replace_settings(env,
+                                "compress_method", sizeof("compress_method") - 1,
+                                "streamvbyte", sizeof("streamvbyte") - 1);
+            break;
+        case compress_rice:
+            db_replace_settings(env,
+                                "compress_method", sizeof("compress_method") - 1,
+                                "rice", sizeof("rice") - 1);
+            break;
+        case compress_interpolative:
+            db_replace_settings(env,
+                                "compress_method", sizeof("compress_method") - 1,
+                                "interpolative", sizeof("interpolative") - 1);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * 设定倒排列表中是否存储位置信息
+ * 构建索引时将其记录在settings中，之后的检索等处理都沿用该记录
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] store_positions 是否存储位置信息。为-1时读取settings中的记录，
+ *                            没有记录时视为存储了位置信息
+ */
+static void
+parse_store_positions(wiser_env *env, int store_positions)
+{
+    if (store_positions < 0)
+    {
+        int size = 0;
+        const char *value = NULL;
+        db_get_settings(env, "store_positions", sizeof("store_positions") - 1,
+                        &value, &size);
+        store_positions = !MEMSTRCMP(value, size, "0");
+    }
+    else
+    {
+        db_replace_settings(env,
+                            "store_positions", sizeof("store_positions") - 1,
+                            store_positions ? "1" : "0", 1);
+    }
+    env->store_positions = store_positions;
+    /* 没有位置信息时不能进行短语检索 */
+    if (!store_positions) { env->enable_phrase_search = FALSE; }
+}
+
+/**
+ * 获取文件的字节数
+ * @param[in] path 文件的路径
+ * @return 文件的字节数。文件不存在时为0
+ */
+static long long
+get_file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) ? 0 : (long long) st.st_size;
+}
+
+/**
+ * 复制文件
+ * @param[in] src 复制源的路径
+ * @param[in] dst 复制目标的路径
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+copy_file(const char *src, const char *dst)
+{
+    int rc = -1;
+    size_t n;
+    char buf[65536];
+    FILE *in, *out = NULL;
+
+    if (!(in = fopen(src, "rb")) || !(out = fopen(dst, "wb")))
+    {
+        print_error("cannot copy %s to %s.", src, dst);
+        goto exit;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        if (fwrite(buf, 1, n, out) != n) { break; }
+    }
+    if (ferror(in) || ferror(out))
+    {
+        print_error("cannot copy %s to %s.", src, dst);
+    }
+    else
+    {
+        rc = 0;
+    }
+exit:
+    if (in) { fclose(in); }
+    if (out)
+    {
+        if (fclose(out)) { rc = -1; }
+        if (rc) { unlink(dst); }
     }
+    return rc;
+}
+
+/**
+ * 优化索引：合并所有的段，并重新编码所有的倒排列表，之后回收数据库中未使用的空间
+ * @param[in] env 存储着应用程序运行环境的结构体
+ * @param[in] compress_method_str 重新编码时使用的压缩方法。为NULL时沿用原有的压缩方法
+ * @param[in] reorder 是否在重新编码之前对文档重新编号，使倒排列表更小
+ * @param[in] db_path 数据库的路径
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static int
+optimize(wiser_env *env, const char *compress_method_str, int reorder,
+         const char *db_path)
+{
+    int rc, cm_size = 0, documents_count;
+    int *document_ids_map = NULL;
+    const char *cm = NULL;
+    compress_method source_compress;
+    long long source_size, optimized_size, file_size;
+    struct timeval start, end;
+
+    gettimeofday(&start, NULL);
+    file_size = get_file_size(db_path);
+    db_get_settings(env, "compress_method", sizeof("compress_method") - 1,
+                    &cm, &cm_size);
+    parse_compress_method(env, cm, cm_size);
+    source_compress = env->compress;
+
+    begin(env);
+    /* 计算新的文档编号时需要按照原有的压缩方法读取倒排列表 */
+    if (reorder && (documents_count = db_get_document_count(env)) > 0)
+    {
+        if (!(document_ids_map = malloc(sizeof(int) * documents_count)))
+        {
+            print_error("cannot allocate memory for reordering documents.");
+            rollback(env);
+            return -1;
+        }
+        if (reorder_documents(env, documents_count, document_ids_map) ||
+            db_renumber_documents(env, document_ids_map, documents_count))
+        {
+            print_error("cannot reorder documents.");
+            free(document_ids_map);
+            rollback(env);
+            return -1;
+        }
+    }
+    if (compress_method_str)
+    {
+        parse_compress_method(env, compress_method_str, -1);
+    }
+    rc = optimize_index(env, source_compress, document_ids_map,
+                        &source_size, &optimized_size);
+    free(document_ids_map);
+    if (rc)
+    {
+        print_error("cannot optimize index.");
+        rollback(env);
+        env->compress = source_compress;
+        return rc;
+    }
+    commit(env);
+    /* VACUUM不能在事务中执行 */
+    db_vacuum(env);
+
+    gettimeofday(&end, NULL);
+    print_error("index optimized. (postings: %.2lf MiB -> %.2lf MiB,"
+                " saved: %.2lf MiB, file: %.2lf MiB -> %.2lf MiB,"
+                " time: %.3lf sec)",
+                (double) source_size / (1024 * 1024),
+                (double) optimized_size / (1024 * 1024),
+                (double) (source_size - optimized_size) / (1024 * 1024),
+                (double) file_size / (1024 * 1024),
+                (double) get_file_size(db_path) / (1024 * 1024),
+                (end.tv_sec - start.tv_sec) +
+                (end.tv_usec - start.tv_usec) / 1000000.0);
+    return 0;
 }
 
 /**
@@ -158,16 +460,32 @@ main(int argc, char *argv[])
     extern int optind;
     int max_index_count = -1; /* 不限制参与索引构建的文档数量 */
     int ii_buffer_update_threshold = DEFAULT_II_BUFFER_UPDATE_THRESHOLD;
+    int ii_buffer_memory_limit = DEFAULT_II_BUFFER_MEMORY_LIMIT;
     int enable_phrase_search = TRUE;
+    int store_positions = TRUE;
+    int optimize_index_file = FALSE;
+    int reorder_document_ids = FALSE;
+    int invalid_option = FALSE;
+    double bitmap_threshold = DEFAULT_BITMAP_THRESHOLD;
+    int flush_threads = (int) sysconf(_SC_NPROCESSORS_ONLN); /* 使用所有的CPU */
     const char *compress_method_str = NULL, *wikipedia_dump_file = NULL,
-            *query = NULL;
+            *query = NULL, *export_file = NULL, *index_file_path = NULL,
+            *backend = NULL, *archive_path = NULL, *db_path;
     /* 解析参数字符串 */
     {
         int ch;
         extern int opterr;
         extern char *optarg;
+        static const struct option long_options[] = {
+                {"optimize", no_argument, NULL, 'O'},
+                {"archive", required_argument, NULL, 'A'},
+                {"reorder", no_argument, NULL, 'R'},
+                {"no-positions", no_argument, NULL, 'N'},
+                {NULL, 0, NULL, 0}
+        };
 
-        while ((ch = getopt(argc, argv, "c:x:q:m:t:s")) != -1)
+        while ((ch = getopt_long(argc, argv, "c:x:q:m:t:b:j:r:sNe:i:B:OA:R",
+                                 long_options, NULL)) != -1)
         {
             switch (ch)
             {
@@ -184,17 +502,71 @@ main(int argc, char *argv[])
                     max_index_count = atoi(optarg);
                     break;
                 case 't':
-                    ii_buffer_update_threshold = atoi(optarg);
+                    /* -1表示不按文档数清空缓冲区 */
+                    if (parse_int_option(optarg, -1, INT_MAX,
+                                         &ii_buffer_update_threshold))
+                    {
+                        print_error("invalid ii_buffer_update_threshold: %s",
+                                    optarg);
+                        invalid_option = TRUE;
+                    }
+                    break;
+                case 'b':
+                    /* 字节池写满时无法继续添加倒排列表，因此缓冲区的上限不得超过字节池的容量 */
+                    if (parse_int_option(optarg, 1, MAX_II_BUFFER_MEMORY_LIMIT,
+                                         &ii_buffer_memory_limit))
+                    {
+                        print_error("invalid ii_buffer_memory_limit: %s", optarg);
+                        invalid_option = TRUE;
+                    }
+                    break;
+                case 'j':
+                    if (parse_int_option(optarg, 1, INT_MAX, &flush_threads))
+                    {
+                        print_error("invalid flush_threads: %s", optarg);
+                        invalid_option = TRUE;
+                    }
+                    break;
+                case 'r':
+                    if (parse_ratio_option(optarg, &bitmap_threshold))
+                    {
+                        print_error("invalid bitmap_threshold: %s", optarg);
+                        invalid_option = TRUE;
+                    }
                     break;
                 case 's':
                     enable_phrase_search = FALSE;
                     break;
+                case 'N':
+                    store_positions = FALSE;
+                    break;
+                case 'e':
+                    export_file = optarg;
+                    break;
+                case 'i':
+                    index_file_path = optarg;
+                    break;
+                case 'B':
+                    backend = optarg;
+                    break;
+                case 'O':
+                    optimize_index_file = TRUE;
+                    break;
+                case 'A':
+                    archive_path = optarg;
+                    break;
+                case 'R':
+                    optimize_index_file = TRUE;
+                    reorder_document_ids = TRUE;
+                    break;
             }
         }
     }
 
+    if (flush_threads < 1) { flush_threads = 1; }
+
     /* 使用解析过的参数运行wiser */
-    if (argc != optind + 1)
+    if (argc != optind + 1 || invalid_option)
     {
         printf(
                 "usage: %s [options] db_file\n"
@@ -205,12 +577,41 @@ main(int argc, char *argv[])
                         "  -q search_query               : query for search\n"
                         "  -m max_index_count            : max count for indexing document\n"
                         "  -t ii_buffer_update_threshold : inverted index buffer merge threshold\n"
+                        "                                  in documents, -1 for unlimited\n"
+                        "                                  (default: -1)\n"
+                        "  -b ii_buffer_memory_limit     : inverted index buffer merge threshold\n"
+                        "                                  in MiB, 1 to %d (default: %d)\n"
+                        "  -j flush_threads              : threads for encoding postings on flush\n"
+                        "  -r bitmap_threshold           : store and probe chunks as bitmaps when\n"
+                        "                                  docs / docid range >= this, in (0, 1]\n"
+                        "                                  (default: %.2f)\n"
                         "  -s                            : don't use tokens' positions for search\n"
+                        "  -N, --no-positions            : build index with term frequencies only,\n"
+                        "                                  without tokens' positions (implies -s)\n"
+                        "  -e index_file                 : export read-only index file for search\n"
+                        "  -i index_file                 : search with read-only index file\n"
+                        "  -B storage_backend            : storage backend (default: sqlite)\n"
+                        "  -O, --optimize                : merge all segments and re-encode\n"
+                        "                                  postings lists (with -c if given)\n"
+                        "  -A, --archive archive_file    : write an optimized copy of db_file to\n"
+                        "                                  archive_file (-c default: interpolative)\n"
+                        "  -R, --reorder                 : renumber documents so that similar ones\n"
+                        "                                  get close ids, then optimize (implies -O)\n"
                         "\n"
                         "compress_methods:\n"
-                        "  none   : don't compress.\n"
-                        "  golomb : Golomb-Rice coding(default).\n",
-                argv[0]);
+                        "  none          : don't compress.\n"
+                        "  golomb        : Golomb coding.\n"
+                        "  eliasfano     : Elias-Fano coding for document ids.\n"
+                        "  streamvbyte   : Golomb for document ids, Stream-VByte for positions.\n"
+                        "  rice          : Rice coding, Golomb with power-of-two parameters.\n"
+                        "  interpolative : binary interpolative coding, smallest but slowest.\n"
+                        "  adaptive      : choose the smallest method for each block(default).\n"
+                        "\n"
+                        "storage_backends:\n"
+                        "  sqlite : store index in db_file.\n"
+                        "  memory : keep index in memory, db_file is ignored.\n",
+                argv[0], MAX_II_BUFFER_MEMORY_LIMIT,
+                DEFAULT_II_BUFFER_MEMORY_LIMIT, DEFAULT_BITMAP_THRESHOLD);
         return -1;
     }
 
@@ -224,33 +625,67 @@ main(int argc, char *argv[])
         }
     }
 
+    /* 归档时，将数据库复制到归档文件后对其进行优化，原有的数据库保持不变 */
+    db_path = argv[optind];
+    if (archive_path)
     {
-        int rc = init_env(&env, ii_buffer_update_threshold, enable_phrase_search,
-                          argv[optind]);
+        struct stat st;
+        if (!stat(archive_path, &st))
+        {
+            printf("%s is already exists.\n", archive_path);
+            return -2;
+        }
+        if (copy_file(db_path, archive_path)) { return -1; }
+        db_path = archive_path;
+        optimize_index_file = TRUE;
+        if (!compress_method_str) { compress_method_str = "interpolative"; }
+    }
+
+    {
+        int rc = init_env(&env, ii_buffer_update_threshold,
+                          (size_t) ii_buffer_memory_limit * 1024 * 1024,
+                          enable_phrase_search, flush_threads,
+                          bitmap_threshold, backend, db_path);
         if (!rc)
         {
             print_time_diff();
+            parse_store_positions(&env, wikipedia_dump_file ? store_positions
+                                                            : -1);
 
             /* 加载Wikipedia的词条数据 */
             if (wikipedia_dump_file)
             {
                 parse_compress_method(&env, compress_method_str, -1);
                 begin(&env);
+                /* 清空缓冲区时也失败的话，不提交已写入的部分 */
                 if (!load_wikipedia_dump(&env, wikipedia_dump_file, add_document,
-                                         max_index_count))
+                                         max_index_count) &&
+                    !add_document(&env, NULL, NULL))
                 {
-                    /* 清空缓冲区 */
-                    add_document(&env, NULL, NULL);
                     commit(&env);
                 }
                 else
                 {
                     rollback(&env);
+                    rc = -1;
+                }
+                if (env.invalid_utf8_count)
+                {
+                    print_error("%lld invalid UTF-8 sequences were replaced"
+                                " with U+FFFD.", env.invalid_utf8_count);
                 }
+                free_token_cache(&env);
             }
 
-            /* 进行检索 */
-            if (query)
+            /* 优化索引 */
+            if (optimize_index_file &&
+                optimize(&env, compress_method_str, reorder_document_ids,
+                         db_path))
+            {
+                rc = -1;
+            }
+
+            if (query || export_file)
             {
                 int cm_size;
                 const char *cm;
@@ -258,8 +693,36 @@ main(int argc, char *argv[])
                                 "compress_method", sizeof("compress_method") - 1,
                                 &cm, &cm_size);
                 parse_compress_method(&env, cm, cm_size);
-                env.indexed_count = db_get_document_count(&env);
-                search(&env, query);
+            }
+
+            /* 导出只读的索引文件 */
+            if (export_file && export_index_file(&env, export_file))
+            {
+                rc = -1;
+            }
+
+            /* 进行检索 */
+            if (query && !rc)
+            {
+                if (index_file_path)
+                {
+                    /* 从索引文件中读取词典和倒排列表，不再访问数据库中的倒排索引 */
+                    if (!(env.index_file = open_index_file(index_file_path)))
+                    {
+                        rc = -1;
+                    }
+                    else
+                    {
+                        get_index_file_settings(env.index_file, &env.compress,
+                                                &env.indexed_count,
+                                                &env.store_positions);
+                        if (!env.store_positions)
+                        {
+                            env.enable_phrase_search = FALSE;
+                        }
+                    }
+                }
+                if (!rc) { search(&env, query); }
             }
             fin_env(&env);
 
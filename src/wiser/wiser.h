@@ -4,7 +4,8 @@
 #include <utlist.h>
 #include <uthash.h>
 #include <utarray.h>
-#include <sqlite3.h>
+
+#include "util.h"
 
 /* bi-gram */
 #define N_GRAM 2
@@ -18,21 +19,60 @@ typedef struct _postings_list
     struct _postings_list *next; /* 指向下一个倒排列表的指针 */
 } postings_list;
 
-/* 倒排索引（以词元编号为键，以倒排列表为值的关联数组） */
+/* 倒排索引中的索引项。倒排列表以可变字节码的形式存储在倒排索引的字节池中 */
 typedef struct
 {
     int token_id;                 /* 词元编号（Token ID）*/
-    postings_list *postings_list; /* 指向包含该词元的倒排列表的指针 */
     int docs_count;               /* 出现过该词元的文档数 */
     int positions_count;          /* 该词元在所有文档中的出现次数之和 */
-    UT_hash_handle hh;            /* 用于将该结构体转化为哈希表 */
-} inverted_index_hash, inverted_index_value;
+    int last_document_id;         /* 最后添加的文档的编号 */
+    int last_position;            /* 在最后添加的文档中最后出现的位置 */
+    int doc_positions_count;      /* 在最后添加的文档中的出现次数 */
+    byte_slice documents;         /* 文档编号之差与出现次数的序列 */
+    byte_slice positions;         /* 每个文档中的位置信息之差的序列 */
+} inverted_index_value;
+
+/* 倒排索引（以词元编号为键，以倒排列表为值的关联数组）
+   用线性探测的开放寻址法实现，索引项直接存储在槽中 */
+typedef struct
+{
+    inverted_index_value *slots;  /* 槽的数组。token_id为II_EMPTY_SLOT的槽是空的 */
+    unsigned int slots_count;     /* 槽数。2的幂 */
+    unsigned int slots_shift;     /* 从哈希值中取出槽的编号时右移的比特数 */
+    unsigned int entries_count;   /* 索引项数 */
+    byte_pool *pool;              /* 存储所有倒排列表的字节池 */
+} inverted_index;
+
+#define II_EMPTY_SLOT -1 /* 表示空槽的词元编号 */
+
+/* 以打包成整数的N-gram为键、以词元编号为值的缓存。构建索引时代替字符串查找词元编号
+   用线性探测的开放寻址法实现 */
+typedef struct
+{
+    uint64_t *keys;               /* 键的数组。为0的槽是空的 */
+    int *token_ids;               /* 与各个键对应的词元编号的数组 */
+    unsigned int slots_count;     /* 槽数。2的幂 */
+    unsigned int slots_shift;     /* 从哈希值中取出槽的编号时右移的比特数 */
+    unsigned int entries_count;   /* 键的数量 */
+} token_cache;
+
+/* 存储后端的操作表（在database.h中定义） */
+typedef struct _db_backend db_backend;
+
+/* 通过mmap打开的只读索引文件 */
+typedef struct _index_file index_file;
 
 /* 压缩倒排列表等数据的方法 */
 typedef enum
 {
-    compress_none,  /* 不压缩 */
-    compress_golomb /* 使用Golomb编码压缩 */
+    compress_none,         /* 不压缩 */
+    compress_golomb,       /* 使用Golomb编码压缩 */
+    compress_adaptive,     /* 对每个块选择字节数最少的压缩方法 */
+    compress_bitmap,       /* 用位图存储文档编号。只用于自适应压缩中的块 */
+    compress_elias_fano,   /* 使用Elias-Fano编码压缩文档编号 */
+    compress_streamvbyte,  /* 文档编号使用Golomb编码，位置信息使用Stream-VByte编码 */
+    compress_rice,         /* 使用参数为2的幂的Golomb编码（Rice编码）压缩 */
+    compress_interpolative /* 使用二元插值编码压缩。压缩率最高，用于归档 */
 } compress_method;
 
 /* 应用程序的全局配置 */
@@ -43,30 +83,27 @@ typedef struct _wiser_env
     int token_len;                  /* 词元的长度。N-gram中N的取值 */
     compress_method compress;       /* 压缩倒排列表等数据的方法 */
     int enable_phrase_search;       /* 是否进行短语检索 */
+    int store_positions;            /* 倒排列表中是否存储位置信息。为0时只存储出现次数 */
+    double bitmap_threshold;        /* 文档的密度不低于该值的块用位图存储和查找 */
 
-    inverted_index_hash *ii_buffer; /* 用于更新倒排索引的缓冲区（Buffer） */
+    inverted_index *ii_buffer;      /* 用于更新倒排索引的缓冲区（Buffer） */
     int ii_buffer_count;            /* 用于更新倒排索引的缓冲区中的文档数 */
-    int ii_buffer_update_threshold; /* 缓冲区中文档数的阈值 */
+    int ii_buffer_update_threshold; /* 缓冲区中文档数的阈值。-1表示不限制 */
+    size_t ii_buffer_size;          /* 用于更新倒排索引的缓冲区的字节数 */
+    size_t ii_buffer_memory_limit;  /* 缓冲区字节数的阈值 */
+    token_cache *token_cache;       /* 构建索引时的词元编号的缓存。为NULL时尚未分配 */
+    int flush_threads;              /* 更新倒排索引时用于编码的线程数 */
     int indexed_count;              /* 建立了索引的文档数 */
+    long long indexed_tokens_count; /* 建立了索引的文档中的词元总数 */
+    double average_document_length; /* 建立了索引的文档的平均长度（词元数） */
+    long long invalid_utf8_count;   /* 加载文档时替换为U+FFFD的不合法的UTF-8字节序列数 */
+
+    struct _search_accumulator *search_accumulator; /* 检索结果的累加器 */
+    index_file *index_file;         /* 检索时使用的只读索引文件。为NULL时使用数据库 */
 
-    /* 与sqlite3相关的配置 */
-    sqlite3 *db; /* sqlite3的实例 */
-    /* sqlite3的准备语句 */
-    sqlite3_stmt *get_document_id_st;
-    sqlite3_stmt *get_document_title_st;
-    sqlite3_stmt *insert_document_st;
-    sqlite3_stmt *update_document_st;
-    sqlite3_stmt *get_token_id_st;
-    sqlite3_stmt *get_token_st;
-    sqlite3_stmt *store_token_st;
-    sqlite3_stmt *get_postings_st;
-    sqlite3_stmt *update_postings_st;
-    sqlite3_stmt *get_settings_st;
-    sqlite3_stmt *replace_settings_st;
-    sqlite3_stmt *get_document_count_st;
-    sqlite3_stmt *begin_st;
-    sqlite3_stmt *commit_st;
-    sqlite3_stmt *rollback_st;
+    /* 与存储相关的配置 */
+    const db_backend *backend;      /* 存储后端的操作表 */
+    void *db;                       /* 存储后端的实例 */
 } wiser_env;
 
 /* TRUE/FALSE */
@@ -75,6 +112,10 @@ typedef struct _wiser_env
 #define TRUE 1
 #endif
 
-#define DEFAULT_II_BUFFER_UPDATE_THRESHOLD 2048
+#define DEFAULT_II_BUFFER_UPDATE_THRESHOLD -1  /* 不根据文档数清空缓冲区 */
+#define DEFAULT_II_BUFFER_MEMORY_LIMIT 256      /* 缓冲区的默认上限（MiB） */
+/* 缓冲区上限的最大值（MiB）。缓冲区在字节池写满之前清空 */
+#define MAX_II_BUFFER_MEMORY_LIMIT ((int) (BYTE_POOL_MAX_SIZE >> 20))
+#define DEFAULT_BITMAP_THRESHOLD 0.25           /* 用位图存储块的文档密度的默认下限 */
 
 #endif /* __WISER_H__ */